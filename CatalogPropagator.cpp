@@ -0,0 +1,526 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: time-major catalog propagator.
+ *  \details    Propagates all the satellites of a catalog together, one time step after another.
+ *              Near-earth orbits are kept in structure-of-arrays SGP4 batches, and the date and
+ *              sidereal time of each step are computed once for all satellites, so that the state
+ *              of the whole catalog at a given instant is available for in-process analyses.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       14-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+using Zeptomoby::OrbitTools::cOrbit;
+using Zeptomoby::OrbitTools::cOrbitRecord;
+using Zeptomoby::OrbitTools::cSgp4Batch;
+
+/*  Plans the propagation of every satellite in `tle_data` (sorted by NORAD ID) between the given
+ *  times. Satellites whose orbit is unknown for a part of the span are kept, but never propagated
+ *  (the reason is printed, naming them after the file in `output_path_root` where they are written
+ *  with `format`, see `getPath`, or only by NORAD ID if `output_path_root` is empty, e.g. in
+ *  analyses that do not write propagation files). If a `pool` is given, slices of the catalog are
+ *  propagated concurrently.
+ */
+CatalogPropagator::CatalogPropagator(std::unordered_map<int, TLEHistoricSet> & tle_data,
+    std::string output_path_root, PropFormat format, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, bool geodetic, WorkStealingPool * pool)
+    : output_path_root(output_path_root), format(format), prop_time_start(prop_time_start), prop_time_end(prop_time_end), prop_time_step(prop_time_step),
+    next_step(0), geodetic(geodetic), pool(pool)
+{
+    std::vector<int> ids;
+    for(auto t = tle_data.begin(); t != tle_data.end(); t++) {
+        ids.push_back(t->first);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    step_count = (prop_time_end >= prop_time_start ? (prop_time_end - prop_time_start) / prop_time_step + 1 : 0);
+    sats.resize(ids.size());
+    for(std::size_t k = 0; k < ids.size(); k++) {
+        CatalogSatellite & sat = sats[k];
+        sat.set = &tle_data.find(ids[k])->second;
+        try {
+            sat.segments = sat.set->planSegments(getPath(k), prop_time_start, prop_time_end,
+                prop_time_step);
+        } catch(TLEHistoricSetException & e) {
+            sat.segments.clear();
+        }
+    }
+    for(int first = 0; first < (int)sats.size(); first += CATALOG_SLICE) {
+        slices.emplace_back();
+        slices.back().first = first;
+        slices.back().count = std::min(CATALOG_SLICE, (int)sats.size() - first);
+    }
+    block_steps = std::max(1, std::min(CATALOG_BLOCK_STEPS, CATALOG_BLOCK_POINTS / std::max(1, (int)sats.size())));
+    rewind();
+}
+
+int CatalogPropagator::getSatelliteCount(void) const
+{
+    return sats.size();
+}
+
+int CatalogPropagator::getId(int k) const
+{
+    return sats[k].set->getId();
+}
+
+long CatalogPropagator::getStepCount(void) const
+{
+    return step_count;
+}
+
+std::time_t CatalogPropagator::getTimeStart(void) const
+{
+    return prop_time_start;
+}
+
+std::time_t CatalogPropagator::getTimeEnd(void) const
+{
+    return prop_time_end;
+}
+
+std::time_t CatalogPropagator::getTimeStep(void) const
+{
+    return prop_time_step;
+}
+
+/*  Path of the file where satellite `k` is written: its propagation file or the catalog container
+ *  (empty if no files are written).
+ */
+std::string CatalogPropagator::getPath(int k) const
+{
+    if(output_path_root.empty()) {
+        return "";
+    } else if(format == PROP_FORMAT_CONTAINER) {
+        return output_path_root + "/" PROPC_FILE_NAME;
+    }
+    return propPath(output_path_root, getId(k), format);
+}
+
+const std::vector<PropagationSegment> & CatalogPropagator::getSegments(int k) const
+{
+    return sats[k].segments;
+}
+
+/*  Removes all the segments of a satellite, which is not propagated any more (i.e. it is never
+ *  valid). Has to be followed by `rewind()`.
+ */
+void CatalogPropagator::exclude(int k)
+{
+    sats[k].segments.clear();
+}
+
+/*  Propagates a satellite `dt` seconds after a given step, with the TLE used at that step. Writes
+ *  its ECI position (km) and velocity (km/s) in `eci[6]` and returns the propagation status (see
+ *  cSgp4Batch::eStatus).
+ */
+int CatalogPropagator::getState(int k, long step, double dt, double * eci) const
+{
+    const std::vector<PropagationSegment> & segments = sats[k].segments;
+    auto s = std::upper_bound(segments.begin(), segments.end(), step,
+        [](long p, const PropagationSegment & segment) { return p < segment.first_point; });
+    int status;
+
+    if(s == segments.begin() || step >= (--s)->first_point + s->points) {
+        return cSgp4Batch::STATUS_ECCENTRICITY;
+    }
+    double tsince = (prop_time_start + step * prop_time_step - s->tle_time) / 60.0 + dt / 60.0 +
+        (Zeptomoby::OrbitTools::cJulian(s->tle_time).Date() - s->orbit->Epoch().Date()) * MIN_PER_DAY;
+    s->orbit->PositionEci(&tsince, 1, &eci[0], &eci[1], &eci[2], &eci[3], &eci[4], &eci[5], &status);
+    return status;
+}
+
+/* Prints the propagation errors found in a block. */
+void CatalogPropagator::printErrors(const CatalogBlock & block) const
+{
+    for(auto e = block.errors.begin(); e != block.errors.end(); e++) {
+        std::string path = getPath(e->sat);
+        std::string file = (path.empty() ? "" : "(" + path + ") ");
+        printf("  %5d %s%-3d [%3.0f%%] " DBG_REDD "error(3)" DBG_NOCOLOR": %s.\n",
+            getId(e->sat), file.c_str(), e->tle_index, (100.0 * e->step / step_count),
+            e->text.c_str());
+    }
+}
+
+/* Goes back to the propagation start time. */
+void CatalogPropagator::rewind(void)
+{
+    next_step = 0;
+    for(auto s = sats.begin(); s != sats.end(); s++) {
+        s->segment = 0;
+        s->segment_end = (s->segments.empty() ? 0 : s->segments[0].points);
+        s->failed = false;
+        s->slot = -1;
+        select(*s);
+    }
+    for(auto s = slices.begin(); s != slices.end(); s++) {
+        s->dirty = true;
+    }
+}
+
+/*  Computes the epoch offset of the current segment of a satellite. Segment times are relative to
+ *  the epoch of their TLE rounded to the second (see TLEHistoricSet::planSegments); the offset
+ *  makes every satellite be propagated at the exact instant of each step.
+ */
+void CatalogPropagator::select(CatalogSatellite & sat)
+{
+    sat.epoch_offset = 0.0;
+    if(sat.segment < sat.segments.size()) {
+        const PropagationSegment & segment = sat.segments[sat.segment];
+        sat.epoch_offset = (Zeptomoby::OrbitTools::cJulian(segment.tle_time).Date() -
+            segment.orbit->Epoch().Date()) * MIN_PER_DAY;
+    }
+}
+
+/*  Moves satellite `k` to the segment that covers `step`. Its slot is updated in place, unless it
+ *  changes between near-earth and deep-space orbits, in which case the batch has to be rebuilt.
+ */
+void CatalogPropagator::advance(CatalogSlice & slice, int k, long step)
+{
+    CatalogSatellite & sat = sats[k];
+    while(sat.segment < sat.segments.size() && step >= sat.segment_end) {
+        sat.segment++;
+        sat.segment_end += (sat.segment < sat.segments.size() ? sat.segments[sat.segment].points : 0);
+    }
+    sat.failed = false;
+    select(sat);
+    if(sat.segment < sat.segments.size()) {
+        const cOrbit & orbit = *sat.segments[sat.segment].orbit;
+        bool near_earth = (orbit.Record().m_Model == cOrbitRecord::MODEL_SGP4);
+        if(sat.slot >= 0 && near_earth) {
+            slice.batch.Set(sat.slot, orbit);
+        } else if(sat.slot >= 0 || near_earth) {
+            slice.dirty = true;
+        }
+    }
+}
+
+/* Puts the satellites of a slice that are using near-earth orbits in its SGP4 batch. */
+void CatalogPropagator::rebuild(CatalogSlice & slice)
+{
+    slice.batch.Clear();
+    slice.slot_sat.clear();
+    slice.deep.clear();
+    for(int k = slice.first; k < slice.first + slice.count; k++) {
+        CatalogSatellite & sat = sats[k];
+        sat.slot = -1;
+        if(sat.segment < sat.segments.size()) {
+            if((sat.slot = slice.batch.Add(*sat.segments[sat.segment].orbit)) >= 0) {
+                slice.slot_sat.push_back(k);
+            } else {
+                slice.deep.push_back(k);
+            }
+        }
+    }
+    slice.tsince.resize(slice.slot_sat.size());
+    slice.state.resize(6 * slice.slot_sat.size());
+    slice.status.resize(slice.slot_sat.size());
+    slice.dirty = false;
+}
+
+/*  Propagates the satellites of a slice over all the steps of a block. At each step, the batch is
+ *  propagated at once (each slot with its own time since epoch) and deep-space satellites are
+ *  propagated one by one. Unlike `TLEHistoricSet::propagate`, which computes points at whole
+ *  seconds from the rounded TLE epoch, all the satellites are propagated at the exact time of the
+ *  step, so that the GMST of the step is valid for all of them.
+ */
+void CatalogPropagator::propagateSlice(CatalogSlice & slice, CatalogBlock & block,
+    std::vector<CatalogError> & errors)
+{
+    const int n = block.sat_count;
+    double eci[6];
+    int status;
+
+    for(int s = 0; s < block.steps; s++) {
+        long step = block.first_step + s;
+        std::time_t t = block.time[s];
+
+        /* TLE selection for this step: */
+        for(int k = slice.first; k < slice.first + slice.count; k++) {
+            if(step >= sats[k].segment_end && sats[k].segment < sats[k].segments.size()) {
+                advance(slice, k, step);
+            }
+        }
+        if(slice.dirty) {
+            rebuild(slice);
+        }
+
+        /* Propagation: */
+        int slots = slice.slot_sat.size();
+        for(int i = 0; i < slots; i++) {
+            const CatalogSatellite & sat = sats[slice.slot_sat[i]];
+            slice.tsince[i] = (t - sat.segments[sat.segment].tle_time) / 60.0 + sat.epoch_offset;
+        }
+        if(slots > 0) {
+            double * st = &slice.state[0];
+            slice.batch.Propagate(&slice.tsince[0], st, st + slots, st + 2 * slots, st + 3 * slots,
+                st + 4 * slots, st + 5 * slots, &slice.status[0]);
+        }
+
+        /* Results: */
+        for(int k = slice.first; k < slice.first + slice.count; k++) {
+            block.valid[s * n + k] = 0;
+        }
+        for(int i = 0; i < slots + (int)slice.deep.size(); i++) {
+            int k = (i < slots ? slice.slot_sat[i] : slice.deep[i - slots]);
+            CatalogSatellite & sat = sats[k];
+            if(sat.failed || sat.segment >= sat.segments.size()) {
+                continue;
+            }
+            if(i < slots) {
+                for(int c = 0; c < 6; c++) {
+                    eci[c] = slice.state[c * slots + i];
+                }
+                status = slice.status[i];
+            } else {
+                double tsince = (t - sat.segments[sat.segment].tle_time) / 60.0 + sat.epoch_offset;
+                sat.segments[sat.segment].orbit->PositionEci(&tsince, 1, &eci[0], &eci[1], &eci[2],
+                    &eci[3], &eci[4], &eci[5], &status);
+            }
+            if(status != cSgp4Batch::STATUS_OK) {
+                errors.push_back({k, sat.segments[sat.segment].tle_index, step,
+                    (status == cSgp4Batch::STATUS_DECAYED ? "orbit decayed" : "Error in satellite data")});
+                sat.failed = true;
+                continue;
+            }
+            long p = s * n + k;
+            block.x[p]  = eci[0];
+            block.y[p]  = eci[1];
+            block.z[p]  = eci[2];
+            block.vx[p] = eci[3];
+            block.vy[p] = eci[4];
+            block.vz[p] = eci[5];
+            block.valid[p] = 1;
+            if(geodetic) {
+                Zeptomoby::OrbitTools::cGeo geo(Zeptomoby::OrbitTools::cVector(eci[0], eci[1], eci[2]), block.gmst[s]);
+                block.lat[p] = geo.LatitudeDeg();
+                block.lon[p] = (geo.LongitudeDeg() < 180 ? geo.LongitudeDeg() : geo.LongitudeDeg() - 360);
+            }
+        }
+    }
+}
+
+/*  Propagates the next block of steps. Returns false (and the block is not modified) when the
+ *  propagation end time has already been reached.
+ */
+bool CatalogPropagator::next(CatalogBlock & block)
+{
+    if(next_step >= step_count) {
+        return false;
+    }
+    int n = sats.size();
+    block.first_step = next_step;
+    block.steps = std::min((long)block_steps, step_count - next_step);
+    block.sat_count = n;
+    block.errors.clear();
+    block.time.resize(block.steps);
+    block.gmst.resize(block.steps);
+    for(std::vector<double> * v : { &block.x, &block.y, &block.z, &block.vx, &block.vy, &block.vz }) {
+        v->resize((std::size_t)block.steps * n);
+    }
+    block.lat.resize(geodetic ? (std::size_t)block.steps * n : 0);
+    block.lon.resize(geodetic ? (std::size_t)block.steps * n : 0);
+    block.valid.resize((std::size_t)block.steps * n);
+
+    /* Quantities shared by all the satellites: */
+    for(int s = 0; s < block.steps; s++) {
+        block.time[s] = prop_time_start + (next_step + s) * prop_time_step;
+        block.gmst[s] = Zeptomoby::OrbitTools::cJulian(block.time[s]).ToGmst();
+    }
+
+    std::vector<std::vector<CatalogError> > errors(slices.size());
+    if(pool != NULL && pool->size() > 1 && slices.size() > 1) {
+        for(std::size_t i = 0; i < slices.size(); i++) {
+            CatalogSlice * slice = &slices[i];
+            std::vector<CatalogError> * e = &errors[i];
+            pool->submit([this, slice, &block, e] { propagateSlice(*slice, block, *e); });
+        }
+        pool->wait();
+    } else {
+        for(std::size_t i = 0; i < slices.size(); i++) {
+            propagateSlice(slices[i], block, errors[i]);
+        }
+    }
+    for(auto e = errors.begin(); e != errors.end(); e++) {
+        block.errors.insert(block.errors.end(), e->begin(), e->end());
+    }
+    std::stable_sort(block.errors.begin(), block.errors.end(),
+        [](const CatalogError & a, const CatalogError & b) { return a.step < b.step; });
+    next_step += block.steps;
+    return true;
+}
+
+/*  Propagates the whole catalog and writes one `.prop` (or `.propb` or `.propz`) file per satellite,
+ *  just like `TLEHistoricSet::propagate` does, or a single catalog container (PROPC_FILE_NAME), as
+ *  given by the format of the catalog. Blocks are formatted (by slices, in the pool) and handed
+ *  over to `writer` (or written synchronously, if none is given) as they are propagated, so the next
+ *  block is propagated while the previous one is being written. Containers are written in the same
+ *  order: a block is a slice of the time axis. In compressed files (quantized to `resolution`
+ *  meters), each run of consecutive points of a satellite in a block is a chunk.
+ */
+void CatalogPropagator::propagate(int prop_n_points, bool quiet, OutputWriter * writer,
+    double resolution)
+{
+    OutputWriter sync_writer(false);    /* Used if no `writer` is given.                          */
+    std::vector<std::string> paths(sats.size());
+    std::vector<std::string> text(sats.size());
+    std::vector<long> points(sats.size(), 0);
+    std::string container_path = output_path_root + "/" PROPC_FILE_NAME;
+    std::string container;      /* Points of a block, in container mode.                          */
+    CatalogBlock block;
+    PropTimeFormatter time_formatter;
+    long points_written = 0;
+
+    if(format == PROP_FORMAT_CONTAINER) {
+        std::vector<PropContainerEntry> directory(sats.size());
+        for(std::size_t k = 0; k < sats.size(); k++) {
+            const std::vector<PropagationSegment> & segments = sats[k].segments;
+            directory[k].norad_id = getId(k);
+            directory[k].tles = segments.size();
+            directory[k].first_step = (segments.empty() ? 0 : segments.front().first_point);
+            directory[k].steps = (segments.empty() ? 0 :
+                segments.back().first_point + segments.back().points - directory[k].first_step);
+        }
+        createPropContainer(container_path, directory, prop_time_start, prop_time_end, prop_time_step,
+            prop_n_points, step_count);
+    } else {
+        for(std::size_t k = 0; k < sats.size(); k++) {
+            paths[k] = getPath(k);
+            createPropFile(paths[k], format, getId(k), prop_time_start, prop_time_end, prop_time_step,
+                prop_n_points, step_count, resolution);
+        }
+    }
+    if(writer == NULL) {
+        writer = &sync_writer;
+    }
+
+    rewind();
+    while(next(block)) {
+        /* Time stamps are formatted once per step: */
+        std::vector<std::array<char, 21> > time_formated(format == PROP_FORMAT_CSV ? block.steps : 0);
+        for(std::size_t s = 0; s < time_formated.size(); s++) {
+            memcpy(time_formated[s].data(), time_formatter.format(block.time[s]), 21);
+        }
+        /* Binary files have one record per step (with NaN's where the satellite is not valid): */
+        auto pack = [&](int first, int count) {
+            for(int k = first; k < first + count; k++) {
+                text[k].clear();
+                for(int s = 0; s < block.steps; s++) {
+                    long p = (long)s * block.sat_count + k;
+                    if(block.valid[p]) {
+                        packPoint(text[k], block.time[s], block.lat[p], block.lon[p], block.x[p], block.y[p],
+                            block.z[p], block.vx[p], block.vy[p], block.vz[p]);
+                        points[k]++;
+                    } else {
+                        packMissingPoints(text[k], block.time[s], prop_time_step, 1);
+                    }
+                }
+            }
+        };
+        /* Containers have every satellite at every step, in the same layout as the block: */
+        auto pack_container = [&](int first, int count) {
+            PropContainerPoint * out = (PropContainerPoint *)&container[0];
+            for(int s = 0; s < block.steps; s++) {
+                for(int k = first; k < first + count; k++) {
+                    long p = (long)s * block.sat_count + k;
+                    PropContainerPoint & c = out[p];
+                    if(block.valid[p]) {
+                        c.lat = block.lat[p];
+                        c.lon = block.lon[p];
+                        c.x = block.x[p];
+                        c.y = block.y[p];
+                        c.z = block.z[p];
+                        c.vx = block.vx[p];
+                        c.vy = block.vy[p];
+                        c.vz = block.vz[p];
+                        points[k]++;
+                    } else {
+                        c.lat = c.lon = c.x = c.y = c.z = c.vx = c.vy = c.vz = NAN;
+                    }
+                }
+            }
+        };
+        auto compress = [&](int first, int count) {
+            PropEncoder encoder(resolution);
+            for(int k = first; k < first + count; k++) {
+                text[k].clear();
+                for(int s = 0; s < block.steps; s++) {
+                    long p = (long)s * block.sat_count + k;
+                    if(!block.valid[p]) {
+                        encoder.finish(text[k]);
+                        continue;
+                    }
+                    if(s == 0 || !block.valid[p - block.sat_count]) {
+                        encoder.begin(block.time[s], prop_time_step);
+                    }
+                    encoder.add(block.lat[p], block.lon[p], block.x[p], block.y[p], block.z[p],
+                        block.vx[p], block.vy[p], block.vz[p]);
+                    points[k]++;
+                }
+                encoder.finish(text[k]);
+            }
+        };
+        auto format_csv = [&](int first, int count) {
+            char line[256];
+            for(int k = first; k < first + count; k++) {
+                text[k].clear();
+                for(int s = 0; s < block.steps; s++) {
+                    long p = (long)s * block.sat_count + k;
+                    if(block.valid[p]) {
+                        text[k].append(line, formatPoint(line, sizeof(line), time_formated[s].data(),
+                            block.time[s], block.lat[p], block.lon[p], block.x[p], block.y[p], block.z[p],
+                            block.vx[p], block.vy[p], block.vz[p]));
+                        points[k]++;
+                    }
+                }
+            }
+        };
+        std::function<void(int, int)> format_slice;
+        if(format == PROP_FORMAT_CONTAINER) {
+            container.resize((std::size_t)block.steps * block.sat_count * sizeof(PropContainerPoint));
+            format_slice = pack_container;
+        } else if(format == PROP_FORMAT_BINARY) {
+            format_slice = pack;
+        } else if(format == PROP_FORMAT_COMPRESSED) {
+            format_slice = compress;
+        } else {
+            format_slice = format_csv;
+        }
+        if(pool != NULL && pool->size() > 1 && slices.size() > 1) {
+            for(auto s = slices.begin(); s != slices.end(); s++) {
+                int first = s->first, count = s->count;
+                pool->submit([&format_slice, first, count] { format_slice(first, count); });
+            }
+            pool->wait();
+        } else {
+            format_slice(0, sats.size());
+        }
+
+        printErrors(block);
+        if(format == PROP_FORMAT_CONTAINER) {
+            writer->write(container_path, std::move(container));
+            container.clear();
+        }
+        for(std::size_t k = 0; k < sats.size(); k++) {
+            if(!text[k].empty()) {
+                writer->write(paths[k], std::move(text[k]));
+                text[k].clear();
+            }
+            points_written += points[k];
+            points[k] = 0;
+        }
+        if(!quiet) {
+            printf("  Catalog (%d satellites) [%3.0f%%] %ld pp.\r", (int)sats.size(),
+                (100.0 * (block.first_step + block.steps) / step_count), points_written);
+            fflush(stdout);
+        }
+    }
+    if(!quiet) {
+        printf("\n");
+    }
+}
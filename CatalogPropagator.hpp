@@ -0,0 +1,119 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: time-major catalog propagator.
+ *  \details    Propagates all the satellites of a catalog together, one time step after another.
+ *              Near-earth orbits are kept in structure-of-arrays SGP4 batches, and the date and
+ *              sidereal time of each step are computed once for all satellites, so that the state
+ *              of the whole catalog at a given instant is available for in-process analyses.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       14-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __CATALOG_PROPAGATOR__
+#define __CATALOG_PROPAGATOR__
+
+/*  A propagation error, found at a given step. The satellite is not propagated again until its
+ *  next TLE has to be used.
+ */
+struct CatalogError {
+    int sat;                    /* Satellite (position in the catalog).                           */
+    int tle_index;              /* Position of the TLE in the historic set (starting at 1).       */
+    long step;                  /* Step at which the error was found.                             */
+    std::string text;           /* Error description.                                             */
+};
+
+/*  State of the whole catalog over consecutive time steps. Arrays are step-major: the values of
+ *  satellite `k` at step `s` of the block are at `s * sat_count + k`.
+ */
+struct CatalogBlock {
+    long first_step;            /* Index of the first step (0 at the propagation start).          */
+    int steps;                  /* Steps in this block.                                           */
+    int sat_count;              /* Satellites in the catalog.                                     */
+    std::vector<std::time_t> time;      /* Time of each step (UNIX time).                         */
+    std::vector<double> gmst;           /* Greenwich Mean Sidereal Time of each step (radians).   */
+    std::vector<double> x, y, z;        /* ECI position (km).                                     */
+    std::vector<double> vx, vy, vz;     /* ECI velocity (km/s).                                   */
+    std::vector<double> lat, lon;       /* Geodetic coordinates (degrees, longitude in [-180, 180))
+                                         * if the propagator computes them.                       */
+    std::vector<unsigned char> valid;   /* Whether the satellite has been propagated.             */
+    std::vector<CatalogError> errors;   /* Errors found in this block.                            */
+};
+
+/* Propagation state of a satellite. */
+struct CatalogSatellite {
+    TLEHistoricSet * set;
+    std::vector<PropagationSegment> segments;
+    std::size_t segment;        /* Current segment (`segments.size()` when there are no more).    */
+    long segment_end;           /* First step that is not covered by the current segment.         */
+    double epoch_offset;        /* Minutes from the exact TLE epoch to `tle_time` (a rounded one). */
+    bool failed;                /* Set when the current segment can not be propagated any more.   */
+    int slot;                   /* Position in the SGP4 batch of its slice (-1 if not there).     */
+};
+
+/*  A group of consecutive satellites of the catalog that is propagated as a single job. Satellites
+ *  that are using a near-earth TLE are in the SGP4 batch, which is only rebuilt when one of them
+ *  switches to (or from) a deep-space orbit.
+ */
+struct CatalogSlice {
+    int first;                  /* First satellite.                                               */
+    int count;                  /* Number of satellites.                                          */
+    bool dirty;                 /* Whether the batch has to be rebuilt before the next step.      */
+    Zeptomoby::OrbitTools::cSgp4Batch batch;
+    std::vector<int> slot_sat;  /* Satellite in each slot of the batch.                           */
+    std::vector<int> deep;      /* Satellites that are using deep-space orbits.                   */
+    std::vector<double> tsince; /* Minutes past the epoch of each slot (for the current step).    */
+    std::vector<double> state;  /* Propagated state of each slot.                                 */
+    std::vector<int> status;    /* Propagation status of each slot.                               */
+
+    CatalogSlice() : first(0), count(0), dirty(true) { }
+};
+
+class WorkStealingPool;
+
+class CatalogPropagator
+{
+    std::string output_path_root;   /* Empty if no propagation files are written.                 */
+    PropFormat format;          /* Format of the propagation files (satellites are named after
+                                 * them in messages).                                             */
+    std::time_t prop_time_start;
+    std::time_t prop_time_end;
+    std::time_t prop_time_step;
+    long step_count;            /* Number of time steps.                                          */
+    long next_step;             /* First step of the next block.                                  */
+    int block_steps;            /* Maximum steps per block.                                       */
+    bool geodetic;              /* Whether latitudes and longitudes are computed.                 */
+    WorkStealingPool * pool;
+    std::vector<CatalogSatellite> sats;
+    std::deque<CatalogSlice> slices;
+
+    void select(CatalogSatellite & sat);
+    void advance(CatalogSlice & slice, int k, long step);
+    void rebuild(CatalogSlice & slice);
+    void propagateSlice(CatalogSlice & slice, CatalogBlock & block, std::vector<CatalogError> & errors);
+
+public:
+    CatalogPropagator(std::unordered_map<int, TLEHistoricSet> & tle_data, std::string output_path_root,
+        PropFormat format, std::time_t prop_time_start, std::time_t prop_time_end,
+        std::time_t prop_time_step, bool geodetic = true, WorkStealingPool * pool = NULL);
+    int getSatelliteCount(void) const;
+    int getId(int k) const;
+    long getStepCount(void) const;
+    std::time_t getTimeStart(void) const;
+    std::time_t getTimeEnd(void) const;
+    std::time_t getTimeStep(void) const;
+    std::string getPath(int k) const;
+    const std::vector<PropagationSegment> & getSegments(int k) const;
+    void exclude(int k);
+    int getState(int k, long step, double dt, double * eci) const;
+    void printErrors(const CatalogBlock & block) const;
+    bool next(CatalogBlock & block);
+    void rewind(void);
+    void propagate(int prop_n_points, bool quiet = false, OutputWriter * writer = NULL,
+        double resolution = PROPZ_RESOLUTION);
+};
+
+#endif /* __CATALOG_PROPAGATOR__ */
@@ -0,0 +1,357 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: Chebyshev ephemeris.
+ *  \details    Piecewise Chebyshev approximation of the position of a satellite. Each granule (a
+ *              time interval) holds one polynomial per ECI coordinate, which is fitted to SGP4/SDP4
+ *              output and split until the position error is below a given tolerance. Positions
+ *              and velocities (the derivative of the polynomials) can then be evaluated at any
+ *              instant with a few dozen floating-point operations.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       02-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+/*  Evaluates the three polynomials of degree `n` in `c` (Clenshaw's recurrence) at `x`, which is
+ *  the time mapped to [-1, 1].
+ */
+static inline void evaluateSeries(const double (*c)[CHEB_DEGREE + 1], int n, double x, double * out)
+{
+    double bx1 = 0.0, bx2 = 0.0;
+    double by1 = 0.0, by2 = 0.0;
+    double bz1 = 0.0, bz2 = 0.0;
+    double x2 = 2.0 * x;
+
+    for(int k = n; k >= 1; k--) {
+        double bx = x2 * bx1 - bx2 + c[0][k];
+        double by = x2 * by1 - by2 + c[1][k];
+        double bz = x2 * bz1 - bz2 + c[2][k];
+        bx2 = bx1; bx1 = bx;
+        by2 = by1; by1 = by;
+        bz2 = bz1; bz1 = bz;
+    }
+    out[0] = c[0][0] + x * bx1 - bx2;
+    out[1] = c[1][0] + x * by1 - by2;
+    out[2] = c[2][0] + x * bz1 - bz2;
+}
+
+/* Same as above, for the velocity coefficients (degree CHEB_DEGREE - 1). */
+static inline void evaluateDerivative(const double (*c)[CHEB_DEGREE], double x, double * out)
+{
+    double bx1 = 0.0, bx2 = 0.0;
+    double by1 = 0.0, by2 = 0.0;
+    double bz1 = 0.0, bz2 = 0.0;
+    double x2 = 2.0 * x;
+
+    for(int k = CHEB_DEGREE - 1; k >= 1; k--) {
+        double bx = x2 * bx1 - bx2 + c[0][k];
+        double by = x2 * by1 - by2 + c[1][k];
+        double bz = x2 * bz1 - bz2 + c[2][k];
+        bx2 = bx1; bx1 = bx;
+        by2 = by1; by1 = by;
+        bz2 = bz1; bz1 = bz;
+    }
+    out[0] = c[0][0] + x * bx1 - bx2;
+    out[1] = c[1][0] + x * by1 - by2;
+    out[2] = c[2][0] + x * bz1 - bz2;
+}
+
+/* Evaluates a granule at UNIX time `t`. */
+static inline void evaluateGranule(const ChebyshevGranule & g, double t, double * pos, double * vel)
+{
+    double x = (2.0 * t - g.t_start - g.t_end) / (g.t_end - g.t_start);
+    evaluateSeries(g.coef, CHEB_DEGREE, x, pos);
+    if(vel != NULL) {
+        evaluateDerivative(g.dcoef, x, vel);
+    }
+}
+
+ChebyshevEphemeris::ChebyshevEphemeris(double tolerance)
+    : tolerance(tolerance), max_pos_error(0.0), max_vel_error(0.0), coarse_granules(0)
+{
+}
+
+/*  Computes the velocity coefficients of a granule: the derivative of its position polynomials,
+ *  scaled from [-1, 1] to seconds.
+ */
+void ChebyshevEphemeris::deriveGranule(ChebyshevGranule & granule)
+{
+    double scale = 2.0 / (granule.t_end - granule.t_start);
+    for(int c = 0; c < 3; c++) {
+        const double * a = granule.coef[c];
+        double * d = granule.dcoef[c];
+        double d_next = 0.0;    /* d[k + 1] */
+        double d_next2 = 0.0;   /* d[k + 2] */
+        for(int k = CHEB_DEGREE - 1; k >= 0; k--) {
+            double dk = d_next2 + 2.0 * (k + 1) * a[k + 1];
+            d_next2 = d_next;
+            d_next = dk;
+            d[k] = dk;
+        }
+        d[0] *= 0.5;
+        for(int k = 0; k < CHEB_DEGREE; k++) {
+            d[k] *= scale;
+        }
+    }
+}
+
+/*  Fits the polynomials of a granule that spans [tt_start, tt_end] (seconds since the epoch of
+ *  the TLE, which is rounded to `tle_time`). The orbit is sampled at the Chebyshev nodes and then
+ *  compared with the fit at CHEB_CHECK_POINTS equally-spaced instants, ends included. Returns the
+ *  propagation status (see cSgp4Batch::eStatus) of the first point that fails, if any.
+ */
+int ChebyshevEphemeris::fitGranule(const Zeptomoby::OrbitTools::cOrbit & orbit, std::time_t tle_time,
+    double tt_start, double tt_end, ChebyshevGranule & granule, double * pos_error,
+    double * vel_error)
+{
+    const int n_nodes = CHEB_DEGREE + 1;
+    const int n_points = n_nodes + CHEB_CHECK_POINTS;
+    double half = 0.5 * (tt_end - tt_start);
+    double mid = 0.5 * (tt_end + tt_start);
+
+    std::vector<double> tsince(n_points);
+    std::vector<double> state(6 * n_points);
+    std::vector<int> status(n_points);
+    for(int k = 0; k < n_nodes; k++) {
+        tsince[k] = (mid + half * cos(M_PI * (k + 0.5) / n_nodes)) / 60.0;
+    }
+    for(int k = 0; k < CHEB_CHECK_POINTS; k++) {
+        tsince[n_nodes + k] = (tt_start + (tt_end - tt_start) * k / (CHEB_CHECK_POINTS - 1)) / 60.0;
+    }
+
+    double * p[6];
+    for(int c = 0; c < 6; c++) {
+        p[c] = &state[c * n_points];
+    }
+    if(orbit.PositionEci(&tsince[0], n_points, p[0], p[1], p[2], p[3], p[4], p[5], &status[0]) > 0) {
+        for(int k = 0; k < n_points; k++) {
+            if(status[k] != Zeptomoby::OrbitTools::cSgp4Batch::STATUS_OK) {
+                return status[k];
+            }
+        }
+    }
+
+    /* Coefficients (discrete Chebyshev transform of the values at the nodes): */
+    granule.t_start = tle_time + tt_start;
+    granule.t_end = tle_time + tt_end;
+    for(int c = 0; c < 3; c++) {
+        for(int j = 0; j < n_nodes; j++) {
+            double sum = 0.0;
+            for(int k = 0; k < n_nodes; k++) {
+                sum += p[c][k] * cos(M_PI * j * (k + 0.5) / n_nodes);
+            }
+            granule.coef[c][j] = (j == 0 ? 1.0 : 2.0) * sum / n_nodes;
+        }
+    }
+    deriveGranule(granule);
+
+    /* Errors at the check points: */
+    *pos_error = 0.0;
+    *vel_error = 0.0;
+    for(int k = n_nodes; k < n_points; k++) {
+        double pos[3], vel[3];
+        evaluateGranule(granule, tle_time + tsince[k] * 60.0, pos, vel);
+        double ep = sqrt((pos[0] - p[0][k]) * (pos[0] - p[0][k]) + (pos[1] - p[1][k]) * (pos[1] - p[1][k]) +
+            (pos[2] - p[2][k]) * (pos[2] - p[2][k]));
+        double ev = sqrt((vel[0] - p[3][k]) * (vel[0] - p[3][k]) + (vel[1] - p[4][k]) * (vel[1] - p[4][k]) +
+            (vel[2] - p[5][k]) * (vel[2] - p[5][k]));
+        *pos_error = std::max(*pos_error, ep);
+        *vel_error = std::max(*vel_error, ev);
+    }
+    return Zeptomoby::OrbitTools::cSgp4Batch::STATUS_OK;
+}
+
+/*  Appends the granules that cover [tt_start, tt_end] (seconds since the epoch of the TLE, which
+ *  is rounded to `tle_time`). The span is first cut in granules of half an orbital period, which
+ *  are halved until the position error is within tolerance or they reach CHEB_MIN_GRANULE
+ *  seconds (those are kept, and counted in `getCoarseGranules`). Errors are only measured at the
+ *  check points of each granule (see `fitGranule`), so they are not strict bounds. Returns false (with the reason in `error`) if the orbit can not be propagated; the
+ *  granules fitted before the failure are kept.
+ */
+bool ChebyshevEphemeris::fit(const Zeptomoby::OrbitTools::cOrbit & orbit, std::time_t tle_time,
+    double tt_start, double tt_end, std::string * error)
+{
+    if(tt_end <= tt_start) {
+        return true;
+    }
+
+    double span = std::max(orbit.Period() / 2.0, (double)CHEB_MIN_GRANULE);
+    int n_initial = (int)ceil((tt_end - tt_start) / span);
+    std::vector<std::pair<double, double> > pending;    /* Stack of granules left to fit.          */
+
+    for(int i = 0; i < n_initial; i++) {
+        pending.push_back(std::make_pair(tt_start + (tt_end - tt_start) * i / n_initial,
+            (i + 1 == n_initial ? tt_end : tt_start + (tt_end - tt_start) * (i + 1) / n_initial)));
+        while(!pending.empty()) {
+            std::pair<double, double> span_tt = pending.back();
+            pending.pop_back();
+
+            ChebyshevGranule granule;
+            double pos_error, vel_error;
+            int status = fitGranule(orbit, tle_time, span_tt.first, span_tt.second, granule,
+                &pos_error, &vel_error);
+            if(status == Zeptomoby::OrbitTools::cSgp4Batch::STATUS_DECAYED) {
+                *error = "orbit decayed";
+                return false;
+            } else if(status != Zeptomoby::OrbitTools::cSgp4Batch::STATUS_OK) {
+                *error = "Error in satellite data";
+                return false;
+            }
+
+            if(pos_error > tolerance && (span_tt.second - span_tt.first) >= 2.0 * CHEB_MIN_GRANULE) {
+                /* Split (the first half is fitted next): */
+                double tt_mid = 0.5 * (span_tt.first + span_tt.second);
+                pending.push_back(std::make_pair(tt_mid, span_tt.second));
+                pending.push_back(std::make_pair(span_tt.first, tt_mid));
+            } else {
+                granules.push_back(granule);
+                coarse_granules += (pos_error > tolerance ? 1 : 0);
+                max_pos_error = std::max(max_pos_error, pos_error);
+                max_vel_error = std::max(max_vel_error, vel_error);
+            }
+        }
+    }
+    return true;
+}
+
+/*  Position (km) and velocity (km/s, if `vel` is not NULL) at UNIX time `t`. Returns false if `t`
+ *  is not covered by the ephemeris. Times shared by two granules are evaluated in the first one, so
+ *  that, like in `.prop` files, the point at the epoch of a TLE is still taken from the previous one.
+ */
+bool ChebyshevEphemeris::evaluate(double t, double * pos, double * vel) const
+{
+    std::vector<ChebyshevGranule>::const_iterator g = std::lower_bound(granules.begin(), granules.end(), t,
+        [](const ChebyshevGranule & g, double t) { return g.t_end < t; });
+    if(g == granules.end() || t < g->t_start) {
+        return false;
+    }
+    evaluateGranule(*g, t, pos, vel);
+    return true;
+}
+
+/*  Writes the ephemeris in CSV format: a header with the tolerance and the errors found at the
+ *  check points, followed by one line per granule with its time span and the position coefficients
+ *  of x, y and z (in km).
+ */
+void ChebyshevEphemeris::write(std::FILE * file, std::time_t prop_time_start,
+    std::time_t prop_time_end) const
+{
+    struct tm tmp;
+    char time_formated[21];
+    time_t current_local_time = time(NULL);
+
+    localtime_r(&current_local_time, &tmp);
+    strftime(time_formated, 21, "%Y-%m-%d %T", &tmp);
+    fprintf(file, "File generation time,%s\n", time_formated);
+    fprintf(file, "Time (start),%lu\n", prop_time_start);
+    fprintf(file, "Time (end),%lu\n", prop_time_end);
+    fprintf(file, "Tolerance (km),%.9f\n", tolerance);
+    fprintf(file, "Max. position error at check points (km),%.9f\n", max_pos_error);
+    fprintf(file, "Max. velocity error at check points (km/s),%.9f\n", max_vel_error);
+    fprintf(file, "Granules above tolerance,%d\n", coarse_granules);
+    fprintf(file, "Degree,%d\n", CHEB_DEGREE);
+    fprintf(file, "Granules,%d\n", (int)granules.size());
+    fprintf(file, "t_start,t_end");
+    for(int c = 0; c < 3; c++) {
+        for(int k = 0; k <= CHEB_DEGREE; k++) {
+            fprintf(file, ",%c%d", "xyz"[c], k);
+        }
+    }
+    fprintf(file, "\n");
+
+    for(auto g = granules.begin(); g != granules.end(); g++) {
+        fprintf(file, "%.6f,%.6f", g->t_start, g->t_end);
+        for(int c = 0; c < 3; c++) {
+            for(int k = 0; k <= CHEB_DEGREE; k++) {
+                fprintf(file, ",%.17g", g->coef[c][k]);
+            }
+        }
+        fprintf(file, "\n");
+    }
+}
+
+/*  Reads an ephemeris file written by `write`, and the propagation span of its header (if the
+ *  pointers are not NULL). Returns false if the file can not be opened or its degree is not
+ *  CHEB_DEGREE.
+ */
+bool ChebyshevEphemeris::load(std::string path, std::time_t * prop_time_start,
+    std::time_t * prop_time_end)
+{
+    std::FILE * file;
+    char line[4096];
+    int degree = -1;
+    long t;
+
+    if((file = fopen(path.c_str(), "r")) == NULL) {
+        return false;
+    }
+    granules.clear();
+    while(fgets(line, sizeof(line), file) != NULL) {
+        if(sscanf(line, "Time (start),%ld", &t) == 1) {
+            if(prop_time_start != NULL) {
+                *prop_time_start = t;
+            }
+        } else if(sscanf(line, "Time (end),%ld", &t) == 1) {
+            if(prop_time_end != NULL) {
+                *prop_time_end = t;
+            }
+        } else if(sscanf(line, "Tolerance (km),%lf", &tolerance) == 1 ||
+            sscanf(line, "Max. position error at check points (km),%lf", &max_pos_error) == 1 ||
+            sscanf(line, "Max. velocity error at check points (km/s),%lf", &max_vel_error) == 1 ||
+            sscanf(line, "Granules above tolerance,%d", &coarse_granules) == 1) {
+            continue;
+        } else if(sscanf(line, "Degree,%d", &degree) == 1) {
+            if(degree != CHEB_DEGREE) {
+                break;
+            }
+        } else if(degree == CHEB_DEGREE && (line[0] >= '0' && line[0] <= '9')) {
+            ChebyshevGranule granule;
+            char * p = line;
+            granule.t_start = strtod(p, &p);
+            granule.t_end = strtod(p + 1, &p);
+            for(int c = 0; c < 3; c++) {
+                for(int k = 0; k <= CHEB_DEGREE; k++) {
+                    granule.coef[c][k] = strtod(p + 1, &p);
+                }
+            }
+            deriveGranule(granule);
+            granules.push_back(granule);
+        }
+    }
+    fclose(file);
+    return (degree == CHEB_DEGREE);
+}
+
+int ChebyshevEphemeris::getSize(void) const
+{
+    return granules.size();
+}
+
+double ChebyshevEphemeris::getStart(void) const
+{
+    return (granules.empty() ? 0.0 : granules.front().t_start);
+}
+
+double ChebyshevEphemeris::getEnd(void) const
+{
+    return (granules.empty() ? 0.0 : granules.back().t_end);
+}
+
+double ChebyshevEphemeris::getMaxPositionError(void) const
+{
+    return max_pos_error;
+}
+
+double ChebyshevEphemeris::getMaxVelocityError(void) const
+{
+    return max_vel_error;
+}
+
+int ChebyshevEphemeris::getCoarseGranules(void) const
+{
+    return coarse_granules;
+}
@@ -0,0 +1,59 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: Chebyshev ephemeris.
+ *  \details    Piecewise Chebyshev approximation of the position of a satellite. Each granule (a
+ *              time interval) holds one polynomial per ECI coordinate, which is fitted to SGP4/SDP4
+ *              output and split until the position error is below a given tolerance. Positions
+ *              and velocities (the derivative of the polynomials) can then be evaluated at any
+ *              instant with a few dozen floating-point operations.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       02-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __CHEBYSHEV_EPHEMERIS__
+#define __CHEBYSHEV_EPHEMERIS__
+
+/*  A time interval covered by a single set of polynomials. Times are UNIX times (in seconds, with
+ *  a fractional part). Positions are given in km and velocities in km/s.
+ */
+struct ChebyshevGranule {
+    double t_start;
+    double t_end;
+    double coef[3][CHEB_DEGREE + 1];    /* Position coefficients (x, y, z).                       */
+    double dcoef[3][CHEB_DEGREE];       /* Velocity coefficients (derived, not stored in files).  */
+};
+
+class ChebyshevEphemeris
+{
+    std::vector<ChebyshevGranule> granules;
+    double tolerance;           /* Maximum position error allowed when fitting (km).              */
+    double max_pos_error;       /* Maximum position error found at the check points (km).         */
+    double max_vel_error;       /* Maximum velocity error found at the check points (km/s).       */
+    int coarse_granules;        /* Granules above tolerance (i.e. CHEB_MIN_GRANULE seconds long). */
+
+    int fitGranule(const Zeptomoby::OrbitTools::cOrbit & orbit, std::time_t tle_time,
+        double tt_start, double tt_end, ChebyshevGranule & granule, double * pos_error,
+        double * vel_error);
+    static void deriveGranule(ChebyshevGranule & granule);
+
+public:
+    ChebyshevEphemeris(double tolerance = 0.0);
+    bool fit(const Zeptomoby::OrbitTools::cOrbit & orbit, std::time_t tle_time, double tt_start,
+        double tt_end, std::string * error);
+    bool evaluate(double t, double * pos, double * vel) const;
+    void write(std::FILE * file, std::time_t prop_time_start, std::time_t prop_time_end) const;
+    bool load(std::string path, std::time_t * prop_time_start = NULL,
+        std::time_t * prop_time_end = NULL);
+    int getSize(void) const;
+    double getStart(void) const;
+    double getEnd(void) const;
+    double getMaxPositionError(void) const;
+    double getMaxVelocityError(void) const;
+    int getCoarseGranules(void) const;
+};
+
+#endif /* __CHEBYSHEV_EPHEMERIS__ */
@@ -0,0 +1,372 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: times of closest approach.
+ *  \details    Finds the encounters of the satellites of a catalog, as it is being propagated in
+ *              time-major mode at a coarse step: the relative range-rate of every pair that may be
+ *              close is checked at consecutive steps and, when it changes from negative to positive,
+ *              the exact time of closest approach (TCA) is found with Brent's method on the
+ *              propagator. This replaces the high-rate propagations and the per-event minima of
+ *              `orblearnSingleEventAnalysis.m`.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       19-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+using Zeptomoby::OrbitTools::cSgp4Batch;
+
+/* Orders candidates by pair. */
+static bool pairLess(const ProximityCandidate & a, const ProximityCandidate & b)
+{
+    return a.i < b.i || (a.i == b.i && a.j < b.j);
+}
+
+/*  Relative position and velocity of satellite `j` with respect to `i` (6 values), at step `s` of
+ *  a block. Returns false if one of them has not been propagated.
+ */
+static bool relativeState(const CatalogBlock & block, int s, int i, int j, double * rel)
+{
+    const long o = (long)s * block.sat_count;
+    if(!block.valid[o + i] || !block.valid[o + j]) {
+        return false;
+    }
+    rel[0] = block.x[o + j] - block.x[o + i];
+    rel[1] = block.y[o + j] - block.y[o + i];
+    rel[2] = block.z[o + j] - block.z[o + i];
+    rel[3] = block.vx[o + j] - block.vx[o + i];
+    rel[4] = block.vy[o + j] - block.vy[o + i];
+    rel[5] = block.vz[o + j] - block.vz[o + i];
+    return true;
+}
+
+/* Range times range-rate (km^2/s): it has the sign of the range-rate and no singularity at 0. */
+static inline double rangeRate(const double * rel)
+{
+    return rel[0] * rel[3] + rel[1] * rel[4] + rel[2] * rel[5];
+}
+
+/* Whether a satellite starts using another TLE at a given step. */
+static bool switchesAt(const std::vector<PropagationSegment> & segments, long step)
+{
+    auto s = std::lower_bound(segments.begin(), segments.end(), step,
+        [](const PropagationSegment & segment, long p) { return segment.first_point < p; });
+    return s != segments.begin() && s != segments.end() && s->first_point == step;
+}
+
+/*  Finds a root of `f` in [a, b], given f(a) and f(b) with opposite signs, with Brent's method
+ *  (bisection, secant and inverse quadratic interpolation). `f` returns false if it can not be
+ *  evaluated, and so does this function.
+ */
+template <typename F>
+static bool brent(F f, double a, double b, double fa, double fb, double tolerance, double & root)
+{
+    double c = a, fc = fa, d = b - a, e = d;
+
+    for(int it = 0; it < TCA_MAX_ITERATIONS; it++) {
+        if((fb > 0.0) == (fc > 0.0)) {
+            c = a;
+            fc = fa;
+            d = e = b - a;
+        }
+        if(fabs(fc) < fabs(fb)) {
+            a = b;  b = c;  c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+        double tol = 2.0 * DBL_EPSILON * fabs(b) + 0.5 * tolerance;
+        double m = 0.5 * (c - b);
+        if(fabs(m) <= tol || fb == 0.0) {
+            root = b;
+            return true;
+        }
+        if(fabs(e) >= tol && fabs(fa) > fabs(fb)) {
+            double p, q, r, s = fb / fa;
+            if(a == c) {
+                p = 2.0 * m * s;
+                q = 1.0 - s;
+            } else {
+                q = fa / fc;
+                r = fb / fc;
+                p = s * (2.0 * m * q * (q - r) - (b - a) * (r - 1.0));
+                q = (q - 1.0) * (r - 1.0) * (s - 1.0);
+            }
+            if(p > 0.0) {
+                q = -q;
+            } else {
+                p = -p;
+            }
+            if(2.0 * p < std::min(3.0 * m * q - fabs(tol * q), fabs(e * q))) {
+                e = d;
+                d = p / q;
+            } else {
+                d = m;
+                e = m;
+            }
+        } else {
+            d = m;
+            e = m;
+        }
+        a = b;
+        fa = fb;
+        b += (fabs(d) > tol ? d : (m > 0.0 ? tol : -tol));
+        if(!f(b, fb)) {
+            return false;
+        }
+    }
+    root = b;
+    return true;
+}
+
+/*  Minimum distance (km) between two steps, `dt` seconds apart, of the cubic Hermite interpolation
+ *  of a relative state (given at both of them). The range-rate has to be negative at the first
+ *  step and positive at the second one.
+ */
+static double hermiteMinimum(const double * r0, const double * r1, double dt)
+{
+    double p[3];
+    auto f = [&](double t, double & value) {
+        double u = t / dt, u2 = u * u, u3 = u2 * u;
+        double h00 = 2.0 * u3 - 3.0 * u2 + 1.0, h10 = (u3 - 2.0 * u2 + u) * dt;
+        double h01 = -2.0 * u3 + 3.0 * u2,      h11 = (u3 - u2) * dt;
+        double d00 = (6.0 * u2 - 6.0 * u) / dt, d10 = 3.0 * u2 - 4.0 * u + 1.0;
+        double d01 = (6.0 * u - 6.0 * u2) / dt, d11 = 3.0 * u2 - 2.0 * u;
+        value = 0.0;
+        for(int q = 0; q < 3; q++) {
+            p[q] = h00 * r0[q] + h10 * r0[q + 3] + h01 * r1[q] + h11 * r1[q + 3];
+            value += p[q] * (d00 * r0[q] + d10 * r0[q + 3] + d01 * r1[q] + d11 * r1[q + 3]);
+        }
+        return true;
+    };
+    double t, f0, f1;
+
+    f(0.0, f0);
+    f(dt, f1);
+    brent(f, 0.0, dt, f0, f1, dt * TCA_HERMITE_TOLERANCE, t);
+    f(t, f0);
+    return sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+}
+
+ClosestApproach::ClosestApproach(const CatalogPropagator & catalog, std::string output_path, double d_max,
+    WorkStealingPool * pool)
+    : catalog(catalog), output_path(output_path), d_max(d_max), pool(pool),
+      screen(d_max, catalog.getTimeStep()), evaluations(0)
+{
+    last.steps = 0;
+}
+
+/* Screens step `s` of a block, with the padding of the distance covered in one step. */
+void ClosestApproach::screenStep(const CatalogBlock & block, int s)
+{
+    candidates[s].clear();
+    screen.screen(block, s, candidates[s]);
+    std::sort(candidates[s].begin(), candidates[s].end(), pairLess);
+}
+
+/*  Finds the encounters between step `s` of a block and the previous one. Only pairs that may be
+ *  close at one of both steps are checked: if their distance gets below `d_max` in between, it is
+ *  below `d_max` plus the padding at the nearest one.
+ */
+void ClosestApproach::searchInterval(const CatalogBlock & block, int s)
+{
+    const CatalogBlock & b0 = (s > 0 ? block : last);
+    const int s0 = (s > 0 ? s - 1 : 0);
+    const std::vector<ProximityCandidate> & c0 = (s > 0 ? candidates[s - 1] : last_candidates);
+    const std::vector<ProximityCandidate> & c1 = candidates[s];
+    const long step = block.first_step + s - 1;
+    const double dt = catalog.getTimeStep();
+    double r0[6], r1[6];
+
+    found[s].clear();
+    for(std::size_t x = 0, y = 0; x < c0.size() || y < c1.size(); ) {
+        /* Next pair in any of both lists: */
+        ProximityCandidate c;
+        if(y == c1.size() || (x < c0.size() && pairLess(c0[x], c1[y]))) {
+            c = c0[x++];
+        } else if(x == c0.size() || pairLess(c1[y], c0[x])) {
+            c = c1[y++];
+        } else {
+            c = c0[x++];
+            y++;
+        }
+        /*  Approaching at the first step and receding at the second one, and close enough in
+         *  between: the relative motion is interpolated from both steps, with an error that
+         *  grows with the fourth power of the step. When one of the satellites switches to another
+         *  TLE at the second step, the steps are not comparable and the pair is always refined
+         *  (with the TLE's of the first one).
+         */
+        if(!relativeState(b0, s0, c.i, c.j, r0) || !relativeState(block, s, c.i, c.j, r1)) {
+            continue;
+        }
+        bool switched = switchesAt(catalog.getSegments(c.i), step + 1) ||
+            switchesAt(catalog.getSegments(c.j), step + 1);
+        if(switched || (rangeRate(r0) < 0.0 && rangeRate(r1) >= 0.0 &&
+            hermiteMinimum(r0, r1, dt) <= d_max + TCA_HERMITE_ERROR * dt * dt * dt * dt)) {
+            ClosestApproachEvent event;
+            if(refine(c.i, c.j, step, event) && event.distance <= d_max) {
+                found[s].push_back(event);
+            }
+        }
+    }
+}
+
+/*  Finds the time of closest approach of a pair between a step and the next one. Like in the
+ *  sampled propagations, both satellites use the TLE's of the first step until the next one (even
+ *  if one of them switches to another TLE there). Returns false if the minimum is not bracketed
+ *  by both steps with those TLE's or a propagation fails.
+ */
+bool ClosestApproach::refine(int i, int j, long step, ClosestApproachEvent & event)
+{
+    double eci_i[6], eci_j[6], rel[6];
+    long count = 0;
+    auto f = [&](double dt, double & value) {
+        count++;
+        if(catalog.getState(i, step, dt, eci_i) != cSgp4Batch::STATUS_OK ||
+            catalog.getState(j, step, dt, eci_j) != cSgp4Batch::STATUS_OK) {
+            return false;
+        }
+        for(int q = 0; q < 6; q++) {
+            rel[q] = eci_j[q] - eci_i[q];
+        }
+        value = rangeRate(rel);
+        return true;
+    };
+    const double dt = catalog.getTimeStep();
+    double f0, f1, tca;
+    bool ok = f(0.0, f0) && f(dt, f1) && f0 < 0.0 && f1 >= 0.0 &&
+        brent(f, 0.0, dt, f0, f1, TCA_TOLERANCE, tca) && f(tca, f0);
+
+    evaluations += 2 * count;
+    if(ok) {
+        event.i = i;
+        event.j = j;
+        event.tca = catalog.getTimeStart() + step * dt + tca;
+        event.distance = sqrt(rel[0] * rel[0] + rel[1] * rel[1] + rel[2] * rel[2]);
+        event.velocity = sqrt(rel[3] * rel[3] + rel[4] * rel[4] + rel[5] * rel[5]);
+    }
+    return ok;
+}
+
+/*  Processes a block of steps: all of them are screened, and then the intervals that end at each
+ *  one of them are searched (the first one, with the last step of the previous block).
+ */
+void ClosestApproach::process(const CatalogBlock & block)
+{
+    bool concurrent = (pool != NULL && pool->size() > 1);
+
+    if((int)candidates.size() < block.steps) {
+        candidates.resize(block.steps);
+        found.resize(block.steps);
+    }
+    for(int pass = 0; pass < 2; pass++) {
+        for(int s = 0; s < block.steps; s++) {
+            if(pass == 1 && s == 0 && last.steps == 0) {
+                found[s].clear();
+                continue;
+            }
+            PoolJob job = [this, &block, s, pass] {
+                (pass == 0 ? screenStep(block, s) : searchInterval(block, s));
+            };
+            if(concurrent) {
+                pool->submit(job);
+            } else {
+                job();
+            }
+        }
+        if(concurrent) {
+            pool->wait();
+        }
+    }
+    for(int s = 0; s < block.steps; s++) {
+        events.insert(events.end(), found[s].begin(), found[s].end());
+    }
+
+    /* Last step, for the first interval of the next block: */
+    const int n = block.sat_count;
+    const long o = (long)(block.steps - 1) * n;
+    last.first_step = block.first_step + block.steps - 1;
+    last.steps = 1;
+    last.sat_count = n;
+    last.time.assign(1, block.time[block.steps - 1]);
+    last.x.assign(block.x.begin() + o, block.x.begin() + o + n);
+    last.y.assign(block.y.begin() + o, block.y.begin() + o + n);
+    last.z.assign(block.z.begin() + o, block.z.begin() + o + n);
+    last.vx.assign(block.vx.begin() + o, block.vx.begin() + o + n);
+    last.vy.assign(block.vy.begin() + o, block.vy.begin() + o + n);
+    last.vz.assign(block.vz.begin() + o, block.vz.begin() + o + n);
+    last.valid.assign(block.valid.begin() + o, block.valid.begin() + o + n);
+    last_candidates.swap(candidates[block.steps - 1]);
+}
+
+/*  Writes all the encounters, sorted by time, to `encounters.tca`. Times are given with
+ *  milliseconds; distances in km and velocities in km/s.
+ */
+void ClosestApproach::finish(void)
+{
+    std::FILE * file;
+    std::string path = output_path + "/encounters.tca";
+    struct tm tmp;
+    char time_formated[21];
+
+    std::stable_sort(events.begin(), events.end(), [](const ClosestApproachEvent & a, const ClosestApproachEvent & b) {
+        return a.tca < b.tca;
+    });
+    if((file = fopen(path.c_str(), "w")) == NULL) {
+        cerr << DBG_REDD "Unable to open file " << path << DBG_NOCOLOR << endl;
+        exit(-1);
+    }
+    time_t current_local_time = time(NULL);
+    localtime_r(&current_local_time, &tmp);
+    strftime(time_formated, 21, "%Y-%m-%d %T", &tmp);
+    fprintf(file, "File generation time,%s\n", time_formated);
+    fprintf(file, "Time (start),%lu\n", catalog.getTimeStart());
+    fprintf(file, "Time (end),%lu\n", catalog.getTimeEnd());
+    fprintf(file, "Time (step),%lu\n", catalog.getTimeStep());
+    fprintf(file, "Distance,%g\n", d_max);
+    fprintf(file, "Encounters,%lu\n", events.size());
+    fprintf(file, "NORAD ID (1),NORAD ID (2),Time,Timestamp,Distance,Velocity\n");
+    for(const ClosestApproachEvent & e : events) {
+        long long tca_ms = llround(e.tca * 1000.0);
+        std::time_t t = tca_ms / 1000;
+        int ms = tca_ms % 1000;
+        gmtime_r(&t, &tmp);
+        strftime(time_formated, 21, "%Y-%m-%d %T", &tmp);
+        fprintf(file, "%d,%d,%s.%03d,%.3f,%.6f,%.6f\n", std::min(catalog.getId(e.i), catalog.getId(e.j)),
+            std::max(catalog.getId(e.i), catalog.getId(e.j)), time_formated, ms, tca_ms / 1000.0, e.distance, e.velocity);
+    }
+    fclose(file);
+}
+
+/* Propagates the whole catalog and finds its encounters. */
+void ClosestApproach::compute(CatalogPropagator & catalog, bool quiet)
+{
+    CatalogBlock block;
+
+    catalog.rewind();
+    while(catalog.next(block)) {
+        catalog.printErrors(block);
+        process(block);
+        if(!quiet) {
+            printf("  Closest approaches [%3.0f%%] %lu encounters.\r",
+                (100.0 * (block.first_step + block.steps) / catalog.getStepCount()), events.size());
+            fflush(stdout);
+        }
+    }
+    finish();
+    if(!quiet) {
+        printf("\n");
+    }
+}
+
+long ClosestApproach::getEventCount(void) const
+{
+    return events.size();
+}
+
+/* Number of single-satellite propagations made to refine the encounters. */
+long ClosestApproach::getEvaluationCount(void) const
+{
+    return evaluations;
+}
@@ -0,0 +1,62 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: times of closest approach.
+ *  \details    Finds the encounters of the satellites of a catalog, as it is being propagated in
+ *              time-major mode at a coarse step: the relative range-rate of every pair that may be
+ *              close is checked at consecutive steps and, when it changes from negative to positive,
+ *              the exact time of closest approach (TCA) is found with Brent's method on the
+ *              propagator. This replaces the high-rate propagations and the per-event minima of
+ *              `orblearnSingleEventAnalysis.m`.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       19-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __CLOSEST_APPROACH__
+#define __CLOSEST_APPROACH__
+
+/* An encounter of two satellites: a local minimum of their distance, within `d_max`. */
+struct ClosestApproachEvent {
+    int i;                      /* Satellites (positions in the catalog, i < j).                  */
+    int j;
+    double tca;                 /* Time of closest approach (UNIX time, fractional).              */
+    double distance;            /* Miss distance (km).                                            */
+    double velocity;            /* Relative velocity at the TCA (km/s).                           */
+};
+
+class WorkStealingPool;
+
+class ClosestApproach
+{
+    const CatalogPropagator & catalog;  /* Used to propagate pairs between time steps.            */
+    std::string output_path;    /* Folder where the encounters file is written.                   */
+    double d_max;               /* Encounter distance (km).                                       */
+    WorkStealingPool * pool;
+    ProximityScreen screen;
+    std::vector<std::vector<ProximityCandidate> > candidates; /* Pairs that may be close at each
+                                 * step of the current block (sorted).                            */
+    std::vector<std::vector<ClosestApproachEvent> > found;    /* Encounters found in the interval
+                                 * that ends at each step of the current block.                   */
+    CatalogBlock last;          /* Last step of the previous block.                               */
+    std::vector<ProximityCandidate> last_candidates;
+    std::vector<ClosestApproachEvent> events;   /* All the encounters found so far.               */
+    std::atomic<long> evaluations;  /* Propagations made to refine the encounters.                */
+
+    void screenStep(const CatalogBlock & block, int s);
+    void searchInterval(const CatalogBlock & block, int s);
+    bool refine(int i, int j, long step, ClosestApproachEvent & event);
+
+public:
+    ClosestApproach(const CatalogPropagator & catalog, std::string output_path, double d_max,
+        WorkStealingPool * pool = NULL);
+    void process(const CatalogBlock & block);
+    void finish(void);
+    void compute(CatalogPropagator & catalog, bool quiet = false);
+    long getEventCount(void) const;
+    long getEvaluationCount(void) const;
+};
+
+#endif /* __CLOSEST_APPROACH__ */
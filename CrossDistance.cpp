@@ -0,0 +1,516 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: cross-distances.
+ *  \details    Computes the distance between every pair of satellites of a catalog, as it is being
+ *              propagated in time-major mode, and keeps the samples that are relevant to study
+ *              their encounters (i.e. when they are closer than a given distance), as well as the
+ *              times and amplitudes of those encounters. This replaces the cross-distance and event
+ *              computations in `orblearnLoad3.m`, `orblearnLoad4.m` and
+ *              `orblearnSingleEventAnalysis.m`.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       16-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+/*  Prepares the computation for all the pairs of satellites of `catalog`. Files are written in
+ *  `output_path` (see CrossDistanceHeader), only for pairs that get closer than `d_max`.
+ */
+CrossDistance::CrossDistance(const CatalogPropagator & catalog, std::string output_path, double d_max,
+    bool scan_intersec, WorkStealingPool * pool, bool write_samples)
+    : output_path(output_path), d_max(d_max), scan_intersec(scan_intersec), write_samples(write_samples),
+      pool(pool), screen(d_max, catalog.getTimeStep()), sample_count(0), event_count(0)
+{
+    sat_count = catalog.getSatelliteCount();
+    step_count = catalog.getStepCount();
+    for(int k = 0; k < sat_count; k++) {
+        ids.push_back(catalog.getId(k));
+    }
+    shards.resize(pool != NULL && pool->size() > 1 ? pool->size() * CROSS_SHARDS_PER_THREAD : 1);
+    last_valid.assign(sat_count, 1);
+    gaps.resize(sat_count);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CROSS_MAGIC, sizeof(header.magic));
+    header.version = CROSS_VERSION;
+    header.scan_intersec = scan_intersec;
+    header.time_start = catalog.getTimeStart();
+    header.time_end = catalog.getTimeEnd();
+    header.time_step = catalog.getTimeStep();
+    header.d_max = d_max;
+}
+
+int CrossDistance::shardOf(int i, int j) const
+{
+    return (int)(((uint32_t)i * 2654435761u + (uint32_t)j) % shards.size());
+}
+
+/*  Processes the sample of a pair at a given step, following the compression rules of
+ *  `orblearnLoad3.m`:
+ *      - Samples within `d_max` are kept.
+ *      - With `scan_intersec`, the samples right before and after each encounter are also kept
+ *        (with their distance clamped to `d_max`), as well as the first and last samples. Steps
+ *        at which a satellite could not be propagated are skipped, and treated like the end and
+ *        the start of the propagation.
+ *  Returns the number of samples kept.
+ */
+int CrossDistance::advance(CrossDistancePair & pair, long step, bool valid, bool in, float d)
+{
+    unsigned char & f = pair.flags;
+    std::vector<CrossDistanceSample> & out = pair.samples;
+    std::size_t size = out.size();
+
+    if(!in) {
+        d = d_max;
+    }
+    if(!scan_intersec) {
+        if(in) {
+            out.push_back({(uint32_t)step, d});
+        }
+    } else if(!valid) {
+        /* The previous sample is the last one before a gap: */
+        if((f & CROSS_STARTED) && !(f & (CROSS_GAP | CROSS_KEPT))) {
+            out.push_back({(uint32_t)(step - 1), (float)d_max});
+        }
+        f = (f & CROSS_STARTED) | CROSS_GAP;
+    } else if(!(f & CROSS_STARTED) || (f & CROSS_GAP)) {
+        /* First sample (or first one after a gap): */
+        out.push_back({(uint32_t)step, d});
+        f = CROSS_STARTED | CROSS_KEPT | (in ? CROSS_INSIDE : 0);
+    } else {
+        bool keep = false;
+        if(in) {
+            if(!(f & (CROSS_INSIDE | CROSS_KEPT))) {
+                out.push_back({(uint32_t)(step - 1), (float)d_max});
+            }
+            keep = true;
+        } else {
+            keep = (f & CROSS_INSIDE) || (step == step_count - 1);
+        }
+        if(keep) {
+            out.push_back({(uint32_t)step, d});
+        }
+        f = CROSS_STARTED | (keep ? CROSS_KEPT : 0) | (in ? CROSS_INSIDE : 0);
+    }
+    return out.size() - size;
+}
+
+/*  Distance (km) between two satellites at step `s` of a block (-1 is the last step of the previous
+ *  block). Returns false if one of them has not been propagated at that step.
+ */
+bool CrossDistance::distanceAt(const CatalogBlock & block, int s, int i, int j, float & d) const
+{
+    const double * a, * b;
+    if(s >= 0) {
+        const long o = (long)s * block.sat_count;
+        if(!block.valid[o + i] || !block.valid[o + j]) {
+            return false;
+        }
+        double ex = block.x[o + j] - block.x[o + i];
+        double ey = block.y[o + j] - block.y[o + i];
+        double ez = block.z[o + j] - block.z[o + i];
+        d = sqrt(ex * ex + ey * ey + ez * ez);
+        return true;
+    }
+    if(last_position_valid.empty() || !last_position_valid[i] || !last_position_valid[j]) {
+        return false;
+    }
+    a = &last_position[3 * i];
+    b = &last_position[3 * j];
+    d = sqrt((b[0] - a[0]) * (b[0] - a[0]) + (b[1] - a[1]) * (b[1] - a[1]) + (b[2] - a[2]) * (b[2] - a[2]));
+    return true;
+}
+
+/*  Follows the encounter events of a pair at a given step, like `orblearnLoad4.m` does with the
+ *  whole distance vector: an event starts when the distance gets below `d_max` and ends when it
+ *  gets above it again, and both times are interpolated linearly between the samples at either
+ *  side. The distance `d` is only known if the pair is within `d_max` (`in`); otherwise it is
+ *  computed here when needed. Returns the number of events completed.
+ */
+int CrossDistance::track(CrossDistancePair & pair, const CatalogBlock & block, int s, bool valid, bool in, float d)
+{
+    const long step = block.first_step + s;
+    const double dt = (double)header.time_step;
+    const double t = (double)header.time_start + step * dt;
+    CrossDistanceEvent & e = pair.event;
+    double end = 0.0;
+    bool close = false;
+    float d_prev;
+
+    if(!valid) {
+        /* One of the satellites could not be propagated: the event ends at the previous sample. */
+        if(pair.open) {
+            end = t - dt;
+            e.flags |= CROSS_EVENT_OPEN_END;
+            close = true;
+        }
+    } else if(in && !pair.open) {
+        e.flags = 0;
+        e.amplitude = d;
+        if(distanceAt(block, s - 1, pair.i, pair.j, d_prev) && d_prev > d_max) {
+            e.start = t - dt + dt * (d_prev - d_max) / (d_prev - d);
+        } else {
+            e.start = t;
+            e.flags |= CROSS_EVENT_OPEN_START;
+        }
+        e.t1 = e.start - pair.last_end;
+        pair.open = true;
+    } else if(in) {
+        e.amplitude = std::min(e.amplitude, d);
+    } else if(pair.open) {
+        distanceAt(block, s, pair.i, pair.j, d);
+        end = t - dt + dt * (d_max - pair.last_distance) / (d - pair.last_distance);
+        close = true;
+    }
+    pair.last_distance = d;
+    if(pair.open && !close && step == step_count - 1) {
+        end = t;
+        e.flags |= CROSS_EVENT_OPEN_END;
+        close = true;
+    }
+    if(close) {
+        e.t2 = end - e.start;
+        pair.events.push_back(e);
+        pair.last_end = end;
+        pair.open = false;
+    }
+    return (close ? 1 : 0);
+}
+
+/* Processes a pair at step `s` of a block: its samples (if they are written) and its events. */
+void CrossDistance::update(CrossDistancePair & pair, const CatalogBlock & block, int s, bool valid,
+    bool in, float d, long & kept, long & found)
+{
+    const long step = block.first_step + s;
+    if(write_samples) {
+        kept += advance(pair, step, valid, in, (in ? d : (float)d_max));
+    }
+    found += track(pair, block, s, valid, in, d);
+    pair.processed = step;
+}
+
+/*  Brings a pair that is found within `d_max` for the first time at `step` to the state it would
+ *  have if it had been processed at every step before. All those samples were outside `d_max`, so
+ *  only the first and the last step of each interval at which both satellites were propagated
+ *  matter. Returns the number of samples kept.
+ */
+int CrossDistance::replay(CrossDistancePair & pair, long step)
+{
+    std::vector<std::pair<long, long> > pair_gaps;
+    int kept = 0;
+    long first = 0;                     /* First step of the current interval.                    */
+
+    for(int k : { pair.i, pair.j }) {
+        for(const std::pair<long, long> & g : gaps[k]) {
+            if(g.first < step) {
+                pair_gaps.push_back(g);
+            }
+        }
+    }
+    std::sort(pair_gaps.begin(), pair_gaps.end());
+    for(const std::pair<long, long> & g : pair_gaps) {
+        if(g.first > first) {
+            kept += advance(pair, first, true, false, d_max);
+            if(g.first - 1 > first) {
+                kept += advance(pair, g.first - 1, true, false, d_max);
+            }
+            kept += advance(pair, g.first, false, false, d_max);
+        }
+        first = std::max(first, g.second);
+    }
+    if(step > first) {
+        kept += advance(pair, first, true, false, d_max);
+        if(step - 1 > first) {
+            kept += advance(pair, step - 1, true, false, d_max);
+        }
+    }
+    return kept;
+}
+
+/*  Screens steps [first, last) of a block and sorts the pairs that are within `d_max` by shard.
+ *  The screening distance is `d_max` itself, so the padding of the grid only makes its cells
+ *  larger than they need to be for this purpose.
+ */
+void CrossDistance::screenSteps(const CatalogBlock & block, int first, int last)
+{
+    std::vector<ProximityCandidate> candidates;
+
+    for(int s = first; s < last; s++) {
+        candidates.clear();
+        screen.screen(block, s, candidates);
+        for(const ProximityCandidate & c : candidates) {
+            if(c.distance <= d_max) {
+                hits[s][shardOf(c.i, c.j)].push_back(c);
+            }
+        }
+    }
+}
+
+/*  Processes the pairs of a shard for all the steps of a block. At each step, the pairs that are
+ *  within `d_max` are processed, as well as the ones that were within `d_max` (or kept a sample) at
+ *  the previous step, the ones whose satellites start or stop being propagated, and all of them
+ *  at the last step. Any other pair is outside `d_max` and does not keep the sample.
+ */
+void CrossDistance::processShard(const CatalogBlock & block, int k)
+{
+    CrossDistanceShard & shard = shards[k];
+    std::vector<unsigned char> changed(sat_count, 0);
+    std::vector<int> next;
+    long kept = 0;
+    long found = 0;
+
+    for(int s = 0; s < block.steps; s++) {
+        const long step = block.first_step + s;
+        const unsigned char * valid = &block.valid[(long)s * block.sat_count];
+        next.clear();
+
+        for(const ProximityCandidate & c : hits[s][k]) {
+            uint64_t key = ((uint64_t)c.i << 32) | (uint64_t)c.j;
+            auto it = shard.index.find(key);
+            int p;
+            if(it == shard.index.end()) {
+                p = shard.pairs.size();
+                shard.pairs.emplace_back();
+                CrossDistancePair & pair = shard.pairs.back();
+                pair.i = c.i;
+                pair.j = c.j;
+                pair.flags = 0;
+                pair.created = false;
+                pair.processed = -1;
+                pair.events_created = false;
+                pair.open = false;
+                pair.last_distance = d_max;
+                pair.last_end = (double)header.time_start;
+                shard.index.emplace(key, p);
+                if(scan_intersec && write_samples) {
+                    kept += replay(shard.pairs[p], step);
+                }
+            } else {
+                p = it->second;
+            }
+            CrossDistancePair & pair = shard.pairs[p];
+            update(pair, block, s, true, true, (float)c.distance, kept, found);
+            if((pair.flags & (CROSS_INSIDE | CROSS_KEPT)) || pair.open) {
+                next.push_back(p);
+            }
+        }
+        for(int p : shard.active) {
+            CrossDistancePair & pair = shard.pairs[p];
+            if(pair.processed != step) {
+                update(pair, block, s, valid[pair.i] && valid[pair.j], false, d_max, kept, found);
+                if((pair.flags & (CROSS_INSIDE | CROSS_KEPT)) || pair.open) {
+                    next.push_back(p);
+                }
+            }
+        }
+        bool last_step = (step == step_count - 1);
+        if(scan_intersec && write_samples && (!changes[s].empty() || last_step)) {
+            for(int c : changes[s]) {
+                changed[c] = 1;
+            }
+            for(std::size_t p = 0; p < shard.pairs.size(); p++) {
+                CrossDistancePair & pair = shard.pairs[p];
+                if(pair.processed != step && (last_step || changed[pair.i] || changed[pair.j])) {
+                    update(pair, block, s, valid[pair.i] && valid[pair.j], false, d_max, kept, found);
+                    if((pair.flags & (CROSS_INSIDE | CROSS_KEPT)) || pair.open) {
+                        next.push_back(p);
+                    }
+                }
+            }
+            for(int c : changes[s]) {
+                changed[c] = 0;
+            }
+        }
+        shard.active.swap(next);
+    }
+    sample_count += kept;
+    event_count += found;
+}
+
+/* Writes the pending samples and events of a pair in their files. */
+void CrossDistance::flush(CrossDistancePair & pair)
+{
+    std::FILE * file;
+    std::string name = std::to_string(ids[pair.i]) + "-" + std::to_string(ids[pair.j]);
+    std::string path;
+    CrossDistanceHeader h = header;
+
+    h.norad_id[0] = ids[pair.i];
+    h.norad_id[1] = ids[pair.j];
+    if(!pair.samples.empty()) {
+        path = output_path + "/cds_" + name + ".cdb";
+        if((file = fopen(path.c_str(), (pair.created ? "ab" : "wb"))) == NULL) {
+            cerr << DBG_REDD "Unable to open file " << path << DBG_NOCOLOR << endl;
+            exit(-1);
+        }
+        if(!pair.created) {
+            fwrite(&h, sizeof(h), 1, file);
+            pair.created = true;
+        }
+        fwrite(&pair.samples[0], sizeof(CrossDistanceSample), pair.samples.size(), file);
+        fclose(file);
+        pair.samples.clear();
+    }
+    if(!pair.events.empty()) {
+        path = output_path + "/cde_" + name + ".cde";
+        if((file = fopen(path.c_str(), (pair.events_created ? "ab" : "wb"))) == NULL) {
+            cerr << DBG_REDD "Unable to open file " << path << DBG_NOCOLOR << endl;
+            exit(-1);
+        }
+        if(!pair.events_created) {
+            memcpy(h.magic, CROSS_EVENT_MAGIC, sizeof(h.magic));
+            fwrite(&h, sizeof(h), 1, file);
+            pair.events_created = true;
+        }
+        fwrite(&pair.events[0], sizeof(CrossDistanceEvent), pair.events.size(), file);
+        fclose(file);
+        pair.events.clear();
+    }
+}
+
+/*  Writes the samples and events of the pairs of a shard: those with at least CROSS_FLUSH_SAMPLES
+ *  samples or CROSS_FLUSH_EVENTS events or, if `all` is set, all of them.
+ */
+void CrossDistance::flushShard(int k, bool all)
+{
+    for(CrossDistancePair & pair : shards[k].pairs) {
+        if((!pair.samples.empty() && (all || pair.samples.size() >= CROSS_FLUSH_SAMPLES)) ||
+            (!pair.events.empty() && (all || pair.events.size() >= CROSS_FLUSH_EVENTS))) {
+            flush(pair);
+        }
+    }
+}
+
+void CrossDistance::process(const CatalogBlock & block)
+{
+    bool concurrent = (pool != NULL && pool->size() > 1);
+
+    if((int)hits.size() < block.steps) {
+        hits.resize(block.steps, std::vector<std::vector<ProximityCandidate> >(shards.size()));
+        changes.resize(block.steps);
+    }
+    for(int s = 0; s < block.steps; s++) {
+        for(std::vector<ProximityCandidate> & h : hits[s]) {
+            h.clear();
+        }
+        changes[s].clear();
+    }
+
+    /* Satellites that start or stop being propagated: */
+    for(int s = 0; s < block.steps; s++) {
+        const long step = block.first_step + s;
+        for(int k = 0; k < sat_count; k++) {
+            unsigned char v = block.valid[(long)s * block.sat_count + k];
+            if(v != last_valid[k]) {
+                changes[s].push_back(k);
+                if(!v) {
+                    gaps[k].push_back(std::make_pair(step, step_count));
+                } else {
+                    gaps[k].back().second = step;
+                }
+                last_valid[k] = v;
+            }
+        }
+    }
+
+    for(int s = 0; s < block.steps; s++) {
+        if(concurrent) {
+            pool->submit([this, &block, s] { screenSteps(block, s, s + 1); });
+        } else {
+            screenSteps(block, s, s + 1);
+        }
+    }
+    if(concurrent) {
+        pool->wait();
+    }
+
+    for(int k = 0; k < (int)shards.size(); k++) {
+        PoolJob job = [this, &block, k] {
+            processShard(block, k);
+            flushShard(k, false);
+        };
+        if(concurrent) {
+            pool->submit(job);
+        } else {
+            job();
+        }
+    }
+    if(concurrent) {
+        pool->wait();
+    }
+
+    /* Positions at the last step, to interpolate the events that start at the next one: */
+    const long o = (long)(block.steps - 1) * sat_count;
+    last_position.resize(3 * sat_count);
+    last_position_valid.assign(block.valid.begin() + o, block.valid.begin() + o + sat_count);
+    for(int k = 0; k < sat_count; k++) {
+        last_position[3 * k]     = block.x[o + k];
+        last_position[3 * k + 1] = block.y[o + k];
+        last_position[3 * k + 2] = block.z[o + k];
+    }
+}
+
+/* Writes the remaining samples and events (once all the blocks have been processed). */
+void CrossDistance::finish(void)
+{
+    for(int k = 0; k < (int)shards.size(); k++) {
+        if(pool != NULL && pool->size() > 1) {
+            pool->submit([this, k] { flushShard(k, true); });
+        } else {
+            flushShard(k, true);
+        }
+    }
+    if(pool != NULL && pool->size() > 1) {
+        pool->wait();
+    }
+}
+
+/* Propagates the whole catalog and computes the cross-distances of all pairs. */
+void CrossDistance::compute(CatalogPropagator & catalog, bool quiet)
+{
+    CatalogBlock block;
+
+    catalog.rewind();
+    while(catalog.next(block)) {
+        catalog.printErrors(block);
+        process(block);
+        if(!quiet) {
+            printf("  Cross-distances (%ld pairs) [%3.0f%%] %ld samples.\r", getPairCount(),
+                (100.0 * (block.first_step + block.steps) / step_count), getSampleCount());
+            fflush(stdout);
+        }
+    }
+    finish();
+    if(!quiet) {
+        printf("\n");
+    }
+}
+
+long CrossDistance::getPairCount(void) const
+{
+    return (long)sat_count * (sat_count - 1) / 2;
+}
+
+/* Number of pairs that have been within `d_max` (i.e. the files written). */
+long CrossDistance::getEncounterPairCount(void) const
+{
+    long count = 0;
+    for(const CrossDistanceShard & shard : shards) {
+        count += shard.pairs.size();
+    }
+    return count;
+}
+
+long CrossDistance::getSampleCount(void) const
+{
+    return sample_count;
+}
+
+long CrossDistance::getEventCount(void) const
+{
+    return event_count;
+}
@@ -0,0 +1,149 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: cross-distances.
+ *  \details    Computes the distance between every pair of satellites of a catalog, as it is being
+ *              propagated in time-major mode, and keeps the samples that are relevant to study
+ *              their encounters (i.e. when they are closer than a given distance). This replaces
+ *              the cross-distance computation in `orblearnLoad3.m`.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       16-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __CROSS_DISTANCE__
+#define __CROSS_DISTANCE__
+
+/*  Cross-distance file layout (native byte order), one file per pair of satellites:
+ *      CrossDistanceHeader
+ *      CrossDistanceSample[]               Until the end of the file, sorted by step.
+ */
+struct CrossDistanceHeader {
+    char magic[8];              /* CROSS_MAGIC.                                                   */
+    uint32_t version;           /* CROSS_VERSION.                                                 */
+    uint32_t scan_intersec;     /* Whether the samples next to each encounter are kept.           */
+    int32_t norad_id[2];        /* Satellites (the lowest NORAD ID first).                        */
+    int64_t time_start;         /* Propagation start (UNIX time).                                 */
+    int64_t time_end;           /* Propagation end (UNIX time).                                   */
+    int64_t time_step;          /* Propagation step (in seconds).                                 */
+    double d_max;               /* Encounter distance (km).                                       */
+};
+
+struct CrossDistanceSample {
+    uint32_t step;              /* The sample time is `time_start + step * time_step`.            */
+    float distance;             /* Distance (km), clamped to `d_max` outside encounters.          */
+};
+
+/*  Encounter event file layout (native byte order), one file per pair of satellites:
+ *      CrossDistanceHeader                 With CROSS_EVENT_MAGIC.
+ *      CrossDistanceEvent[]                Until the end of the file, sorted by time.
+ *  Like in `orblearnLoad4.m`, the period of each event (t3) is `t1 + t2`.
+ */
+struct CrossDistanceEvent {
+    double start;               /* Time at which the distance gets below `d_max` (UNIX time).     */
+    double t1;                  /* Time since the end of the previous event (seconds), or since
+                                 * the propagation start for the first one.                       */
+    double t2;                  /* Duration (seconds).                                            */
+    float amplitude;            /* Minimum distance (km) sampled during the event.                */
+    uint32_t flags;             /* CROSS_EVENT_* flags.                                           */
+};
+
+/*  Event start and end times are interpolated between the samples at both sides of `d_max`, unless
+ *  they can not be: the event is already on at the first sample (propagation start, or after a
+ *  satellite could not be propagated) or still on at the last one.
+ */
+enum {
+    CROSS_EVENT_OPEN_START = 0x01,  /* The start is the first sample of the event.               */
+    CROSS_EVENT_OPEN_END   = 0x02   /* The end is the last sample of the event.                  */
+};
+
+/*  Compression state of a pair. Samples are processed in time order, and only a few flags of the
+ *  previous sample are needed to decide which ones are kept.
+ */
+enum {
+    CROSS_STARTED = 0x01,       /* A valid sample has been processed.                             */
+    CROSS_INSIDE  = 0x02,       /* The previous sample was within `d_max`.                        */
+    CROSS_KEPT    = 0x04,       /* The previous sample was kept.                                  */
+    CROSS_GAP     = 0x08        /* One of the satellites could not be propagated (previous step). */
+};
+
+/*  A pair of satellites that has been within `d_max`. Pairs are only tracked from then on: until
+ *  that step, all their samples were outside `d_max` and the ones that have to be kept are known.
+ */
+struct CrossDistancePair {
+    int i;                      /* Satellites (positions in the catalog, i < j).                  */
+    int j;
+    unsigned char flags;        /* Compression state.                                             */
+    bool created;               /* Whether its file exists.                                       */
+    long processed;             /* Last step at which the pair has been processed.                */
+    std::vector<CrossDistanceSample> samples;   /* Samples not written yet.                       */
+    bool events_created;        /* Whether its event file exists.                                 */
+    bool open;                  /* Whether an event is on (i.e. the last sample was within `d_max`). */
+    float last_distance;        /* Distance at the last sample, while an event is on.             */
+    double last_end;            /* End of the previous event (or the propagation start).          */
+    CrossDistanceEvent event;   /* Current event.                                                 */
+    std::vector<CrossDistanceEvent> events;     /* Events not written yet.                        */
+};
+
+/* Pairs are split in shards, which are processed concurrently. */
+struct CrossDistanceShard {
+    std::vector<CrossDistancePair> pairs;
+    std::unordered_map<uint64_t, int> index;    /* Position of each pair (key: i << 32 | j).      */
+    std::vector<int> active;    /* Pairs that have to be processed at the next step, even if they
+                                 * are not within `d_max` (i.e. after an encounter).              */
+};
+
+class WorkStealingPool;
+
+class CrossDistance
+{
+    std::string output_path;    /* Folder where files are written.                                */
+    double d_max;               /* Encounter distance (km).                                       */
+    bool scan_intersec;         /* Whether the samples next to each encounter are kept.           */
+    bool write_samples;         /* Whether samples are written (events are always written).       */
+    WorkStealingPool * pool;
+    std::vector<int> ids;       /* NORAD ID of each satellite (in catalog order).                 */
+    CrossDistanceHeader header;
+    long step_count;            /* Total number of steps.                                         */
+    int sat_count;
+    ProximityScreen screen;
+    std::vector<CrossDistanceShard> shards;
+    std::vector<std::vector<std::vector<ProximityCandidate> > > hits; /* Pairs within `d_max` at
+                                 * each step of the current block, by shard.                      */
+    std::vector<std::vector<int> > changes; /* Satellites whose validity changes at each step of
+                                 * the current block.                                             */
+    std::vector<unsigned char> last_valid;  /* Validity of each satellite at the previous step.   */
+    std::vector<std::vector<std::pair<long, long> > > gaps; /* Steps [first, last) at which each
+                                 * satellite could not be propagated.                             */
+    std::vector<double> last_position;      /* Positions at the last step of the previous block. */
+    std::vector<unsigned char> last_position_valid;
+    std::atomic<long> sample_count;         /* Samples kept so far.                               */
+    std::atomic<long> event_count;          /* Events found so far.                               */
+
+    int shardOf(int i, int j) const;
+    bool distanceAt(const CatalogBlock & block, int s, int i, int j, float & d) const;
+    int advance(CrossDistancePair & pair, long step, bool valid, bool in, float d);
+    int track(CrossDistancePair & pair, const CatalogBlock & block, int s, bool valid, bool in, float d);
+    void update(CrossDistancePair & pair, const CatalogBlock & block, int s, bool valid, bool in,
+        float d, long & kept, long & found);
+    int replay(CrossDistancePair & pair, long step);
+    void screenSteps(const CatalogBlock & block, int first, int last);
+    void processShard(const CatalogBlock & block, int k);
+    void flushShard(int k, bool all);
+    void flush(CrossDistancePair & pair);
+
+public:
+    CrossDistance(const CatalogPropagator & catalog, std::string output_path, double d_max,
+        bool scan_intersec = true, WorkStealingPool * pool = NULL, bool write_samples = true);
+    void process(const CatalogBlock & block);
+    void finish(void);
+    void compute(CatalogPropagator & catalog, bool quiet = false);
+    long getPairCount(void) const;
+    long getEncounterPairCount(void) const;
+    long getSampleCount(void) const;
+    long getEventCount(void) const;
+};
+
+#endif /* __CROSS_DISTANCE__ */
@@ -0,0 +1,345 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: orbit-geometry pre-filters.
+ *  \details    Discards pairs of satellites that can not get closer than a given distance during
+ *              the propagation span, from their mean elements alone (i.e. before any time sampling):
+ *              apogee/perigee shells that do not overlap, orbital paths that are too far apart at
+ *              the line where their planes cross, and passes through that line that never happen
+ *              at the same time.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       18-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+using namespace Zeptomoby::OrbitTools;
+
+/* Mean elements of an orbit at a given time, with the secular terms of SGP4/SDP4. */
+struct OrbitFilterElements {
+    double a, e, i, raan, argp, m;
+};
+
+static OrbitFilterElements secularElements(const cOrbitRecord & rec, double tsince)
+{
+    OrbitFilterElements el;
+    double tempa = 1.0 - rec.m_c1 * tsince;
+
+    el.a = rec.m_aeAxisSemiMajorRec * XKMPER_WGS72 * tempa * tempa;
+    el.i = rec.m_Inclination;
+    el.raan = rec.m_RAAN + rec.m_xnodot * tsince + rec.m_xnodcf * tsince * tsince;
+    el.argp = rec.m_ArgPerigee + rec.m_omgdot * tsince;
+    el.m = rec.m_MeanAnomaly + rec.m_xmdot * tsince + rec.m_rmMeanMotionRec * rec.m_t2cof * tsince * tsince;
+    if(rec.m_Model == cOrbitRecord::MODEL_SDP4) {
+        el.e = rec.m_Eccentricity + rec.m_Deep.sse * tsince;
+        el.i += rec.m_Deep.ssi * tsince;
+        el.raan += rec.m_Deep.ssh * tsince;
+        el.argp += rec.m_Deep.ssg * tsince;
+        el.m += rec.m_Deep.ssl * tsince;
+    } else {
+        el.e = rec.m_Eccentricity - rec.m_BStar * rec.m_c4 * tsince;
+    }
+    el.e = std::min(std::max(el.e, 0.0), 0.999);
+    return el;
+}
+
+/* Mean anomaly at a given true anomaly. */
+static double meanAnomaly(double nu, double e)
+{
+    double ea = 2.0 * atan2(sqrt(1.0 - e) * sin(nu / 2.0), sqrt(1.0 + e) * cos(nu / 2.0));
+    return ea - e * sin(ea);
+}
+
+/*  Appends the time intervals within [t0, t1] at which the mean anomaly of a state is in
+ *  [m_lo, m_hi] (modulo 2 pi).
+ */
+static void passes(const OrbitFilterState & s, double m_lo, double m_hi, double t0, double t1,
+    std::vector<std::pair<double, double> > & out)
+{
+    const double tm = 0.5 * (s.t0 + s.t1);
+    double m0 = s.m_mid + s.m_dot * (t0 - tm);
+    for(double k = ceil((m0 - m_hi) / (2.0 * M_PI)); ; k++) {
+        double lo = tm + (m_lo + 2.0 * M_PI * k - s.m_mid) / s.m_dot;
+        double hi = tm + (m_hi + 2.0 * M_PI * k - s.m_mid) / s.m_dot;
+        if(lo > t1) {
+            break;
+        }
+        out.push_back(std::make_pair(std::max(lo, t0), std::min(hi, t1)));
+    }
+}
+
+/*  Builds the states of all the satellites of the catalog, from the TLE's that they use during the
+ *  propagation span.
+ */
+OrbitFilter::OrbitFilter(const CatalogPropagator & catalog, double d_max)
+    : d_max(d_max), prop_time_start(catalog.getTimeStart())
+{
+    const int n = catalog.getSatelliteCount();
+    const double step = catalog.getTimeStep();
+
+    states.resize(n);
+    shell_min.assign(n, 0.0);
+    shell_max.assign(n, 0.0);
+    partner.assign(n, 0);
+    for(int k = 0; k < n; k++) {
+        for(const PropagationSegment & segment : catalog.getSegments(k)) {
+            if(segment.points > 0) {
+                addStates(k, segment, segment.first_point * step,
+                    (segment.first_point + segment.points - 1) * step);
+            }
+        }
+        shell_min[k] = INFINITY;
+        shell_max[k] = -INFINITY;
+        for(const OrbitFilterState & s : states[k]) {
+            double pad = s.margin + s.r_max * s.rotation;
+            shell_min[k] = std::min(shell_min[k], s.r_min - pad);
+            shell_max[k] = std::max(shell_max[k], s.r_max + pad);
+        }
+    }
+}
+
+/*  Splits the interval [t0, t1] covered by a segment in states, so that each orbit rotates less
+ *  than FILTER_STATE_ROTATION within them (up to FILTER_MAX_STATES per segment).
+ */
+void OrbitFilter::addStates(int k, const PropagationSegment & segment, double t0, double t1)
+{
+    const cOrbit & orbit = *segment.orbit;
+    const cOrbitRecord & rec = orbit.Record();
+    const bool deep = (rec.m_Model == cOrbitRecord::MODEL_SDP4);
+    const double epoch = (orbit.Epoch().Date() - cJulian(prop_time_start).Date()) * SEC_PER_DAY;
+
+    /* Rotation rate (rad/s): */
+    OrbitFilterElements el0 = secularElements(rec, (t0 - epoch) / 60.0);
+    OrbitFilterElements el1 = secularElements(rec, (t1 - epoch) / 60.0);
+    double rotation = fabs(el1.raan - el0.raan) + fabs(el1.argp - el0.argp) + fabs(el1.i - el0.i);
+    int count = std::max(1, std::min(FILTER_MAX_STATES, (int)ceil(rotation / FILTER_STATE_ROTATION)));
+
+    for(int c = 0; c < count; c++) {
+        OrbitFilterState s;
+        s.t0 = t0 + (t1 - t0) * c / count;
+        s.t1 = t0 + (t1 - t0) * (c + 1) / count;
+        s.deep = deep;
+
+        double ts[3] = { (s.t0 - epoch) / 60.0, (0.5 * (s.t0 + s.t1) - epoch) / 60.0, (s.t1 - epoch) / 60.0 };
+        OrbitFilterElements el[3];
+        for(int q = 0; q < 3; q++) {
+            el[q] = secularElements(rec, ts[q]);
+        }
+        const OrbitFilterElements & m = el[1];
+
+        /* Shape (and how much it changes within the interval): */
+        s.r_min = INFINITY;
+        s.r_max = 0.0;
+        double radial = 0.0;
+        for(int q = 0; q < 3; q++) {
+            s.r_min = std::min(s.r_min, el[q].a * (1.0 - el[q].e));
+            s.r_max = std::max(s.r_max, el[q].a * (1.0 + el[q].e));
+            radial = std::max(radial, fabs(el[q].a * (1.0 - el[q].e) - m.a * (1.0 - m.e)));
+            radial = std::max(radial, fabs(el[q].a * (1.0 + el[q].e) - m.a * (1.0 + m.e)));
+        }
+        s.p = m.a * (1.0 - m.e * m.e);
+        s.e = m.e;
+        s.margin = (deep ? FILTER_DEEP_MARGIN : FILTER_MARGIN) + radial;
+
+        /* Orientation (and how much it changes within the interval): */
+        double co = cos(m.raan), so = sin(m.raan), cw = cos(m.argp), sw = sin(m.argp);
+        double ci = cos(m.i), si = sin(m.i);
+        s.P[0] = co * cw - so * sw * ci;    s.P[1] = so * cw + co * sw * ci;    s.P[2] = sw * si;
+        s.Q[0] = -co * sw - so * cw * ci;   s.Q[1] = -so * sw + co * cw * ci;   s.Q[2] = cw * si;
+        s.W[0] = so * si;                   s.W[1] = -co * si;                  s.W[2] = ci;
+        s.rotation = 0.0;
+        for(int q = 0; q < 3; q += 2) {
+            s.rotation = std::max(s.rotation, fabs(el[q].raan - m.raan) + fabs(el[q].argp - m.argp) +
+                fabs(el[q].i - m.i));
+        }
+
+        /*  Mean anomaly, as a linear function of time. Its error includes the curvature of the
+         *  drag term within the interval and an allowance for the terms that are not modelled.
+         */
+        double tmax = std::max(fabs(ts[0]), fabs(ts[2]));
+        s.m_mid = m.m;
+        s.m_dot = (s.t1 > s.t0 ? (el[2].m - el[0].m) / (s.t1 - s.t0) : rec.m_xmdot / 60.0);
+        s.m_error = fabs(0.5 * (el[0].m + el[2].m) - m.m) +
+            0.5 * fabs(rec.m_rmMeanMotionRec * rec.m_t2cof) * tmax * tmax;
+        states[k].push_back(s);
+    }
+}
+
+/*  Tests two states over the interval that they share. Returns the filter that discards the pair
+ *  in that interval, or FILTER_PASS. All the tests are made on the orbits that the states describe,
+ *  with the distance increased by the margins and rotations of both.
+ */
+int OrbitFilter::test(const OrbitFilterState & a, const OrbitFilterState & b) const
+{
+    const double t0 = std::max(a.t0, b.t0);
+    const double t1 = std::min(a.t1, b.t1);
+    const double d = d_max + a.margin + b.margin + a.r_max * a.rotation + b.r_max * b.rotation;
+
+    if(t0 > t1) {
+        return FILTER_TIME;
+    }
+
+    /* Apogee/perigee: the radii that both orbits reach are more than `d` apart. */
+    if(std::max(a.r_min, b.r_min) - std::min(a.r_max, b.r_max) > d) {
+        return FILTER_SHELL;
+    }
+
+    /*  Orbit path: points within `d` of the other orbit are within `d` of its plane, so they are on
+     *  arcs around the line where both planes cross (the relative nodes). Their radii must be
+     *  within `d` of each other at least at one of the nodes.
+     */
+    double K[3] = { a.W[1] * b.W[2] - a.W[2] * b.W[1], a.W[2] * b.W[0] - a.W[0] * b.W[2],
+        a.W[0] * b.W[1] - a.W[1] * b.W[0] };
+    double sin_ir = sqrt(K[0] * K[0] + K[1] * K[1] + K[2] * K[2]);
+    double sin_da = d / (a.r_min * sin_ir);
+    double sin_db = d / (b.r_min * sin_ir);
+    if(!(sin_da < 1.0 && sin_db < 1.0)) {
+        return FILTER_PASS;         /* Nearly coplanar orbits (or too large a distance).          */
+    }
+    double da = asin(sin_da), db = asin(sin_db);
+    if(da + db >= M_PI / 2.0) {
+        return FILTER_PASS;
+    }
+    double cos_da = cos(da), cos_db = cos(db);
+    for(int q = 0; q < 3; q++) {
+        K[q] /= sin_ir;
+    }
+    const double kpa = K[0] * a.P[0] + K[1] * a.P[1] + K[2] * a.P[2];
+    const double kqa = K[0] * a.Q[0] + K[1] * a.Q[1] + K[2] * a.Q[2];
+    const double kpb = K[0] * b.P[0] + K[1] * b.P[1] + K[2] * b.P[2];
+    const double kqb = K[0] * b.Q[0] + K[1] * b.Q[1] + K[2] * b.Q[2];
+
+    int result = FILTER_PATH;
+    std::vector<std::pair<double, double> > pa, pb;
+    for(double sign = 1.0; sign > -2.0; sign -= 2.0) {
+        /* Radii on the arc of each orbit (true anomaly within `da` or `db` of the node): */
+        double ca = sign * kpa, sa = sign * kqa, cb = sign * kpb, sb = sign * kqb;
+        double ca_hi = (ca >= cos_da ? 1.0 : ca * cos_da + fabs(sa) * sin_da);
+        double ca_lo = (ca <= -cos_da ? -1.0 : ca * cos_da - fabs(sa) * sin_da);
+        double cb_hi = (cb >= cos_db ? 1.0 : cb * cos_db + fabs(sb) * sin_db);
+        double cb_lo = (cb <= -cos_db ? -1.0 : cb * cos_db - fabs(sb) * sin_db);
+        double ra_lo = a.p / (1.0 + a.e * ca_hi), ra_hi = a.p / (1.0 + a.e * ca_lo);
+        double rb_lo = b.p / (1.0 + b.e * cb_hi), rb_hi = b.p / (1.0 + b.e * cb_lo);
+        if(ra_lo - rb_hi > d || rb_lo - ra_hi > d) {
+            continue;
+        }
+
+        /*  Time: both satellites have to be on their arcs at the same time. Deep-space orbits are
+         *  not timed (their mean anomaly is not known well enough).
+         */
+        if(a.deep || b.deep) {
+            return FILTER_PASS;
+        }
+        result = FILTER_TIME;
+        double nu_a = atan2(sa, ca), nu_b = atan2(sb, cb);
+        double ma_lo = meanAnomaly(nu_a - da, a.e) - a.m_error;
+        double ma_hi = meanAnomaly(nu_a + da, a.e) + a.m_error;
+        double mb_lo = meanAnomaly(nu_b - db, b.e) - b.m_error;
+        double mb_hi = meanAnomaly(nu_b + db, b.e) + b.m_error;
+        ma_hi += (ma_hi < ma_lo + 2.0 * a.m_error ? 2.0 * M_PI : 0.0);
+        mb_hi += (mb_hi < mb_lo + 2.0 * b.m_error ? 2.0 * M_PI : 0.0);
+        if(ma_hi - ma_lo >= 2.0 * M_PI || mb_hi - mb_lo >= 2.0 * M_PI) {
+            return FILTER_PASS;
+        }
+        pa.clear();
+        pb.clear();
+        passes(a, ma_lo, ma_hi, t0, t1, pa);
+        passes(b, mb_lo, mb_hi, t0, t1, pb);
+        for(std::size_t x = 0, y = 0; x < pa.size() && y < pb.size(); ) {
+            if(pa[x].first <= pb[y].second && pb[y].first <= pa[x].second) {
+                return FILTER_PASS;
+            }
+            (pa[x].second < pb[y].second ? x++ : y++);
+        }
+    }
+    return result;
+}
+
+/*  Tests a pair of satellites over the whole propagation span. Returns FILTER_PASS if they may
+ *  get within `d_max` or, otherwise, the last filter that discarded them (the filters are applied
+ *  in order: shell, path, time).
+ */
+int OrbitFilter::check(int i, int j) const
+{
+    const std::vector<OrbitFilterState> & a = states[i];
+    const std::vector<OrbitFilterState> & b = states[j];
+    int result = -1;
+
+    if(shell_min[j] - shell_max[i] > d_max || shell_min[i] - shell_max[j] > d_max) {
+        return FILTER_SHELL;
+    }
+    for(std::size_t x = 0, y = 0; x < a.size() && y < b.size(); ) {
+        if(a[x].t0 <= b[y].t1 && b[y].t0 <= a[x].t1) {
+            int r = test(a[x], b[y]);
+            if(r == FILTER_PASS) {
+                return FILTER_PASS;
+            }
+            result = std::max(result, r);
+        }
+        (a[x].t1 < b[y].t1 ? x++ : y++);
+    }
+    return (result < 0 ? FILTER_TIME : result);
+}
+
+bool OrbitFilter::mayApproach(int i, int j) const
+{
+    return check(i, j) == FILTER_PASS;
+}
+
+/*  Finds the satellites that may approach at least another one. Satellites are sorted by the
+ *  lowest radius they reach, and each of them is only checked against the ones whose radii overlap
+ *  with its own (nearest first), until a partner is found.
+ */
+void OrbitFilter::findPartners(WorkStealingPool * pool)
+{
+    const int n = states.size();
+    std::vector<int> order;
+    for(int k = 0; k < n; k++) {
+        if(!states[k].empty()) {
+            order.push_back(k);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return shell_min[a] < shell_min[b] || (shell_min[a] == shell_min[b] && a < b);
+    });
+    const int m = order.size();
+    int jobs = (pool != NULL && pool->size() > 1 ? pool->size() * CROSS_SHARDS_PER_THREAD : 1);
+
+    for(int job = 0; job < jobs; job++) {
+        int first = (long)m * job / jobs, last = (long)m * (job + 1) / jobs;
+        PoolJob search = [this, &order, m, first, last] {
+            for(int x = first; x < last; x++) {
+                int i = order[x];
+                /* Candidates below and above (in `order`) are checked alternately: */
+                int lo = x - 1, hi = x + 1;
+                while(!partner[i] && (lo >= 0 || hi < m)) {
+                    if(hi < m && shell_min[order[hi]] - shell_max[i] > d_max) {
+                        hi = m;
+                    }
+                    if(hi < m) {
+                        partner[i] = mayApproach(i, order[hi++]);
+                    }
+                    if(!partner[i] && lo >= 0) {
+                        partner[i] = mayApproach(i, order[lo--]);
+                    }
+                }
+            }
+        };
+        if(jobs > 1) {
+            pool->submit(search);
+        } else {
+            search();
+        }
+    }
+    if(jobs > 1) {
+        pool->wait();
+    }
+}
+
+bool OrbitFilter::hasPartner(int k) const
+{
+    return partner[k];
+}
@@ -0,0 +1,58 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: orbit-geometry pre-filters.
+ *  \details    Discards pairs of satellites that can not get closer than a given distance during
+ *              the propagation span, from their mean elements alone (i.e. before any time sampling):
+ *              apogee/perigee shells that do not overlap, orbital paths that are too far apart at
+ *              the line where their planes cross, and passes through that line that never happen
+ *              at the same time.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       18-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __ORBIT_FILTER__
+#define __ORBIT_FILTER__
+
+/*  Geometry of an orbit during part of the propagation span. Elements are evaluated at the middle
+ *  of the interval with the secular rates of the SGP4/SDP4 model; `rotation` and `margin` bound how
+ *  far the actual orbit can be from the one they describe.
+ */
+struct OrbitFilterState {
+    double t0, t1;              /* Interval (seconds since the propagation start).                */
+    bool deep;                  /* Deep-space orbit (its passes are not timed).                   */
+    double r_min, r_max;        /* Perigee and apogee radii over the interval (km).               */
+    double p, e;                /* Semi-latus rectum (km) and eccentricity.                       */
+    double P[3], Q[3], W[3];    /* Perigee, in-plane normal to P, and orbit normal (unit vectors). */
+    double rotation;            /* Maximum rotation of the orbit within the interval (rad).       */
+    double margin;              /* Position uncertainty not explained by the elements (km).       */
+    double m_mid;               /* Mean anomaly at the middle of the interval (rad).              */
+    double m_dot;               /* Mean anomaly rate (rad/s).                                     */
+    double m_error;             /* Mean anomaly uncertainty (rad).                                */
+};
+
+class OrbitFilter
+{
+    double d_max;               /* Encounter distance (km).                                       */
+    std::time_t prop_time_start;
+    std::vector<std::vector<OrbitFilterState> > states;     /* States of each satellite (sorted). */
+    std::vector<double> shell_min, shell_max;   /* Radii (km) that each satellite may reach.      */
+    std::vector<unsigned char> partner;         /* Whether each satellite may approach another.   */
+
+    void addStates(int k, const PropagationSegment & segment, double t0, double t1);
+    int test(const OrbitFilterState & a, const OrbitFilterState & b) const;
+
+public:
+    enum { FILTER_SHELL, FILTER_PATH, FILTER_TIME, FILTER_PASS };
+
+    OrbitFilter(const CatalogPropagator & catalog, double d_max);
+    int check(int i, int j) const;
+    bool mayApproach(int i, int j) const;
+    void findPartners(WorkStealingPool * pool = NULL);
+    bool hasPartner(int k) const;
+};
+
+#endif /* __ORBIT_FILTER__ */
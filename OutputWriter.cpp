@@ -0,0 +1,252 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: asynchronous output writer.
+ *  \details    Writes the buffers filled by propagation jobs from a dedicated thread. Buffers are
+ *              handed over through a lock-free bounded queue and appended to their files with
+ *              plain `write` calls, so that propagation threads do not wait for the disk unless
+ *              too much data is pending (backpressure).
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       21-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+/*  Creates a writer. In synchronous mode, no thread is started and buffers are written by the
+ *  caller of `write` (i.e. the writer only keeps the files open between buffers).
+ */
+OutputWriter::OutputWriter(bool threaded, std::size_t max_bytes)
+    : slots(new Slot[OUTPUT_QUEUE_SLOTS]), mask(OUTPUT_QUEUE_SLOTS - 1), enqueue_pos(0),
+      dequeue_pos(0), max_bytes(max_bytes), pending_bytes(0), pending_jobs(0), writer_idle(false),
+      producers_waiting(0), stopping(false), max_files(getMaxFiles())
+{
+    for(std::size_t s = 0; s <= mask; s++) {
+        slots[s].sequence.store(s, std::memory_order_relaxed);
+    }
+    if(threaded) {
+        thread = std::thread(&OutputWriter::writerLoop, this);
+    }
+}
+
+/* Writes all the pending buffers and closes the files. */
+OutputWriter::~OutputWriter()
+{
+    if(thread.joinable()) {
+        flush();
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            stopping = true;
+        }
+        job_cv.notify_one();
+        thread.join();
+    }
+    for(auto f = files.begin(); f != files.end(); f++) {
+        close(f->fd);
+    }
+}
+
+/* Queues a job if there is a free slot (any thread). */
+bool OutputWriter::push(OutputJob & job)
+{
+    std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    Slot * slot;
+    for(;;) {
+        slot = &slots[pos & mask];
+        std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+        long diff = (long)seq - (long)pos;
+        if(diff == 0) {
+            if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if(diff < 0) {
+            return false;       /* Full. */
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->job = std::move(job);
+    slot->sequence.store(pos + 1);  /* Sequentially consistent: see `write` and `writerLoop`.    */
+    return true;
+}
+
+/*  Queues a job if there is room for it: a free slot and, unless nothing is pending, no more than
+ *  `max_bytes` pending with it.
+ */
+bool OutputWriter::queue(OutputJob & job, std::size_t bytes)
+{
+    std::size_t pending = pending_bytes;
+    if(pending != 0 && pending + bytes > max_bytes) {
+        return false;
+    }
+    pending_bytes += bytes;
+    if(!push(job)) {
+        pending_bytes -= bytes;
+        return false;
+    }
+    return true;
+}
+
+/* Takes the oldest job of the queue, if any (writer thread only). */
+bool OutputWriter::pop(OutputJob & job)
+{
+    Slot & slot = slots[dequeue_pos & mask];
+    if(slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) {
+        return false;
+    }
+    job = std::move(slot.job);
+    slot.sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+    dequeue_pos++;
+    return true;
+}
+
+bool OutputWriter::empty(void) const
+{
+    return slots[dequeue_pos & mask].sequence.load() != dequeue_pos + 1;
+}
+
+/*  Returns the number of files that the writer can keep open. The limit of open files of the process
+ *  is raised to its maximum, so that time-major propagations (which append to every file once per
+ *  block) can usually keep the files of the whole catalog open.
+ */
+std::size_t OutputWriter::getMaxFiles(void)
+{
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return 1;
+    }
+    if(limit.rlim_cur < limit.rlim_max) {
+        rlim_t current = limit.rlim_cur;
+        limit.rlim_cur = limit.rlim_max;
+        if(setrlimit(RLIMIT_NOFILE, &limit) != 0) {
+            limit.rlim_cur = current;
+        }
+    }
+    if(limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > (rlim_t)INT32_MAX) {
+        limit.rlim_cur = INT32_MAX;
+    }
+    return (limit.rlim_cur > 2 * OUTPUT_RESERVED_FILES ? limit.rlim_cur - OUTPUT_RESERVED_FILES
+        : limit.rlim_cur / 2 + 1);
+}
+
+/*  Appends the data of a job to its file. Files are kept open (up to `max_files`, the least
+ *  recently used one is closed first), so that consecutive buffers of a file do not reopen it.
+ */
+void OutputWriter::run(OutputJob & job)
+{
+    auto found = open_files.find(job.path);
+    if(found != open_files.end()) {
+        files.splice(files.begin(), files, found->second);
+    } else {
+        if(files.size() >= max_files) {
+            close(files.back().fd);
+            open_files.erase(files.back().path);
+            files.pop_back();
+        }
+        OutputFile f;
+        f.path = job.path;
+        if((f.fd = open(job.path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644)) < 0) {
+            cerr << DBG_REDD "Unable to open file " << job.path << DBG_NOCOLOR << endl;
+            exit(-1);
+        }
+        files.push_front(f);
+        open_files[job.path] = files.begin();
+    }
+    OutputFile * file = &files.front();
+
+    const char * p = job.data.data();
+    std::size_t left = job.data.size();
+    while(left > 0) {
+        ssize_t n = ::write(file->fd, p, left);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        } else if(n <= 0) {
+            cerr << DBG_REDD "Unable to write file " << job.path << DBG_NOCOLOR << endl;
+            exit(-1);
+        }
+        p += n;
+        left -= n;
+    }
+}
+
+/*  Writer thread. When the queue is empty, it sleeps until a producer queues a job: `writer_idle`
+ *  is set before the queue is checked for the last time (with the lock held), and producers check
+ *  it after queuing, so either the writer finds the job or the producer wakes it up.
+ */
+void OutputWriter::writerLoop(void)
+{
+    OutputJob job;
+    for(;;) {
+        if(pop(job)) {
+            std::size_t bytes = job.data.size();
+            run(job);
+            std::string().swap(job.data);
+            pending_bytes -= bytes;
+            pending_jobs--;
+            if(producers_waiting > 0) {
+                std::lock_guard<std::mutex> lk(lock);
+                room_cv.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(lock);
+        writer_idle = true;
+        while(empty() && !stopping) {
+            job_cv.wait(lk);
+        }
+        writer_idle = false;
+        if(empty() && stopping) {
+            break;
+        }
+    }
+}
+
+/*  Hands a buffer over to the writer, to be appended to the file at `path` (which is created if it
+ *  does not exist). Buffers of the same file are written in the order in which they are queued.
+ *  When the queue is full, or more than `max_bytes` are pending, the caller waits until the writer
+ *  catches up. In synchronous mode, the buffer is written right away.
+ */
+void OutputWriter::write(const std::string & path, std::string && data)
+{
+    OutputJob job;
+    job.path = path;
+    job.data = std::move(data);
+    if(!thread.joinable()) {
+        run(job);
+        return;
+    }
+
+    std::size_t bytes = job.data.size();
+    pending_jobs++;
+    if(!queue(job, bytes)) {
+        /*  Backpressure: wait for the writer to complete a job. The queue is checked again after
+         *  `producers_waiting` is set, so the writer can not complete all of them unnoticed.
+         */
+        std::unique_lock<std::mutex> lk(lock);
+        producers_waiting++;
+        while(!queue(job, bytes)) {
+            room_cv.wait(lk);
+        }
+        producers_waiting--;
+    }
+    if(writer_idle) {
+        std::lock_guard<std::mutex> lk(lock);
+        job_cv.notify_one();
+    }
+}
+
+/* Waits until all the queued buffers have been written. */
+void OutputWriter::flush(void)
+{
+    if(!thread.joinable()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lk(lock);
+    producers_waiting++;
+    while(pending_jobs > 0) {
+        room_cv.wait(lk);
+    }
+    producers_waiting--;
+}
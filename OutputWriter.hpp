@@ -0,0 +1,74 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: asynchronous output writer.
+ *  \details    Writes the buffers filled by propagation jobs from a dedicated thread. Buffers are
+ *              handed over through a lock-free bounded queue and appended to their files with
+ *              plain `write` calls, so that propagation threads do not wait for the disk unless
+ *              too much data is pending (backpressure).
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       21-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __OUTPUT_WRITER__
+#define __OUTPUT_WRITER__
+
+/* Data to be appended to a file. */
+struct OutputJob {
+    std::string path;
+    std::string data;
+};
+
+/* A file kept open by the writer. */
+struct OutputFile {
+    std::string path;
+    int fd;
+};
+
+class OutputWriter
+{
+    /*  A slot of the queue. Its sequence tells whether it can be filled (`position`) or read
+     *  (`position + 1`) at a given position of the queue (Vyukov's bounded queue).
+     */
+    struct Slot {
+        std::atomic<std::size_t> sequence;
+        OutputJob job;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask;           /* Slots minus one (a power of two).                              */
+    std::atomic<std::size_t> enqueue_pos;   /* Next position to be filled (by any producer).      */
+    std::size_t dequeue_pos;    /* Next position to be read (only by the writer).                 */
+    std::size_t max_bytes;      /* Bytes pending above which producers have to wait.              */
+    std::atomic<std::size_t> pending_bytes;
+    std::atomic<long> pending_jobs;
+    std::atomic<bool> writer_idle;          /* The writer is (about to be) waiting for jobs.      */
+    std::atomic<int> producers_waiting;     /* Producers waiting for room in the queue.           */
+    std::atomic<bool> stopping;
+    std::mutex lock;            /* Only used to sleep and to be woken up.                         */
+    std::condition_variable job_cv;     /* Signaled when a job is queued (if the writer is idle). */
+    std::condition_variable room_cv;    /* Signaled when a job has been written.                  */
+    std::thread thread;         /* Not started in synchronous mode.                               */
+    std::list<OutputFile> files;            /* Open files (the most recently used first).          */
+    std::unordered_map<std::string, std::list<OutputFile>::iterator> open_files;   /* By path.     */
+    std::size_t max_files;      /* Files that can be kept open (see `getMaxFiles`).               */
+
+    bool push(OutputJob & job);
+    bool queue(OutputJob & job, std::size_t bytes);
+    bool pop(OutputJob & job);
+    bool empty(void) const;
+    void run(OutputJob & job);
+    void writerLoop(void);
+    static std::size_t getMaxFiles(void);
+
+public:
+    OutputWriter(bool threaded = true, std::size_t max_bytes = OUTPUT_MAX_BYTES);
+    ~OutputWriter();
+    void write(const std::string & path, std::string && data);
+    void flush(void);
+};
+
+#endif /* __OUTPUT_WRITER__ */
@@ -0,0 +1,364 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: compressed propagation files.
+ *  \details    Encoder and streaming decoder of `.propz` files. Points are quantized to a given
+ *              resolution and each value is predicted from the previous points of its chunk, so
+ *              that only small residuals are stored. Chunks are independent: they are encoded by
+ *              the propagation jobs and decoded one after another, without loading the whole file.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       22-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+/*  Predicts value `c` of the next point of a chunk from the previous ones (`count` of them, the
+ *  most recent first in `history`): quadratic extrapolation, or a lower order for the first points.
+ *  Unsigned arithmetic wraps around just like the encoder and the decoder do.
+ */
+static inline uint64_t predict(const int64_t history[3][PROPZ_COMPONENTS], uint32_t count, int c)
+{
+    uint64_t h0 = history[0][c], h1 = history[1][c], h2 = history[2][c];
+    switch(count) {
+        case 0:  return 0;
+        case 1:  return h0;
+        case 2:  return 2 * h0 - h1;
+        default: return 3 * h0 - 3 * h1 + h2;
+    }
+}
+
+/* Zigzag encoding: small differences (of either sign) get small codes. */
+static inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t u)
+{
+    return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+/* Lowest `bits` bits of `v` (`bits` below 64). */
+static inline uint64_t lowBits(uint64_t v, int bits)
+{
+    return v & (((uint64_t)1 << bits) - 1);
+}
+
+/*  Gets the quantum of each value from the position resolution (in meters): positions are
+ *  quantized to that resolution, velocities to the same number of mm/s, and latitudes and
+ *  longitudes to the angle of that arc at the equator.
+ */
+void PropEncoder::getQuanta(double resolution, double * quantum)
+{
+    double km = resolution / 1000.0;
+    quantum[0] = quantum[1] = km / Zeptomoby::OrbitTools::XKMPER_WGS72 * 180.0 / Zeptomoby::OrbitTools::PI;
+    quantum[2] = quantum[3] = quantum[4] = km;
+    quantum[5] = quantum[6] = quantum[7] = km / 1000.0;
+}
+
+PropEncoder::PropEncoder(double resolution)
+    : time(0), time_step(0), points(0)
+{
+    getQuanta(resolution, quantum);
+    memset(history, 0, sizeof(history));
+    memset(group, 0, sizeof(group));
+}
+
+/* Starts a chunk, whose first point is at time `t`. */
+void PropEncoder::begin(std::time_t t, std::time_t prop_time_step)
+{
+    time = t;
+    time_step = prop_time_step;
+    points = 0;
+    residuals.clear();
+}
+
+/* Adds the next point to the current chunk (longitudes are given in [-180, 180)). */
+void PropEncoder::add(double lat, double lon, double x, double y, double z, double vx, double vy,
+    double vz)
+{
+    double values[PROPZ_COMPONENTS] = { lat, (lon < 180 ? lon : lon - 360), x, y, z, vx, vy, vz };
+    uint32_t g = points % PROPZ_GROUP;
+
+    for(int c = 0; c < PROPZ_COMPONENTS; c++) {
+        int64_t q = std::llround(values[c] / quantum[c]);
+        group[c][g] = zigzag((int64_t)((uint64_t)q - predict(history, points, c)));
+        history[2][c] = history[1][c];
+        history[1][c] = history[0][c];
+        history[0][c] = q;
+    }
+    points++;
+    if(points % PROPZ_GROUP == 0) {
+        packGroup();
+    }
+}
+
+/*  Packs the residuals of the current group (the last PROPZ_GROUP points, or fewer at the end of a
+ *  chunk), with the smallest width that fits all the residuals of each value.
+ */
+void PropEncoder::packGroup(void)
+{
+    uint32_t count = (points % PROPZ_GROUP == 0 ? PROPZ_GROUP : points % PROPZ_GROUP);
+    char bytes[PROPZ_GROUP * 8 + 1];
+
+    for(int c = 0; c < PROPZ_COMPONENTS; c++) {
+        uint64_t all = 0;
+        for(uint32_t k = 0; k < count; k++) {
+            all |= group[c][k];
+        }
+        int width = (all == 0 ? 0 : 64 - __builtin_clzll(all));
+        char * out = bytes;
+        uint64_t acc = 0;       /* Bits not written yet (less than 8 between values).             */
+        int bits = 0;
+        *out++ = (char)width;
+        for(uint32_t k = 0; k < count; k++) {
+            uint64_t v = group[c][k];
+            for(int left = width; left > 0; ) {
+                int take = std::min(left, 56);  /* At most 63 bits in `acc`.                */
+                acc |= lowBits(v, take) << bits;
+                bits += take;
+                left -= take;
+                v >>= take;
+                for(; bits >= 8; bits -= 8, acc >>= 8) {
+                    *out++ = (char)acc;
+                }
+            }
+        }
+        if(bits > 0) {
+            *out++ = (char)acc;
+        }
+        residuals.append(bytes, out - bytes);
+    }
+}
+
+/*  Appends the current chunk (if it has any point) to `buffer`. When built with zstd, residuals are
+ *  compressed again, unless that does not make them any smaller.
+ */
+void PropEncoder::finish(std::string & buffer)
+{
+    PropCompressedChunk h;
+
+    if(points == 0) {
+        return;
+    }
+    if(points % PROPZ_GROUP != 0) {
+        packGroup();
+    }
+    memset(&h, 0, sizeof(h));
+    h.sync = PROPZ_CHUNK_SYNC;
+    h.codec = PROPZ_CODEC_NONE;
+    h.points = points;
+    h.raw_size = residuals.size();
+    h.stored_size = residuals.size();
+    h.time = time;
+    h.time_step = time_step;
+#ifdef ORBPROP_ZSTD
+    std::string packed(ZSTD_compressBound(residuals.size()), '\0');
+    std::size_t n = ZSTD_compress(&packed[0], packed.size(), residuals.data(), residuals.size(),
+        PROPZ_ZSTD_LEVEL);
+    if(!ZSTD_isError(n) && n < residuals.size()) {
+        h.codec = PROPZ_CODEC_ZSTD;
+        h.stored_size = n;
+        buffer.append((const char *)&h, sizeof(h));
+        buffer.append(packed.data(), n);
+        points = 0;
+        return;
+    }
+#endif
+    buffer.append((const char *)&h, sizeof(h));
+    buffer.append(residuals);
+    points = 0;
+}
+
+PropDecoder::PropDecoder()
+    : file(NULL), position(0), point(0)
+{
+    memset(&header, 0, sizeof(header));
+    memset(&chunk, 0, sizeof(chunk));
+    memset(history, 0, sizeof(history));
+    memset(group, 0, sizeof(group));
+}
+
+PropDecoder::~PropDecoder()
+{
+    close();
+}
+
+/* Opens a `.propz` file and reads its header. */
+bool PropDecoder::open(std::string path, std::string * error)
+{
+    close();
+    if((file = fopen(path.c_str(), "r")) == NULL) {
+        *error = "unable to open the file";
+        return false;
+    }
+    if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, PROPZ_MAGIC, sizeof(header.magic)) != 0) {
+        *error = "not a compressed propagation file";
+    } else if(header.version != PROPZ_VERSION || header.header_size != sizeof(PropCompressedHeader) ||
+        header.components != PROPZ_COMPONENTS) {
+        *error = "unsupported file version";
+    } else {
+        return true;
+    }
+    close();
+    return false;
+}
+
+void PropDecoder::close(void)
+{
+    if(file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+    memset(&chunk, 0, sizeof(chunk));
+    std::string().swap(stored);
+    std::string().swap(raw);
+    position = 0;
+    point = 0;
+}
+
+const PropCompressedHeader & PropDecoder::getHeader(void) const
+{
+    return header;
+}
+
+/*  Reads the next chunk and restores its residuals. Returns false at the end of the file (with an
+ *  empty `error`) or if the chunk is not valid.
+ */
+bool PropDecoder::readChunk(std::string * error)
+{
+    error->clear();
+    if(file == NULL) {
+        *error = "no file is open";
+        return false;
+    }
+    std::size_t n = fread(&chunk, 1, sizeof(chunk), file);
+    if(n == 0 && feof(file)) {
+        memset(&chunk, 0, sizeof(chunk));
+        return false;
+    }
+    if(n != sizeof(chunk) || chunk.sync != PROPZ_CHUNK_SYNC || chunk.stored_size > PROPZ_MAX_CHUNK ||
+        chunk.raw_size > PROPZ_MAX_CHUNK) {
+        *error = "corrupted chunk";
+        memset(&chunk, 0, sizeof(chunk));
+        return false;
+    }
+    stored.resize(chunk.stored_size);
+    if(chunk.stored_size > 0 && fread(&stored[0], chunk.stored_size, 1, file) != 1) {
+        *error = "truncated chunk";
+        memset(&chunk, 0, sizeof(chunk));
+        return false;
+    }
+    if(chunk.codec == PROPZ_CODEC_NONE && chunk.stored_size == chunk.raw_size) {
+        raw.swap(stored);
+#ifdef ORBPROP_ZSTD
+    } else if(chunk.codec == PROPZ_CODEC_ZSTD) {
+        raw.resize(chunk.raw_size);
+        n = ZSTD_decompress(&raw[0], raw.size(), stored.data(), stored.size());
+        if(ZSTD_isError(n) || n != chunk.raw_size) {
+            *error = "corrupted chunk";
+            memset(&chunk, 0, sizeof(chunk));
+            return false;
+        }
+#endif
+    } else {
+        *error = (chunk.codec == PROPZ_CODEC_ZSTD ? "chunk compressed with zstd (not supported by this build)" :
+            "unsupported chunk codec");
+        memset(&chunk, 0, sizeof(chunk));
+        return false;
+    }
+    position = 0;
+    point = 0;
+    return true;
+}
+
+/*  Unpacks the residuals of the group that starts at the current point (see PropEncoder::packGroup).
+ *  Returns false if the chunk is not valid.
+ */
+bool PropDecoder::unpackGroup(void)
+{
+    uint32_t count = std::min((uint32_t)PROPZ_GROUP, chunk.points - point);
+    const uint8_t * data = (const uint8_t *)raw.data();
+
+    for(int c = 0; c < PROPZ_COMPONENTS; c++) {
+        if(position >= raw.size() || data[position] > 64) {
+            return false;
+        }
+        int width = data[position++];
+        if(((std::size_t)width * count + 7) / 8 > raw.size() - position) {
+            return false;
+        }
+        uint64_t acc = 0;       /* Bits read but not used yet.                                    */
+        int bits = 0;
+        for(uint32_t k = 0; k < count; k++) {
+            uint64_t v = 0;
+            for(int got = 0; got < width; ) {
+                if(bits == 0) {
+                    acc = data[position++];
+                    bits = 8;
+                }
+                int take = std::min(width - got, bits);
+                v |= lowBits(acc, take) << got;
+                acc >>= take;
+                bits -= take;
+                got += take;
+            }
+            group[c][k] = v;
+        }
+    }
+    return true;
+}
+
+/*  Decodes the next point of the file. Returns false when there are no more points (with an empty
+ *  `error`) or if the file is not valid.
+ */
+bool PropDecoder::next(PropBinaryRecord & record, std::string * error)
+{
+    double * values[PROPZ_COMPONENTS] = { &record.lat, &record.lon, &record.x, &record.y, &record.z,
+        &record.vx, &record.vy, &record.vz };
+
+    while(point >= chunk.points) {
+        if(!readChunk(error)) {
+            return false;
+        }
+    }
+    if(point % PROPZ_GROUP == 0 && !unpackGroup()) {
+        *error = "corrupted chunk";
+        memset(&chunk, 0, sizeof(chunk));
+        return false;
+    }
+    for(int c = 0; c < PROPZ_COMPONENTS; c++) {
+        int64_t q = (int64_t)(predict(history, point, c) + (uint64_t)unzigzag(group[c][point % PROPZ_GROUP]));
+        history[2][c] = history[1][c];
+        history[1][c] = history[0][c];
+        history[0][c] = q;
+        *values[c] = q * header.quantum[c];
+    }
+    record.time = chunk.time + (int64_t)point * chunk.time_step;
+    point++;
+    return true;
+}
+
+/* Writes the header of a `.propz` file. `resolution` is given in meters (see PropEncoder). */
+void writePropCompressedHeader(std::FILE * output_file, int sat_id, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, double resolution)
+{
+    PropCompressedHeader h;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PROPZ_MAGIC, sizeof(h.magic));
+    h.version = PROPZ_VERSION;
+    h.header_size = sizeof(PropCompressedHeader);
+    h.norad_id = sat_id;
+    h.components = PROPZ_COMPONENTS;
+    h.created = time(NULL);
+    h.time_start = prop_time_start;
+    h.time_end = prop_time_end;
+    h.time_step = prop_time_step;
+    h.points = prop_n_points;
+    PropEncoder::getQuanta(resolution, h.quantum);
+    fwrite(&h, sizeof(h), 1, output_file);
+}
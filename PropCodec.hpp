@@ -0,0 +1,116 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: compressed propagation files.
+ *  \details    Encoder and streaming decoder of `.propz` files. Points are quantized to a given
+ *              resolution and each value is predicted from the previous points of its chunk, so
+ *              that only small residuals are stored. Chunks are independent: they are encoded by
+ *              the propagation jobs and decoded one after another, without loading the whole file.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       22-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __PROP_CODEC__
+#define __PROP_CODEC__
+
+/*  Compressed propagation file layout (native byte order), one file per satellite:
+ *      PropCompressedHeader
+ *      { PropCompressedChunk, stored bytes }   Until the end of the file.
+ *  Each chunk holds consecutive points (`time + k * time_step`); points that could not be
+ *  propagated are not stored, like in `.prop` files. The values of a point (latitude, longitude, x,
+ *  y, z, vx, vy and vz) are quantized with the `quantum` of each one (v = q * quantum) and stored
+ *  as the difference between `q` and its prediction: the quadratic extrapolation of the three
+ *  previous points of the chunk (or fewer, for its first points). Differences are zigzag-encoded
+ *  and bit-packed in groups of PROPZ_GROUP points (the last one may be shorter): for each value, a
+ *  byte with the width `w` (0 to 64) of its differences in the group, followed by them (`w` bits
+ *  each, least significant first, padded to a whole byte). The resulting bytes may be compressed
+ *  again as a whole (see PropChunkCodec).
+ */
+enum PropChunkCodec {
+    PROPZ_CODEC_NONE = 0,       /* Stored bytes are the residuals.                                */
+    PROPZ_CODEC_ZSTD = 1        /* Stored bytes are the residuals compressed with zstd.           */
+};
+
+struct PropCompressedHeader {
+    char magic[8];              /* PROPZ_MAGIC.                                                   */
+    uint32_t version;           /* PROPZ_VERSION.                                                 */
+    uint32_t header_size;       /* sizeof(PropCompressedHeader).                                  */
+    int32_t norad_id;
+    uint32_t components;        /* PROPZ_COMPONENTS.                                              */
+    int64_t created;            /* File generation time (UNIX time).                              */
+    int64_t time_start;         /* Propagation start (UNIX time).                                 */
+    int64_t time_end;           /* Propagation end (UNIX time).                                   */
+    int64_t time_step;          /* Propagation step (in seconds).                                 */
+    int64_t points;             /* Requested points (the `Points` line of `.prop` files).         */
+    double quantum[PROPZ_COMPONENTS];   /* Resolution of each value (degrees, km and km/s).       */
+};
+
+struct PropCompressedChunk {
+    uint32_t sync;              /* PROPZ_CHUNK_SYNC.                                              */
+    uint32_t codec;             /* PropChunkCodec.                                                */
+    uint32_t points;
+    uint32_t raw_size;          /* Bytes of residuals.                                            */
+    uint32_t stored_size;       /* Bytes that follow this header.                                 */
+    uint32_t reserved;
+    int64_t time;               /* Time of the first point (UNIX time).                           */
+    int64_t time_step;          /* Seconds between consecutive points.                            */
+};
+
+/*  Encodes consecutive points into chunks. Not thread-safe: each job has its own encoder, since
+ *  chunks do not depend on each other.
+ */
+class PropEncoder
+{
+    double quantum[PROPZ_COMPONENTS];
+    int64_t history[3][PROPZ_COMPONENTS];   /* Last quantized points (the most recent first).     */
+    uint64_t group[PROPZ_COMPONENTS][PROPZ_GROUP];  /* Zigzag residuals of the current group.     */
+    std::string residuals;      /* Packed residuals of the current chunk.                         */
+    int64_t time;               /* First point of the current chunk.                              */
+    int64_t time_step;
+    uint32_t points;            /* Points in the current chunk.                                   */
+
+    void packGroup(void);
+
+public:
+    PropEncoder(double resolution);
+    void begin(std::time_t t, std::time_t prop_time_step);
+    void add(double lat, double lon, double x, double y, double z, double vx, double vy, double vz);
+    void finish(std::string & buffer);
+
+    static void getQuanta(double resolution, double * quantum);
+};
+
+/*  Reads the points of a `.propz` file one after another. Only the current chunk is kept in memory,
+ *  so files of any size can be decoded (e.g. piped to other tools, see `orbprop-decode`).
+ */
+class PropDecoder
+{
+    std::FILE * file;           /* Open file (NULL if none).                                      */
+    PropCompressedHeader header;
+    PropCompressedChunk chunk;  /* Current chunk.                                                 */
+    std::string stored;         /* Stored bytes of the current chunk.                             */
+    std::string raw;            /* Residuals of the current chunk.                                */
+    std::size_t position;       /* Next residual byte.                                            */
+    uint32_t point;             /* Points of the current chunk already decoded.                   */
+    int64_t history[3][PROPZ_COMPONENTS];
+    uint64_t group[PROPZ_COMPONENTS][PROPZ_GROUP];  /* Zigzag residuals of the current group.     */
+
+    bool readChunk(std::string * error);
+    bool unpackGroup(void);
+
+public:
+    PropDecoder();
+    ~PropDecoder();
+    bool open(std::string path, std::string * error);
+    void close(void);
+    const PropCompressedHeader & getHeader(void) const;
+    bool next(PropBinaryRecord & record, std::string * error);
+};
+
+void writePropCompressedHeader(std::FILE * output_file, int sat_id, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, double resolution);
+
+#endif /* __PROP_CODEC__ */
@@ -0,0 +1,321 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: propagation files.
+ *  \details    Formats in which propagated points are written: the original CSV `.prop` files,
+ *              fixed-width binary `.propb` files, which can be memory-mapped and indexed by point,
+ *              and catalog containers (`.propc`), which hold all the satellites of a time-major
+ *              propagation on a shared time axis. Compressed `.propz` files are in PropCodec.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       20-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+/* Writes the decimal digits of `v` at `out` and returns the end of the digits. */
+static inline char * formatUnsigned(char * out, uint64_t v)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while(v != 0);
+    while(n > 0) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+/* Writes `v` (below 100) with two digits at `out`. */
+static inline void formatTwoDigits(char * out, long v)
+{
+    out[0] = '0' + v / 10;
+    out[1] = '0' + v % 10;
+}
+
+/*  Writes `v` with 6 decimals at `out`, exactly like `printf("%.6f")` does, and returns the end of
+ *  the number. The fraction is scaled by 10^6 with its rounding error (which `fma` gives exactly),
+ *  so that it is rounded from the exact binary value (to the nearest, ties to even). Only finite
+ *  values below PROP_FAST_FORMAT_MAX are accepted.
+ */
+static inline char * formatFixed6(char * out, double v)
+{
+    if(std::signbit(v)) {
+        *out++ = '-';
+        v = -v;
+    }
+    double integer = std::trunc(v);
+    double fraction = v - integer;              /* Exact.                                         */
+    double scaled = fraction * 1e6;
+    double error = std::fma(fraction, 1e6, -scaled);    /* fraction * 10^6 = scaled + error.      */
+    double rounded = std::nearbyint(scaled);    /* Ties to even (default rounding mode).          */
+    double rest = scaled - rounded;             /* Exact (|rest| <= 0.5).                         */
+    if(rest == 0.5 && error > 0) {              /* Scaled tie, but above it.                      */
+        rounded += 1.0;
+    } else if(rest == -0.5 && error < 0) {      /* Scaled tie, but below it.                      */
+        rounded -= 1.0;
+    }
+    uint64_t i = (uint64_t)integer;
+    uint64_t f = (uint64_t)rounded;
+    if(f >= 1000000) {
+        i++;
+        f -= 1000000;
+    }
+    out = formatUnsigned(out, i);
+    *out++ = '.';
+    for(int k = 5; k >= 0; k--) {
+        out[k] = '0' + f % 10;
+        f /= 10;
+    }
+    return out + 6;
+}
+
+PropTimeFormatter::PropTimeFormatter()
+    : valid_start(0), valid_end(0), day_start(0), day_seconds(-1)
+{
+    memset(text, 0, sizeof(text));
+}
+
+/*  Looks up the local date and time of `t` and finds the times with the same date and UTC offset
+ *  from then on: until the next local midnight or, if the offset changes before (there is, at most,
+ *  one change in a day), until that change.
+ */
+void PropTimeFormatter::sync(std::time_t t)
+{
+    struct tm tmp;              /* Time struct.                                                   */
+    struct tm probe;
+
+    localtime_r(&t, &tmp);
+    strftime(text, sizeof(text), "%Y-%m-%d %T", &tmp);
+    day_seconds = tmp.tm_hour * 3600 + tmp.tm_min * 60 + tmp.tm_sec;
+    day_start = t - day_seconds;
+    valid_start = t;
+    valid_end = day_start + 86400;
+
+    std::time_t last = valid_end - 1;
+    localtime_r(&last, &probe);
+    if(probe.tm_gmtoff != tmp.tm_gmtoff) {
+        /* Bisect the change: `lo` has the offset of `t` and `hi` does not. */
+        std::time_t lo = t, hi = last;
+        while(hi - lo > 1) {
+            std::time_t mid = lo + (hi - lo) / 2;
+            localtime_r(&mid, &probe);
+            if(probe.tm_gmtoff == tmp.tm_gmtoff) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        valid_end = hi;
+    }
+}
+
+/*  Returns the local time of `t`, in the format "yyyy-mm-dd hh:mm:ss". The string is owned by the
+ *  formatter and only valid until the next call.
+ */
+const char * PropTimeFormatter::format(std::time_t t)
+{
+    if(t < valid_start || t >= valid_end) {
+        sync(t);
+        return text;
+    }
+    long seconds = t - day_start;
+    if(seconds / 60 != day_seconds / 60) {
+        if(seconds / 3600 != day_seconds / 3600) {
+            formatTwoDigits(text + 11, seconds / 3600);
+        }
+        formatTwoDigits(text + 14, seconds / 60 % 60);
+    }
+    formatTwoDigits(text + 17, seconds % 60);
+    day_seconds = seconds;
+    return text;
+}
+
+/* Returns the path of the propagation file of a satellite. */
+std::string propPath(std::string output_path_root, int sat_id, PropFormat format)
+{
+    return output_path_root + "/" + std::to_string(sat_id) +
+        (format == PROP_FORMAT_BINARY ? ".propb" : (format == PROP_FORMAT_COMPRESSED ? ".propz" : ".prop"));
+}
+
+/* Writes the header lines of a `.prop` file. */
+void writePropHeader(std::FILE * output_file, std::time_t prop_time_start, std::time_t prop_time_end,
+    std::time_t prop_time_step, int prop_n_points)
+{
+    struct tm tmp;              /* Time struct.                                                   */
+    char time_formated[21];     /* Time in the format "yyyy-mm-dd hh:mm:ss"                       */
+
+    time_t current_local_time = time(NULL);
+    localtime_r(&current_local_time, &tmp);
+    strftime(time_formated, 21, "%Y-%m-%d %T", &tmp);
+    fprintf(output_file, "File generation time,%s\n", time_formated);
+    fprintf(output_file, "Time (start),%lu\n", prop_time_start);
+    fprintf(output_file, "Time (end),%lu\n", prop_time_end);
+    fprintf(output_file, "Time (step),%lu\n", prop_time_step);
+    fprintf(output_file, "Points,%d\n", prop_n_points);
+    fprintf(output_file, "Time,Timestamp,Latitude,Longitude,x,y,z,vx,vy,vz\n");
+}
+
+/* Writes the header of a `.propb` file. */
+void writePropBinaryHeader(std::FILE * output_file, int sat_id, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, long records)
+{
+    PropBinaryHeader h;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PROPB_MAGIC, sizeof(h.magic));
+    h.version = PROPB_VERSION;
+    h.header_size = sizeof(PropBinaryHeader);
+    h.record_size = sizeof(PropBinaryRecord);
+    h.norad_id = sat_id;
+    h.created = time(NULL);
+    h.time_start = prop_time_start;
+    h.time_end = prop_time_end;
+    h.time_step = prop_time_step;
+    h.points = prop_n_points;
+    h.records = records;
+    fwrite(&h, sizeof(h), 1, output_file);
+}
+
+/*  Creates (or truncates) a propagation file and writes its header. Points are appended later on,
+ *  usually by an OutputWriter. `records` is only used in binary files, and `resolution` (meters)
+ *  in compressed ones.
+ */
+void createPropFile(std::string path, PropFormat format, int sat_id, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, long records,
+    double resolution)
+{
+    std::FILE * output_file;
+
+    if((output_file = fopen(path.c_str(), "w")) == NULL) {
+        cerr << DBG_REDD "Unable to open file " << path << DBG_NOCOLOR << endl;
+        exit(-1);
+    }
+    if(format == PROP_FORMAT_BINARY) {
+        writePropBinaryHeader(output_file, sat_id, prop_time_start, prop_time_end, prop_time_step,
+            prop_n_points, records);
+    } else if(format == PROP_FORMAT_COMPRESSED) {
+        writePropCompressedHeader(output_file, sat_id, prop_time_start, prop_time_end, prop_time_step,
+            prop_n_points, resolution);
+    } else {
+        writePropHeader(output_file, prop_time_start, prop_time_end, prop_time_step, prop_n_points);
+    }
+    fclose(output_file);
+}
+
+/*  Creates (or truncates) a catalog container and writes everything but its points: the header, the
+ *  satellite directory, the time axis and the padding up to the (page-aligned) points, which are
+ *  appended later on, one step after another.
+ */
+void createPropContainer(std::string path, const std::vector<PropContainerEntry> & directory,
+    std::time_t prop_time_start, std::time_t prop_time_end, std::time_t prop_time_step,
+    int prop_n_points, long steps)
+{
+    std::FILE * output_file;
+    PropContainerHeader h;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PROPC_MAGIC, sizeof(h.magic));
+    h.version = PROPC_VERSION;
+    h.header_size = sizeof(PropContainerHeader);
+    h.entry_size = sizeof(PropContainerEntry);
+    h.point_size = sizeof(PropContainerPoint);
+    h.created = time(NULL);
+    h.time_start = prop_time_start;
+    h.time_end = prop_time_end;
+    h.time_step = prop_time_step;
+    h.points = prop_n_points;
+    h.satellites = directory.size();
+    h.steps = steps;
+    h.directory_offset = sizeof(PropContainerHeader);
+    h.times_offset = h.directory_offset + directory.size() * sizeof(PropContainerEntry);
+    h.data_offset = (h.times_offset + steps * sizeof(int64_t) + PROPC_ALIGNMENT - 1) / PROPC_ALIGNMENT * PROPC_ALIGNMENT;
+
+    std::vector<int64_t> times(steps);
+    for(long i = 0; i < steps; i++) {
+        times[i] = prop_time_start + i * prop_time_step;
+    }
+    std::vector<char> padding(h.data_offset - h.times_offset - steps * sizeof(int64_t), 0);
+
+    if((output_file = fopen(path.c_str(), "w")) == NULL) {
+        cerr << DBG_REDD "Unable to open file " << path << DBG_NOCOLOR << endl;
+        exit(-1);
+    }
+    fwrite(&h, sizeof(h), 1, output_file);
+    fwrite(directory.data(), sizeof(PropContainerEntry), directory.size(), output_file);
+    fwrite(times.data(), sizeof(int64_t), times.size(), output_file);
+    fwrite(padding.data(), 1, padding.size(), output_file);
+    fclose(output_file);
+}
+
+/*  Formats one point of a `.prop` file (longitudes are given in [-180, 180)). Returns the length
+ *  of the line. The output is the same as the one of `snprintf` with "%s,%10ld" and "%.6f" for each
+ *  value, but numbers are formatted without going through `printf`, which takes longer than the
+ *  propagation itself. Lines with values that are not finite or too large for the fast formatter
+ *  (or that would not fit in `size`) are still formatted with `snprintf`.
+ */
+int formatPoint(char * line, std::size_t size, const char * time_formated, std::time_t t,
+    double lat, double lon, double x, double y, double z, double vx, double vy, double vz)
+{
+    double values[8] = { lat, (lon < 180 ? lon : lon - 360), x, y, z, vx, vy, vz };
+    std::size_t time_length = strlen(time_formated);
+    bool fast = (time_length + PROP_FAST_LINE_LENGTH <= size && t >= 0);
+    for(int k = 0; k < 8 && fast; k++) {
+        fast = (std::fabs(values[k]) < PROP_FAST_FORMAT_MAX);   /* False for NaN's as well.       */
+    }
+    if(!fast) {
+        return snprintf(line, size, "%s,%10ld,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+            time_formated, t, values[0], values[1], x, y, z, vx, vy, vz);
+    }
+
+    char * out = line;
+    memcpy(out, time_formated, time_length);
+    out += time_length;
+    *out++ = ',';
+    char digits[20];
+    char * end = formatUnsigned(digits, t);
+    for(int pad = 10 - (end - digits); pad > 0; pad--) {
+        *out++ = ' ';
+    }
+    memcpy(out, digits, end - digits);
+    out += end - digits;
+    for(int k = 0; k < 8; k++) {
+        *out++ = ',';
+        out = formatFixed6(out, values[k]);
+    }
+    *out++ = '\n';
+    *out = '\0';
+    return out - line;
+}
+
+/* Appends one point to a buffer of `.propb` records (longitudes are given in [-180, 180)). */
+void packPoint(std::string & buffer, std::time_t t, double lat, double lon, double x, double y,
+    double z, double vx, double vy, double vz)
+{
+    PropBinaryRecord r;
+
+    r.time = t;
+    r.lat = lat;
+    r.lon = (lon < 180 ? lon : lon - 360);
+    r.x = x;
+    r.y = y;
+    r.z = z;
+    r.vx = vx;
+    r.vy = vy;
+    r.vz = vz;
+    buffer.append((const char *)&r, sizeof(r));
+}
+
+/*  Appends `count` records of points that could not be propagated (NaN values), the first of them
+ *  at time `t`.
+ */
+void packMissingPoints(std::string & buffer, std::time_t t, std::time_t prop_time_step, long count)
+{
+    for(long k = 0; k < count; k++, t += prop_time_step) {
+        packPoint(buffer, t, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN);
+    }
+}
@@ -0,0 +1,138 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: propagation files.
+ *  \details    Formats in which propagated points are written: the original CSV `.prop` files,
+ *              fixed-width binary `.propb` files, which can be memory-mapped and indexed by point,
+ *              and catalog containers (`.propc`), which hold all the satellites of a time-major
+ *              propagation on a shared time axis. Compressed `.propz` files are in PropCodec.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       20-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __PROPAGATION_FILE__
+#define __PROPAGATION_FILE__
+
+enum PropFormat {
+    PROP_FORMAT_CSV,            /* `.prop` files (CSV).                                           */
+    PROP_FORMAT_BINARY,         /* `.propb` files (PropBinaryHeader and PropBinaryRecord's).      */
+    PROP_FORMAT_CONTAINER,      /* One `.propc` file for the whole catalog (time-major only).     */
+    PROP_FORMAT_COMPRESSED      /* `.propz` files (see PropCodec.hpp).                            */
+};
+
+/*  Binary propagation file layout (native byte order), one file per satellite:
+ *      PropBinaryHeader
+ *      PropBinaryRecord[records]           One per time step: record `i` is at `time_start +
+ *                                          i * time_step`, at offset `header_size + i *
+ *                                          record_size`.
+ *  Points that could not be propagated are written with NaN values (and their time), so that the
+ *  records of all the satellites of a propagation are aligned. Files of satellites whose orbit is
+ *  unknown at the propagation start have no records, unless they are propagated in time-major mode.
+ */
+struct PropBinaryHeader {
+    char magic[8];              /* PROPB_MAGIC.                                                   */
+    uint32_t version;           /* PROPB_VERSION.                                                 */
+    uint32_t header_size;       /* sizeof(PropBinaryHeader).                                      */
+    uint32_t record_size;       /* sizeof(PropBinaryRecord).                                      */
+    int32_t norad_id;
+    int64_t created;            /* File generation time (UNIX time).                              */
+    int64_t time_start;         /* Propagation start (UNIX time).                                 */
+    int64_t time_end;           /* Propagation end (UNIX time).                                   */
+    int64_t time_step;          /* Propagation step (in seconds).                                 */
+    int64_t points;             /* Requested points (the `Points` line of `.prop` files).         */
+    int64_t records;            /* Records in the file.                                           */
+};
+
+struct PropBinaryRecord {
+    int64_t time;               /* UNIX time.                                                     */
+    double lat, lon;            /* Geodetic coordinates (degrees, longitude in [-180, 180)).      */
+    double x, y, z;             /* ECI position (km).                                             */
+    double vx, vy, vz;          /* ECI velocity (km/s).                                           */
+};
+
+/*  Catalog container layout (native byte order), one file for all the satellites of a time-major
+ *  propagation:
+ *      PropContainerHeader
+ *      PropContainerEntry[satellites]      Satellite directory (at `directory_offset`), sorted by
+ *                                          NORAD ID.
+ *      int64_t[steps]                      Time axis (at `times_offset`): UNIX time of each step.
+ *      PropContainerPoint[steps][satellites]   Points (at `data_offset`, which is page-aligned): the
+ *                                          one of satellite `k` at step `i` is at `data_offset +
+ *                                          (i * satellites + k) * point_size`.
+ *  Every satellite has a point at every step, so the whole file can be memory-mapped and any
+ *  satellite or time slice addressed directly. Points that could not be propagated are NaN.
+ */
+struct PropContainerHeader {
+    char magic[8];              /* PROPC_MAGIC.                                                   */
+    uint32_t version;           /* PROPC_VERSION.                                                 */
+    uint32_t header_size;       /* sizeof(PropContainerHeader).                                   */
+    uint32_t entry_size;        /* sizeof(PropContainerEntry).                                    */
+    uint32_t point_size;        /* sizeof(PropContainerPoint).                                    */
+    int64_t created;            /* File generation time (UNIX time).                              */
+    int64_t time_start;         /* Propagation start (UNIX time).                                 */
+    int64_t time_end;           /* Propagation end (UNIX time).                                   */
+    int64_t time_step;          /* Propagation step (in seconds).                                 */
+    int64_t points;             /* Requested points (the `Points` line of `.prop` files).         */
+    int64_t satellites;         /* Entries in the directory.                                      */
+    int64_t steps;              /* Time steps (points per satellite).                             */
+    int64_t directory_offset;
+    int64_t times_offset;
+    int64_t data_offset;
+};
+
+struct PropContainerEntry {
+    int32_t norad_id;
+    int32_t tles;               /* TLE's used in the propagation (0 if it was not propagated).    */
+    int64_t first_step;         /* Steps covered by its TLE's: [first_step, first_step + steps).  */
+    int64_t steps;              /* Points out of them (or where the propagation failed) are NaN.  */
+};
+
+struct PropContainerPoint {
+    double lat, lon;            /* Geodetic coordinates (degrees, longitude in [-180, 180)).      */
+    double x, y, z;             /* ECI position (km).                                             */
+    double vx, vy, vz;          /* ECI velocity (km/s).                                           */
+};
+
+/*  Formats the times of consecutive points as local times, exactly like `localtime_r` and
+ *  `strftime` with "%Y-%m-%d %T" do. The date and the UTC offset are only looked up (with
+ *  `localtime_r`) once per local day, or when the offset changes; in between, the time of day is
+ *  derived from the seconds since the local midnight and only its digits are rendered again.
+ *  Times are expected in increasing order (others are looked up as well). Not thread-safe: each
+ *  thread or chunk of points has its own formatter.
+ */
+class PropTimeFormatter
+{
+    std::time_t valid_start;    /* Times in [valid_start, valid_end) have the same date and UTC   */
+    std::time_t valid_end;      /* offset as the current one.                                     */
+    std::time_t day_start;      /* Local midnight of the current date (UNIX time).                */
+    long day_seconds;           /* Seconds since `day_start` of the current text (-1 if none).    */
+    char text[21];              /* Current time, in the format "yyyy-mm-dd hh:mm:ss".             */
+
+    void sync(std::time_t t);
+
+public:
+    PropTimeFormatter();
+    const char * format(std::time_t t);
+};
+
+std::string propPath(std::string output_path_root, int sat_id, PropFormat format);
+void writePropHeader(std::FILE * output_file, std::time_t prop_time_start, std::time_t prop_time_end,
+    std::time_t prop_time_step, int prop_n_points);
+void writePropBinaryHeader(std::FILE * output_file, int sat_id, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, long records);
+void createPropFile(std::string path, PropFormat format, int sat_id, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, long records,
+    double resolution = PROPZ_RESOLUTION);
+void createPropContainer(std::string path, const std::vector<PropContainerEntry> & directory,
+    std::time_t prop_time_start, std::time_t prop_time_end, std::time_t prop_time_step,
+    int prop_n_points, long steps);
+int formatPoint(char * line, std::size_t size, const char * time_formated, std::time_t t,
+    double lat, double lon, double x, double y, double z, double vx, double vy, double vz);
+void packPoint(std::string & buffer, std::time_t t, double lat, double lon, double x, double y,
+    double z, double vx, double vy, double vz);
+void packMissingPoints(std::string & buffer, std::time_t t, std::time_t prop_time_step, long count);
+
+#endif /* __PROPAGATION_FILE__ */
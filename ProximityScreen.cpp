@@ -0,0 +1,136 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: close-approach screening.
+ *  \details    Finds the pairs of satellites of a catalog that may be closer than a given distance
+ *              at a time step, without evaluating all pairs: ECI positions are binned in a uniform
+ *              grid and only satellites in neighbouring cells are compared.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       17-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+/*  Cell coordinates are packed in 21-bit fields of a single key, so that cells can be sorted and
+ *  looked up as integers.
+ */
+static inline uint64_t cellKey(long cx, long cy, long cz)
+{
+    return ((uint64_t)(cx + PROX_CELL_OFFSET) << 42) | ((uint64_t)(cy + PROX_CELL_OFFSET) << 21) |
+        (uint64_t)(cz + PROX_CELL_OFFSET);
+}
+
+static inline long cellCoord(double v, double cell)
+{
+    double c = floor(v / cell);
+    return (long)std::max(std::min(c, (double)(PROX_CELL_OFFSET - 2)), (double)(2 - PROX_CELL_OFFSET));
+}
+
+ProximityScreen::ProximityScreen(double d_max, double time_step)
+    : d_max(d_max), time_step(time_step)
+{ }
+
+/* Distance covered in one time step by the fastest satellite at step `s` of the block (km). */
+double ProximityScreen::getPadding(const CatalogBlock & block, int s) const
+{
+    const int n = block.sat_count;
+    const long o = (long)s * n;
+    double v2_max = 0.0;
+    for(int k = 0; k < n; k++) {
+        if(block.valid[o + k]) {
+            double v2 = block.vx[o + k] * block.vx[o + k] + block.vy[o + k] * block.vy[o + k] +
+                block.vz[o + k] * block.vz[o + k];
+            v2_max = std::max(v2_max, v2);
+        }
+    }
+    return sqrt(v2_max) * time_step;
+}
+
+/*  Appends to `candidates` all the pairs that are within `d_max` plus the padding at step `s` of
+ *  the block. Satellites that have not been propagated at that step are not considered. Each pair
+ *  is compared once: with the satellites of its own cell and of the 13 neighbouring cells that
+ *  come after it (the other 13 compare with it).
+ */
+void ProximityScreen::screen(const CatalogBlock & block, int s, std::vector<ProximityCandidate> & candidates) const
+{
+    const int n = block.sat_count;
+    const long o = (long)s * n;
+    const double reach = d_max + getPadding(block, s);
+    const double reach2 = reach * reach;
+    std::vector<std::pair<uint64_t, int> > keyed;
+
+    /* Satellites sorted by cell: */
+    keyed.reserve(n);
+    for(int k = 0; k < n; k++) {
+        if(block.valid[o + k]) {
+            keyed.push_back(std::make_pair(cellKey(cellCoord(block.x[o + k], reach),
+                cellCoord(block.y[o + k], reach), cellCoord(block.z[o + k], reach)), k));
+        }
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    const int m = keyed.size();
+    std::vector<double> xs(m), ys(m), zs(m), d2(m);
+    std::vector<int> sat(m);
+    std::vector<uint64_t> cell_key;             /* Key of each occupied cell.                     */
+    std::vector<int> cell_begin;                /* First satellite of each cell (plus the end).   */
+    for(int a = 0; a < m; a++) {
+        int k = keyed[a].second;
+        xs[a] = block.x[o + k];
+        ys[a] = block.y[o + k];
+        zs[a] = block.z[o + k];
+        sat[a] = k;
+        if(a == 0 || keyed[a].first != keyed[a - 1].first) {
+            cell_key.push_back(keyed[a].first);
+            cell_begin.push_back(a);
+        }
+    }
+    cell_begin.push_back(m);
+
+    for(std::size_t c = 0; c < cell_key.size(); c++) {
+        long cx = (long)(cell_key[c] >> 42) - PROX_CELL_OFFSET;
+        long cy = (long)((cell_key[c] >> 21) & ((1 << 21) - 1)) - PROX_CELL_OFFSET;
+        long cz = (long)(cell_key[c] & ((1 << 21) - 1)) - PROX_CELL_OFFSET;
+        for(int dx = 0; dx <= 1; dx++) {
+            for(int dy = (dx == 0 ? 0 : -1); dy <= 1; dy++) {
+                for(int dz = (dx == 0 && dy == 0 ? 0 : -1); dz <= 1; dz++) {
+                    /* Neighbouring cell (or this one): */
+                    std::size_t nc = c;
+                    if(dx != 0 || dy != 0 || dz != 0) {
+                        uint64_t key = cellKey(cx + dx, cy + dy, cz + dz);
+                        nc = std::lower_bound(cell_key.begin(), cell_key.end(), key) - cell_key.begin();
+                        if(nc == cell_key.size() || cell_key[nc] != key) {
+                            continue;
+                        }
+                    }
+                    for(int a = cell_begin[c]; a < cell_begin[c + 1]; a++) {
+                        const int b0 = (nc == c ? a + 1 : cell_begin[nc]);
+                        const int b1 = cell_begin[nc + 1];
+                        const double xa = xs[a], ya = ys[a], za = zs[a];
+                        const double * xb = &xs[0], * yb = &ys[0], * zb = &zs[0];
+                        double * dd = &d2[0];
+                        #pragma omp simd
+                        for(int b = b0; b < b1; b++) {
+                            double ex = xb[b] - xa;
+                            double ey = yb[b] - ya;
+                            double ez = zb[b] - za;
+                            dd[b] = ex * ex + ey * ey + ez * ez;
+                        }
+                        for(int b = b0; b < b1; b++) {
+                            if(dd[b] <= reach2) {
+                                ProximityCandidate p;
+                                p.i = std::min(sat[a], sat[b]);
+                                p.j = std::max(sat[a], sat[b]);
+                                p.distance = sqrt(dd[b]);
+                                candidates.push_back(p);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
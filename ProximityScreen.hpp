@@ -0,0 +1,41 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: close-approach screening.
+ *  \details    Finds the pairs of satellites of a catalog that may be closer than a given distance
+ *              at a time step, without evaluating all pairs: ECI positions are binned in a uniform
+ *              grid and only satellites in neighbouring cells are compared.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       17-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __PROXIMITY_SCREEN__
+#define __PROXIMITY_SCREEN__
+
+/* A pair of satellites (positions in the catalog, i < j) and their distance at a time step. */
+struct ProximityCandidate {
+    int i;
+    int j;
+    double distance;            /* Distance (km) at the time step.                                */
+};
+
+/*  Grid cells are as large as the screening distance plus a padding, so that pairs within that
+ *  distance are always in the same or in adjacent cells. The padding is the distance that the
+ *  fastest satellite of the step covers in one time step: two satellites that get closer than
+ *  `d_max` between two steps are within `d_max` plus that padding at one of them.
+ */
+class ProximityScreen
+{
+    double d_max;               /* Screening distance (km).                                       */
+    double time_step;           /* Time between steps (seconds).                                  */
+
+public:
+    ProximityScreen(double d_max, double time_step);
+    double getPadding(const CatalogBlock & block, int s) const;
+    void screen(const CatalogBlock & block, int s, std::vector<ProximityCandidate> & candidates) const;
+};
+
+#endif /* __PROXIMITY_SCREEN__ */
@@ -0,0 +1,229 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: TLE archive.
+ *  \details    Binary archive of decoded TLE's, sorted by NORAD ID and epoch and with an index of
+ *              satellites. Archives are memory-mapped when read, and only the TLE's needed for a
+ *              set of satellites and a propagation span are loaded.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       10-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+using Zeptomoby::OrbitTools::cTle;
+
+TLEArchive::TLEArchive()
+    : fd(-1), data(NULL), size(0), header(NULL), records(NULL), index(NULL)
+{
+}
+
+TLEArchive::~TLEArchive()
+{
+    close();
+}
+
+/*  Maps an archive in memory and checks its header, block boundaries and index (every satellite
+ *  has to be within the record block, and satellites sorted by NORAD ID). Returns false (with the
+ *  reason in `error`) if the file can not be used.
+ */
+bool TLEArchive::open(std::string archive_path, std::string * error)
+{
+    struct stat file_stat;
+
+    close();
+    if((fd = ::open(archive_path.c_str(), O_RDONLY)) == -1 || fstat(fd, &file_stat) == -1) {
+        *error = "unable to open the file";
+        close();
+        return false;
+    }
+    size = file_stat.st_size;
+    if(size < sizeof(TLEArchiveHeader)) {
+        *error = "not a TLE archive";
+        close();
+        return false;
+    }
+    void * map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED) {
+        *error = "unable to map the file";
+        close();
+        return false;
+    }
+    data = (const char *)map;
+    header = (const TLEArchiveHeader *)data;
+
+    if(memcmp(header->magic, TLE_ARCHIVE_MAGIC, sizeof(header->magic)) != 0) {
+        *error = "not a TLE archive";
+    } else if(header->version != TLE_ARCHIVE_VERSION || header->record_size != sizeof(TLEArchiveRecord)) {
+        *error = "unsupported archive version (it should be built again)";
+    } else if(header->record_offset > size ||
+        header->record_count > (size - header->record_offset) / sizeof(TLEArchiveRecord) ||
+        header->index_offset > size ||
+        header->index_count > (size - header->index_offset) / sizeof(TLEArchiveIndex)) {
+        *error = "truncated archive";
+    } else {
+        records = (const TLEArchiveRecord *)(data + header->record_offset);
+        index = (const TLEArchiveIndex *)(data + header->index_offset);
+        bool valid = true;
+        for(uint64_t i = 0; i < header->index_count && valid; i++) {
+            valid = (index[i].first <= header->record_count &&
+                index[i].count <= header->record_count - index[i].first &&
+                (i == 0 || index[i].norad_id > index[i - 1].norad_id));
+        }
+        if(!valid) {
+            *error = "corrupted archive index";
+        } else {
+            path = archive_path;
+            return true;
+        }
+    }
+    close();
+    return false;
+}
+
+void TLEArchive::close(void)
+{
+    if(data != NULL) {
+        munmap((void *)data, size);
+    }
+    if(fd != -1) {
+        ::close(fd);
+    }
+    fd = -1;
+    data = NULL;
+    size = 0;
+    header = NULL;
+    records = NULL;
+    index = NULL;
+}
+
+/*  Adds to each historic set in `tle_data` the TLE's of its satellite that are needed to propagate
+ *  between the given times: those with an epoch in the span plus the last one before it and the
+ *  first one after it (the TLE's valid at both ends). Satellites and TLE's are found with binary
+ *  searches, so that only the required records are read. Returns the number of TLE's loaded.
+ */
+int TLEArchive::load(std::unordered_map<int, TLEHistoricSet> & tle_data, std::time_t prop_time_start,
+    std::time_t prop_time_end) const
+{
+    const TLEArchiveIndex * index_end = index + header->index_count;
+    int count = 0;
+
+    for(auto t = tle_data.begin(); t != tle_data.end(); t++) {
+        const TLEArchiveIndex * entry = std::lower_bound(index, index_end, t->first,
+            [](const TLEArchiveIndex & i, int id) { return i.norad_id < id; });
+        if(entry == index_end || entry->norad_id != t->first) {
+            continue;
+        }
+        const TLEArchiveRecord * first = records + entry->first;
+        const TLEArchiveRecord * last = first + entry->count;
+
+        /* First TLE with epoch > start (the previous one is valid at the start time): */
+        const TLEArchiveRecord * begin = std::upper_bound(first, last, (int64_t)prop_time_start,
+            [](int64_t epoch, const TLEArchiveRecord & r) { return epoch < r.epoch; });
+        if(begin != first) {
+            begin--;
+        }
+        /* First TLE with epoch >= end (included, as it limits the last segment): */
+        const TLEArchiveRecord * end = std::lower_bound(begin, last, (int64_t)prop_time_end,
+            [](const TLEArchiveRecord & r, int64_t epoch) { return r.epoch < epoch; });
+        if(end != last) {
+            end++;
+        }
+
+        for(const TLEArchiveRecord * r = begin; r != end; r++) {
+            t->second.emplaceTLE(r->name, r->name_length, r->line1, r->line2, r->fields, r->field_mask);
+            count++;
+        }
+    }
+    return count;
+}
+
+int TLEArchive::getRecordCount(void) const
+{
+    return (header != NULL ? header->record_count : 0);
+}
+
+int TLEArchive::getSatelliteCount(void) const
+{
+    return (header != NULL ? header->index_count : 0);
+}
+
+/*  Writes an archive with all the TLE's in `tle_data`. Returns false (with the reason in `error`)
+ *  if the file can not be written.
+ */
+bool TLEArchive::write(std::string archive_path, const std::unordered_map<int, TLEHistoricSet> & tle_data,
+    std::string * error)
+{
+    std::FILE * file;
+    TLEArchiveHeader h;
+    std::vector<int> ids;
+    std::vector<TLEArchiveIndex> entries;
+    bool success = true;
+
+    for(auto t = tle_data.begin(); t != tle_data.end(); t++) {
+        ids.push_back(t->first);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    if((file = fopen(archive_path.c_str(), "wb")) == NULL) {
+        *error = "unable to open the file";
+        return false;
+    }
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TLE_ARCHIVE_MAGIC, sizeof(h.magic));
+    h.version = TLE_ARCHIVE_VERSION;
+    h.record_size = sizeof(TLEArchiveRecord);
+    h.record_offset = sizeof(TLEArchiveHeader);
+    h.created = time(NULL);
+    success = success && (fwrite(&h, sizeof(h), 1, file) == 1);
+
+    /* Records (TLE's in each set are already sorted by epoch): */
+    for(auto id = ids.begin(); id != ids.end() && success; id++) {
+        const std::vector<TLEEntry> & tles = tle_data.find(*id)->second.getTLEs();
+        TLEArchiveIndex entry;
+        entry.norad_id = *id;
+        entry.count = tles.size();
+        entry.first = h.record_count;
+        entries.push_back(entry);
+
+        for(auto tle = tles.begin(); tle != tles.end() && success; tle++) {
+            TLEArchiveRecord r;
+            memset(&r, 0, sizeof(r));
+            r.epoch = tle->epoch;
+            r.norad_id = *id;
+            r.field_mask = 0;
+            for(int f = cTle::FLD_FIRST; f < cTle::FLD_LAST; f++) {
+                if(f != cTle::FLD_INTLDESC) {   /* Not numeric: always taken from the lines. */
+                    r.fields[f] = tle->tle.GetField((cTle::eField)f);
+                    r.field_mask |= 1u << f;
+                }
+            }
+            std::string name = tle->tle.Name();
+            r.name_length = std::min(name.size(), sizeof(r.name));
+            memcpy(r.name, name.data(), r.name_length);
+            memcpy(r.line1, tle->tle.Line1().data(), std::min(tle->tle.Line1().size(), sizeof(r.line1)));
+            memcpy(r.line2, tle->tle.Line2().data(), std::min(tle->tle.Line2().size(), sizeof(r.line2)));
+            success = (fwrite(&r, sizeof(r), 1, file) == 1);
+            h.record_count++;
+        }
+    }
+
+    /* Index: */
+    h.index_count = entries.size();
+    h.index_offset = h.record_offset + h.record_count * sizeof(TLEArchiveRecord);
+    if(success && !entries.empty()) {
+        success = (fwrite(&entries[0], sizeof(TLEArchiveIndex), entries.size(), file) == entries.size());
+    }
+
+    /* Final header: */
+    success = success && (fseek(file, 0, SEEK_SET) == 0) && (fwrite(&h, sizeof(h), 1, file) == 1);
+    success = (fclose(file) == 0) && success;
+    if(!success) {
+        *error = "unable to write the file";
+    }
+    return success;
+}
@@ -0,0 +1,78 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: TLE archive.
+ *  \details    Binary archive of decoded TLE's, sorted by NORAD ID and epoch and with an index of
+ *              satellites. Archives are memory-mapped when read, and only the TLE's needed for a
+ *              set of satellites and a propagation span are loaded.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       10-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __TLE_ARCHIVE__
+#define __TLE_ARCHIVE__
+
+/*  File layout (native byte order; all blocks are 8-byte aligned):
+ *      TLEArchiveHeader
+ *      TLEArchiveRecord[record_count]      Sorted by NORAD ID and epoch.
+ *      TLEArchiveIndex[index_count]        One entry per NORAD ID, sorted by ID.
+ */
+struct TLEArchiveHeader {
+    char magic[8];              /* TLE_ARCHIVE_MAGIC.                                             */
+    uint32_t version;           /* TLE_ARCHIVE_VERSION.                                           */
+    uint32_t record_size;       /* sizeof(TLEArchiveRecord).                                      */
+    uint64_t record_count;
+    uint64_t record_offset;     /* Offset (in bytes) of the first record.                         */
+    uint64_t index_count;
+    uint64_t index_offset;      /* Offset (in bytes) of the index block.                          */
+    int64_t created;            /* UNIX time at which the archive was built.                      */
+};
+
+/*  A decoded element set. Field values are in native TLE units (see TLERecord) and the data lines
+ *  are kept, so that `cTle` objects can be rebuilt without parsing any number.
+ */
+struct TLEArchiveRecord {
+    int64_t epoch;              /* TLE epoch, as given by `cTle::getTLEtime`.                     */
+    int32_t norad_id;
+    uint32_t field_mask;
+    double fields[Zeptomoby::OrbitTools::cTle::FLD_LAST];
+    int32_t name_length;
+    char name[TLE_NAME_LENGTH];
+    char line1[TLE_LINE_LENGTH];
+    char line2[TLE_LINE_LENGTH];
+};
+
+struct TLEArchiveIndex {
+    int32_t norad_id;
+    uint32_t count;             /* Number of TLE's of this satellite.                             */
+    uint64_t first;             /* Position of the first one in the record block.                 */
+};
+
+class TLEArchive
+{
+    std::string path;
+    int fd;
+    const char * data;          /* Mapped file (NULL if no archive is open).                      */
+    std::size_t size;
+    const TLEArchiveHeader * header;
+    const TLEArchiveRecord * records;
+    const TLEArchiveIndex * index;
+
+public:
+    TLEArchive();
+    ~TLEArchive();
+    bool open(std::string path, std::string * error);
+    void close(void);
+    int load(std::unordered_map<int, TLEHistoricSet> & tle_data, std::time_t prop_time_start,
+        std::time_t prop_time_end) const;
+    int getRecordCount(void) const;
+    int getSatelliteCount(void) const;
+
+    static bool write(std::string path, const std::unordered_map<int, TLEHistoricSet> & tle_data,
+        std::string * error);
+};
+
+#endif /* __TLE_ARCHIVE__ */
@@ -28,10 +28,34 @@ TLEHistoricSet::TLEHistoricSet(int id, string name, cTle tle_init)
     addTLE(tle_init);
 }
 
-bool TLEHistoricSet::addTLE(Zeptomoby::OrbitTools::cTle tle)
+bool TLEHistoricSet::addTLE(const Zeptomoby::OrbitTools::cTle & tle)
 {
-    std::pair<std::set<Zeptomoby::OrbitTools::cTle>::iterator, bool> ret = data.insert(tle);
-    return ret.second;
+    return emplaceTLE(tle);
+}
+
+/*  Moves the TLE that has just been appended to its position. TLE's are usually added in
+ *  chronological order, so this is normally a single comparison. Returns false (and the TLE is
+ *  removed) if another one has the same epoch.
+ */
+bool TLEHistoricSet::placeLast(void)
+{
+    auto last = data.end() - 1;
+    if(last == data.begin() || (last - 1)->epoch < last->epoch) {
+        return true;
+    }
+    auto pos = std::lower_bound(data.begin(), last, last->epoch,
+        [](const TLEEntry & e, std::time_t epoch) { return e.epoch < epoch; });
+    if(pos != last && pos->epoch == last->epoch) {
+        data.pop_back();
+        return false;
+    }
+    std::rotate(pos, last, data.end());
+    return true;
+}
+
+int TLEHistoricSet::getId(void)
+{
+    return sat_id;
 }
 
 int TLEHistoricSet::getSize(void)
@@ -39,193 +63,423 @@ int TLEHistoricSet::getSize(void)
     return data.size();
 }
 
+const std::vector<TLEEntry> & TLEHistoricSet::getTLEs(void) const
+{
+    return data;
+}
+
+/*  Returns the orbit model of a TLE, which is initialized on first use. Orbits of the same set
+ *  should not be requested from several threads at once (once initialized, they can be shared).
+ */
+const Zeptomoby::OrbitTools::cOrbit & TLEHistoricSet::getOrbit(int index) const
+{
+    const TLEEntry & entry = data[index];
+    if(!entry.orbit) {
+        entry.orbit = std::make_shared<const Zeptomoby::OrbitTools::cOrbit>(entry.tle);
+    }
+    return *entry.orbit;
+}
+
+/*  Returns the position of the TLE that is valid at time `t` (i.e. the last one with an epoch not
+ *  later than `t`), or -1 if `t` is before the first epoch.
+ */
+int TLEHistoricSet::findValid(std::time_t t) const
+{
+    auto next = std::upper_bound(data.begin(), data.end(), t,
+        [](std::time_t time, const TLEEntry & e) { return time < e.epoch; });
+    return (next - data.begin()) - 1;
+}
+
+/*  Finds the TLE's that are valid at some point between `t_start` and `t_end`: from the one valid
+ *  at `t_start` to the last one with an epoch before `t_end`. Their positions are [`first`,
+ *  `last`). Returns false if the set is empty or `t_start` is before the first epoch (in which case
+ *  `first` is 0).
+ */
+bool TLEHistoricSet::findOverlapping(std::time_t t_start, std::time_t t_end, int * first, int * last) const
+{
+    auto end = std::lower_bound(data.begin(), data.end(), t_end,
+        [](const TLEEntry & e, std::time_t time) { return e.epoch < time; });
+    *first = std::max(findValid(t_start), 0);
+    *last = std::max((int)(end - data.begin()), *first);
+    return (!data.empty() && data.front().epoch <= t_start);
+}
+
+/*  Estimates the relative cost of propagating this satellite: the number of points times the
+ *  weight of the orbital model that will be used. Like `cOrbit`, the model is chosen with the
+ *  period test (SDP4 for periods of 225 minutes or more), which is evaluated with the TLE that
+ *  is valid at the start of the propagation.
+ */
+double TLEHistoricSet::estimateCost(std::time_t prop_time_start, std::time_t prop_time_end,
+    std::time_t prop_time_step)
+{
+    if(data.empty() || prop_time_step <= 0 || prop_time_end < prop_time_start) {
+        return 0.0;
+    }
+
+    const Zeptomoby::OrbitTools::cOrbit & orbit = getOrbit(std::max(findValid(prop_time_start), 0));
+    double points = (double)((prop_time_end - prop_time_start) / prop_time_step + 1);
+    double weight = (orbit.Period() >= 225.0 * 60.0 ? PROP_COST_SDP4 : PROP_COST_SGP4);
+
+    return points * weight;
+}
+
 void TLEHistoricSet::displayData(void)
 {
     int count = 0;
     cout << "Displaying data for " << (sat_name == "" ? "(unknown name)" : sat_name) << ": " << sat_id << endl;
     for(auto i = data.begin(); i != data.end(); i++) {
-        cout << (count++) << " (" << sat_id << "): " << i->getTLEtime() << endl;
+        cout << (count++) << " (" << sat_id << "): " << i->epoch << endl;
     }
 }
 
-void TLEHistoricSet::propagate(std::string output_path_root, std::time_t prop_time_start,
-    std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, bool verbose)
+/*  Splits the propagation span in segments: one for each TLE that has to be used. Each segment
+ *  starts where the previous one ended (with the same time step) and ends at the epoch of the next
+ *  TLE or at the propagation end time. Throws a TLEHistoricSetException when the orbit is unknown
+ *  for a part of the propagation span (the message names `output_path`, unless it is empty).
+ */
+std::vector<PropagationSegment> TLEHistoricSet::planSegments(std::string output_path,
+    std::time_t prop_time_start, std::time_t prop_time_end, std::time_t prop_time_step)
 {
-    std::FILE * output_file;    /* Propagation file. Results will be written here in CSV format.  */
-    int prop_step_count = 0;    /* Partial-propagation counter.                                   */
-    time_t prop_time_curr;      /* Propagations's current time.                                   */
-    time_t tle_time;            /* Time extracted from TLE files.                                 */
-    time_t tle_time_next;       /* Time extracted from TLE files (corresponds to next iteration.) */
-    struct tm *tmp;             /* Time struct (debug purposes).                                  */
-    char time_formated[21];     /* Time in the format "yyyy-mm-dd hh:mm:ss"                       */
-    int prop_inner_step_count = 1;  /* Propagation's steps counter.                               */
-    int tt;                         /* Internal time iterator for each propagation step.          */
-    int tt_remain = 0;              /* The remaining (in seconds) of incomplete steps.            */
-
-    /* Create/open file: */
-    std::string output_path = output_path_root + "/" + std::to_string(sat_id) + ".prop";
-    if((output_file = fopen(output_path.c_str(), "w+")) == NULL) {
-        cerr << DBG_REDD "Unable to open file " << output_path << DBG_NOCOLOR << endl;
-        exit(-1);
-    } else {
-        /* Write CSV headers to the output file: */
-        time_t current_local_time = time(NULL);
-        tmp = localtime(&current_local_time);
-        strftime(time_formated, 21, "%Y-%m-%d %T", tmp);
-        fprintf(output_file, "File generation time,%s\n", time_formated);
-        fprintf(output_file, "Time (start),%lu\n", prop_time_start);
-        fprintf(output_file, "Time (end),%lu\n", prop_time_end);
-        fprintf(output_file, "Time (step),%lu\n", prop_time_step);
-        fprintf(output_file, "Points,%d\n", prop_n_points);
-        fprintf(output_file, "Time,Timestamp,Latitude,Longitude,x,y,z,vx,vy,vz\n");
-    }
-
-    bool initial_TLE_found = false;
-    std::set<Zeptomoby::OrbitTools::cTle>::iterator i; // TLE iterator.
-    std::set<Zeptomoby::OrbitTools::cTle>::iterator j; // TLE iterator with offset -1.
-    for(i = data.begin(); i != data.end(); i++) {
-        prop_step_count++;
-        /* Create an Orbit object using the satellite TLE object. */
-        Zeptomoby::OrbitTools::cOrbit orbit(*i);
-        Zeptomoby::OrbitTools::cEciTime satellite = orbit.PositionEci(0.0);
-        tle_time = satellite.Date().ToTime();
-        tle_time_next = 0;
-
-        if(i == data.begin() && prop_time_start < tle_time) {
-            /*  The propagation start time for this set of TLE's is set before the earliest TLE
-             *  time.
-             */
-            printf("  %5d (%s) %-3d [%3.0f%%] " DBG_REDD "error(2)" DBG_NOCOLOR": Earliest TLE time is %ld.\n",
-                sat_id, output_path.c_str(), prop_step_count, 0.0, tle_time);
-            throw TLEHistoricSetException();
+    std::vector<PropagationSegment> segments;
+    int first, last;            /* TLE's used (positions in `data`).                              */
+    time_t tt_remain = 0;       /* The remaining (in seconds) of incomplete steps.                */
+    long point_count = 0;       /* Points in the previous segments.                               */
+
+    if(data.empty()) {
+        return segments;
+    }
+    if(!findOverlapping(prop_time_start, prop_time_end, &first, &last)) {
+        /*  The propagation start time for this set of TLE's is set before the earliest TLE
+         *  time.
+         */
+        std::string file = (output_path.empty() ? "" : "(" + output_path + ") ");
+        printf("  %5d %s%-3d [%3.0f%%] " DBG_REDD "error(2)" DBG_NOCOLOR": Earliest TLE time is %ld.\n",
+            sat_id, file.c_str(), 1, 0.0, data.front().epoch);
+        throw TLEHistoricSetException();
+    }
+
+    for(int i = first; i < last; i++) {
+        time_t tle_time = data[i].epoch;
+        time_t tle_time_next = (i + 1 < (int)data.size() ? data[i + 1].epoch : prop_time_end);
+
+        /* Configure partial-propagation start and end times: ----------------------------------- */
+        PropagationSegment segment;
+        segment.tle = &data[i].tle;
+        getOrbit(i);
+        segment.orbit = data[i].orbit;
+        segment.tle_index = i + 1;
+        segment.tle_time = tle_time;
+        segment.tt_start = (i == first ? prop_time_start - tle_time : tt_remain);
+        segment.tt_end = std::min(tle_time_next, prop_time_end) - tle_time;
+
+        /*  Points are taken at `tt_start + k * prop_time_step` while they do not exceed `tt_end`.
+         *  The remainder of the last step is carried to the next segment.
+         */
+        segment.points = 0;
+        if(segment.tt_start <= segment.tt_end) {
+            segment.points = (segment.tt_end - segment.tt_start) / prop_time_step + 1;
         }
-        if(tle_time >= prop_time_end) {
-            break;
+        segment.first_point = point_count;
+        point_count += segment.points;
+        tt_remain = segment.tt_start + segment.points * prop_time_step - segment.tt_end;
+
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+/*  Propagates the points of a chunk and stores them (in the given format) in the chunk's text
+ *  buffer. If the propagator fails, the chunk ends at the point that could not be computed and the
+ *  error is stored in the chunk. Compressed files get a single `.propz` chunk per propagation chunk
+ *  (quantized to `resolution`, see PropEncoder), so they are encoded by the same job.
+ *  `inner_count` is the number of points printed in verbose mode so far.
+ *  All the chunks of a segment share its orbit, which can be propagated from several threads.
+ *
+ *  Point times are the rounded TLE epoch (`tle_time`) plus the propagated seconds, i.e. the
+ *  propagation grid, and are formatted incrementally (see PropTimeFormatter): neither `cJulian`
+ *  conversions nor `localtime` are needed per point.
+ */
+void TLEHistoricSet::propagateChunk(PropagationChunk & chunk, std::time_t prop_time_step,
+    PropFormat format, double resolution, bool verbose, int * inner_count)
+{
+    time_t prop_time_curr;      /* Propagations's current time.                                   */
+    PropTimeFormatter time_formatter;
+    const char * time_formated = NULL;  /* Time in the format "yyyy-mm-dd hh:mm:ss"               */
+    char line[256];             /* One line of the CSV file.                                      */
+    time_t tt;                  /* Internal time iterator for each propagation step.              */
+    int k;
+
+    const Zeptomoby::OrbitTools::cOrbit & orbit = *chunk.segment->orbit;
+    chunk.text.reserve(chunk.points * (format == PROP_FORMAT_BINARY ? sizeof(PropBinaryRecord) :
+        (format == PROP_FORMAT_COMPRESSED ? 16 : 128)));
+    PropEncoder encoder(resolution);
+    encoder.begin(chunk.segment->tle_time + chunk.tt_first, prop_time_step);
+
+    /* Propagate all the points of the chunk at once: */
+    std::vector<double> tsince(chunk.points);
+    std::vector<double> state(6 * chunk.points);
+    std::vector<int> status(chunk.points);
+    double * px  = &state[0];
+    double * py  = px + chunk.points;
+    double * pz  = py + chunk.points;
+    double * pvx = pz + chunk.points;
+    double * pvy = pvx + chunk.points;
+    double * pvz = pvy + chunk.points;
+
+    for(k = 0, tt = chunk.tt_first; k < chunk.points; k++, tt += prop_time_step) {
+        tsince[k] = tt / 60.0;
+    }
+    orbit.PositionEci(&tsince[0], chunk.points, px, py, pz, pvx, pvy, pvz, &status[0]);
+
+    for(k = 0; k < chunk.points; k++) {
+        if(verbose && !(++(*inner_count) % 50)) {
+            printHeader(false);
         }
 
-        j = std::next(i);
-        if(j != data.end()) {
-            Zeptomoby::OrbitTools::cOrbit orbit_next(*j);
-            Zeptomoby::OrbitTools::cEciTime satellite_next = orbit_next.PositionEci(0.0);
-            tle_time_next = satellite_next.Date().ToTime();
+        if(status[k] == Zeptomoby::OrbitTools::cSgp4Batch::STATUS_DECAYED) {
+            chunk.error = "orbit decayed";
+            break;
+        } else if(status[k] != Zeptomoby::OrbitTools::cSgp4Batch::STATUS_OK) {
+            chunk.error = "Error in satellite data";
+            break;
         }
 
-        /* Loop control: ------------------------------------------------------------------------ */
-        if(!initial_TLE_found && j != data.end()) {
-            /* This (`i`) TLE is not the last one and the initial TLE is still unknown. */
-            if(tle_time_next <= prop_time_start) {
-                /* This TLE can be skipped. */
-                continue;
-            } else {
-                /* This (`i`) is the initial TLE. */
-                initial_TLE_found = true;
-            }
-        } else if(!initial_TLE_found && j == data.end()) {
-            /*  The initial TLE has not been found, and this is the last one. */
-            if(tle_time <= prop_time_start) {
-                /* This (`i`) is the initial TLE (and the only one). */
-                initial_TLE_found = true;
-                tle_time_next = prop_time_end;
-            } else {
-                /*  This (`i`) is the last TLE in the historic set, but the initial one with which
-                 *  the propagation has to start has not been detected yet. This should throw an
-                 *  exception because the orbital parameters are unknown for a part of the given
-                 *  propagation span.
-                 */
-                printf("  %5d (%s) %-3d [%3.0f%%] " DBG_REDD "error(1)" DBG_NOCOLOR".\n", sat_id, output_path.c_str(), prop_step_count, 0.0);
-                throw TLEHistoricSetException();
-            }
-        } /* else --> initial_TLE_found == true: */
+        Zeptomoby::OrbitTools::cJulian date = orbit.Epoch();
+        date.AddMin(tsince[k]);
+        Zeptomoby::OrbitTools::cEciTime satellite(Zeptomoby::OrbitTools::cVector(px[k], py[k], pz[k]),
+            Zeptomoby::OrbitTools::cVector(pvx[k], pvy[k], pvz[k]), date);
+        prop_time_curr = chunk.segment->tle_time + chunk.tt_first + k * prop_time_step;
+        Zeptomoby::OrbitTools::cGeo proj_earth(satellite, date);
 
-        /* Configure partial-propagation start and end times: ----------------------------------- */
-        time_t current_prop_time_start;
-        time_t current_prop_time_end;
-        if(prop_time_start >= tle_time && prop_time_start < tle_time_next) {
-            current_prop_time_start = (prop_time_start - tle_time);
-        } else {
-            current_prop_time_start = 0 + tt_remain;
+        if(format == PROP_FORMAT_BINARY) {
+            packPoint(chunk.text, prop_time_curr, proj_earth.LatitudeDeg(), proj_earth.LongitudeDeg(),
+                px[k], py[k], pz[k], pvx[k], pvy[k], pvz[k]);
+        } else if(format == PROP_FORMAT_COMPRESSED) {
+            encoder.add(proj_earth.LatitudeDeg(), proj_earth.LongitudeDeg(), px[k], py[k], pz[k],
+                pvx[k], pvy[k], pvz[k]);
+        }
+        if(format == PROP_FORMAT_CSV || verbose) {
+            time_formated = time_formatter.format(prop_time_curr);
+        }
+        if(format == PROP_FORMAT_CSV) {
+            int len = formatPoint(line, sizeof(line), time_formated, prop_time_curr,
+                proj_earth.LatitudeDeg(), proj_earth.LongitudeDeg(),
+                px[k], py[k], pz[k], pvx[k], pvy[k], pvz[k]);
+            chunk.text.append(line, len);
         }
 
-        if(j == data.end() || tle_time_next >= prop_time_end) {
-            /* This is the last TLE: */
-            current_prop_time_end = (prop_time_end - tle_time);
-        } else {
-            current_prop_time_end = (tle_time_next - tle_time);
+        if(verbose) {
+            printf("│% 10ld (%s) │ % 11.6f % 11.6f │ % 13.6f % 13.6f % 13.6f │ % 10.6f % 10.6f % 10.6f │\n",
+                prop_time_curr, time_formated,
+                proj_earth.LatitudeDeg(),
+                (proj_earth.LongitudeDeg() < 180 ? proj_earth.LongitudeDeg() : proj_earth.LongitudeDeg()-360),
+                px[k], py[k], pz[k], pvx[k], pvy[k], pvz[k]);
         }
+    }
+    chunk.points_done = k;
+    if(format == PROP_FORMAT_COMPRESSED) {
+        encoder.finish(chunk.text);
+    }
+}
 
-        /* Perform partial-propagation: --------------------------------------------------------- */
-        Zeptomoby::OrbitTools::cGeo proj_earth = Zeptomoby::OrbitTools::cGeo(satellite, satellite.Date());
+/*  Propagates a chunk of a parallel propagation, unless another thread has already started it.
+ *  Returns false in that case.
+ */
+bool TLEHistoricSet::claimChunk(PropagationChunkSet & set, PropagationChunk & chunk,
+    std::time_t prop_time_step, PropFormat format, double resolution)
+{
+    bool claimed = false;
+    if(!chunk.claimed.compare_exchange_strong(claimed, true)) {
+        return false;
+    }
+    propagateChunk(chunk, prop_time_step, format, resolution, false, NULL);
+    {
+        std::lock_guard<std::mutex> lk(set.lock);
+        chunk.done = true;
+    }
+    set.done_cv.notify_all();
+    return true;
+}
 
-        /* Iterate through time as defined in the input arguments: */
-        if(verbose) {
-            printHeader(true);
-        } else {
-            printf("  %5d (%s) %-3d [%3.0f%%] %d pp.\r", sat_id, output_path.c_str(), prop_step_count,
-                (100.0 * (tle_time - prop_time_start) / (prop_time_end - prop_time_start)),
-                prop_inner_step_count);
-            fflush(stdout);
+/*  Propagates the orbit between the given times and writes the results in a CSV file (or in a
+ *  binary or compressed one, see PropagationFile.hpp and PropCodec.hpp, with positions quantized
+ *  to `resolution` meters in the latter). When `quiet` is set, the progress line is not printed
+ *  (i.e. several propagations are running concurrently) and errors are still reported.
+ *
+ *  The propagation span is cut in chunks of, at most, PROP_CHUNK_POINTS points that never cross a
+ *  TLE boundary. If a `pool` with more than one thread is given, chunks are propagated as jobs of
+ *  that pool and written in order as they are completed. Since every point is computed from its
+ *  own time since epoch, the resulting file is identical to the one obtained serially.
+ *
+ *  Chunks are handed over to `writer` (the file may not be complete when this function returns),
+ *  or written synchronously if no writer is given.
+ */
+void TLEHistoricSet::propagate(std::string output_path_root, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, bool verbose,
+    bool quiet, WorkStealingPool * pool, PropFormat format, OutputWriter * writer, double resolution)
+{
+    int prop_inner_step_count = 1;  /* Propagation's steps counter (verbose mode).                */
+    OutputWriter sync_writer(false);    /* Used if no `writer` is given.                          */
+
+    std::string output_path = propPath(output_path_root, sat_id, format);
+    std::vector<PropagationSegment> segments;
+    try {
+        segments = planSegments(output_path, prop_time_start, prop_time_end, prop_time_step);
+    } catch(...) {
+        createPropFile(output_path, format, sat_id, prop_time_start, prop_time_end, prop_time_step,
+            prop_n_points, 0, resolution);
+        throw;
+    }
+
+    /* Cut segments in chunks: ------------------------------------------------------------------ */
+    std::shared_ptr<PropagationChunkSet> chunk_set = std::make_shared<PropagationChunkSet>();
+    std::deque<PropagationChunk> & chunks = chunk_set->chunks;
+    long total_points = 0;
+    for(auto s = segments.begin(); s != segments.end(); s++) {
+        for(int k = 0; k < s->points; k += PROP_CHUNK_POINTS) {
+            chunks.emplace_back();
+            chunks.back().segment = &(*s);
+            chunks.back().tt_first = s->tt_start + k * prop_time_step;
+            chunks.back().points = std::min(PROP_CHUNK_POINTS, s->points - k);
         }
+        total_points += s->points;
+    }
+
+    /* Create the file (binary files have one record per point, see below): */
+    createPropFile(output_path, format, sat_id, prop_time_start, prop_time_end, prop_time_step,
+        prop_n_points, total_points, resolution);
+    if(writer == NULL) {
+        writer = &sync_writer;
+    }
+
+    /*  In parallel mode, no more than PROP_CHUNK_WINDOW chunks per thread are in flight, which
+     *  bounds the memory used by chunks that are waiting to be written. While waiting for a chunk,
+     *  the caller propagates the chunks of this file that no worker has started yet. It does not
+     *  run other jobs of the pool: those may be whole propagations, which would be nested in this
+     *  one (and hold its chunks) until they finished.
+     */
+    bool parallel = (pool != NULL && pool->size() > 1 && chunks.size() > 1);
+    size_t window = (parallel ? PROP_CHUNK_WINDOW * pool->size() : 0);
+    size_t next_submit = 0;
+    size_t next_claim = 0;      /* First chunk that the caller may still have to propagate.       */
+    long points_written = 0;
+    const PropagationSegment * failed_segment = NULL;
 
-        for(tt = current_prop_time_start; tt <= current_prop_time_end; tt += prop_time_step)
-        {
-            prop_inner_step_count++;
-            if(verbose && !(prop_inner_step_count % 50)) {
-                printHeader(false);
+    for(size_t c = 0; c < chunks.size(); c++) {
+        PropagationChunk & chunk = chunks[c];
+        if(parallel) {
+            for(; next_submit < chunks.size() && next_submit < c + window; next_submit++) {
+                PropagationChunk * pc = &chunks[next_submit];
+                pool->submit([this, chunk_set, pc, prop_time_step, format, resolution] {
+                    claimChunk(*chunk_set, *pc, prop_time_step, format, resolution);
+                });
+            }
+            for(next_claim = std::max(next_claim, c); !chunk.done && next_claim < next_submit; next_claim++) {
+                claimChunk(*chunk_set, chunks[next_claim], prop_time_step, format, resolution);
+            }
+            std::unique_lock<std::mutex> lk(chunk_set->lock);
+            chunk_set->done_cv.wait(lk, [&chunk] { return chunk.done.load(); });
+        } else if(chunk.segment != failed_segment) {
+            if(verbose && chunk.tt_first == chunk.segment->tt_start) {
+                printHeader(true);
+            }
+            propagateChunk(chunk, prop_time_step, format, resolution, verbose, &prop_inner_step_count);
+            if(verbose && (chunk.points_done < chunk.points || c + 1 == chunks.size() || chunks[c + 1].segment != chunk.segment)) {
+                printFooter();
             }
+        }
 
-            try {
-                satellite = orbit.PositionEci(tt / 60.0);
-                prop_time_curr = satellite.Date().ToTime();
-                proj_earth = Zeptomoby::OrbitTools::cGeo(satellite, satellite.Date());
-            } catch(exception& e) {
+        /*  Write the chunk, unless a previous chunk of the same segment failed. Binary files have
+         *  one record per point: the ones that have not been propagated are filled with NaN's.
+         */
+        long chunk_first = chunk.segment->first_point + (chunk.tt_first - chunk.segment->tt_start) / prop_time_step;
+        long chunk_missing = chunk.points;
+        if(chunk.segment != failed_segment) {
+            chunk_missing -= chunk.points_done;
+            points_written += chunk.points_done;
+            if(!chunk.error.empty()) {
                 printf("  %5d (%s) %-3d [%3.0f%%] " DBG_REDD "error(3)" DBG_NOCOLOR": %s.\n",
-                    sat_id, output_path.c_str(), prop_step_count, 0.0, e.what());
-                break;
+                    sat_id, output_path.c_str(), chunk.segment->tle_index,
+                    (100.0 * (chunk_first + chunk.points_done) / total_points),
+                    chunk.error.c_str());
+                failed_segment = chunk.segment;
             }
+        } else {
+            chunk.text.clear();
+        }
+        if(format == PROP_FORMAT_BINARY && chunk_missing > 0) {
+            packMissingPoints(chunk.text, prop_time_start + (chunk_first + chunk.points - chunk_missing) * prop_time_step,
+                prop_time_step, chunk_missing);
+        }
+        writer->write(output_path, std::move(chunk.text));
+        std::string().swap(chunk.text);
 
-            tmp = localtime(&prop_time_curr);
-            strftime(time_formated, 21, "%Y-%m-%d %T", tmp);
-            fprintf(output_file, "%s,%10ld,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
-                time_formated, prop_time_curr,
-                proj_earth.LatitudeDeg(),
-                (proj_earth.LongitudeDeg() < 180 ? proj_earth.LongitudeDeg() : proj_earth.LongitudeDeg()-360),
-                satellite.Position().m_x, satellite.Position().m_y, satellite.Position().m_z,
-                satellite.Velocity().m_x, satellite.Velocity().m_y, satellite.Velocity().m_z);
-
-            if(verbose) {
-                printf("│% 10ld (%s) │ % 11.6f % 11.6f │ % 13.6f % 13.6f % 13.6f │ % 10.6f % 10.6f % 10.6f │\n",
-                    prop_time_curr, time_formated,
-                    proj_earth.LatitudeDeg(),
-                    (proj_earth.LongitudeDeg() < 180 ? proj_earth.LongitudeDeg() : proj_earth.LongitudeDeg()-360),
-                    satellite.Position().m_x, satellite.Position().m_y, satellite.Position().m_z,
-                    satellite.Velocity().m_x, satellite.Velocity().m_y, satellite.Velocity().m_z);
-            } else if(prop_inner_step_count % 512 == 0) {
-                printf("  %d (%s) %-3d [%3.0f%%] %d pp.\r", sat_id, output_path.c_str(), prop_step_count,
-                    (100.0 * (tle_time - prop_time_start + tt) / (prop_time_end - prop_time_start)),
-                    prop_inner_step_count);
-                fflush(stdout);
-            }
+        if(!verbose && !quiet) {
+            printf("  %5d (%s) %-3d [%3.0f%%] %ld pp.\r", sat_id, output_path.c_str(), chunk.segment->tle_index,
+                (100.0 * (chunk_first + chunk.points) / total_points),
+                points_written);
+            fflush(stdout);
         }
-        tt_remain = tt - current_prop_time_end;
+    }
+    if(!verbose && !quiet) {
+        printf("\n");
+    }
+}
 
-        if(verbose) {
-            printFooter();
-        } else {
-            printf("  %5d (%s) %-3d [%3.0f%%] %d pp.\r", sat_id, output_path.c_str(), prop_step_count,
-                (100.0 * ( (tle_time - prop_time_start + tt) <= (prop_time_end - prop_time_start) ?
-                (tle_time - prop_time_start + tt) : (prop_time_end - prop_time_start) ) /
-                (prop_time_end - prop_time_start) ),
-                prop_inner_step_count);
+
+/*  Fits a Chebyshev ephemeris (see ChebyshevEphemeris) to the orbit between the given times and
+ *  writes it in a `.cheb` file. Segments are the same as in `propagate`, but each one is fitted
+ *  from the epoch of its TLE (or from the start time) to the epoch of the next TLE, so that the
+ *  ephemeris covers the whole span regardless of the time step. `tolerance` is given in km.
+ */
+void TLEHistoricSet::fitEphemeris(std::string output_path_root, std::time_t prop_time_start,
+    std::time_t prop_time_end, std::time_t prop_time_step, double tolerance, bool quiet)
+{
+    std::FILE * output_file;    /* Ephemeris file.                                                */
+    std::string error;          /* Error description.                                             */
+
+    std::string output_path = output_path_root + "/" + std::to_string(sat_id) + ".cheb";
+    if((output_file = fopen(output_path.c_str(), "w+")) == NULL) {
+        cerr << DBG_REDD "Unable to open file " << output_path << DBG_NOCOLOR << endl;
+        exit(-1);
+    }
+
+    std::vector<PropagationSegment> segments;
+    try {
+        segments = planSegments(output_path, prop_time_start, prop_time_end, prop_time_step);
+    } catch(...) {
+        fclose(output_file);
+        throw;
+    }
+
+    ChebyshevEphemeris ephemeris(tolerance);
+    for(auto s = segments.begin(); s != segments.end(); s++) {
+        double tt_first = (s == segments.begin() ? s->tt_start : 0);
+        if(!ephemeris.fit(*s->orbit, s->tle_time, tt_first, s->tt_end, &error)) {
+            printf("  %5d (%s) %-3d [%3.0f%%] " DBG_REDD "error(3)" DBG_NOCOLOR": %s.\n",
+                sat_id, output_path.c_str(), s->tle_index,
+                (100.0 * (ephemeris.getEnd() - prop_time_start) / (prop_time_end - prop_time_start)),
+                error.c_str());
+            break;
+        }
+        if(!quiet) {
+            printf("  %5d (%s) %-3d [%3.0f%%] %d gr.\r", sat_id, output_path.c_str(), s->tle_index,
+                (100.0 * (s->tle_time + s->tt_end - prop_time_start) / (prop_time_end - prop_time_start)),
+                ephemeris.getSize());
             fflush(stdout);
         }
     }
-    if(!verbose) {
+    if(!quiet) {
         printf("\n");
     }
+    if(ephemeris.getCoarseGranules() > 0) {
+        printf("  %5d (%s) " DBG_YELLOWD "warning" DBG_NOCOLOR ": %d granules above tolerance (max. error at check points: %.3f m).\n",
+            sat_id, output_path.c_str(), ephemeris.getCoarseGranules(), ephemeris.getMaxPositionError() * 1000.0);
+    }
+    ephemeris.write(output_file, prop_time_start, prop_time_end);
     fclose(output_file);
 }
 
-
 void printHeader(bool first)
 {
     if(first) {
@@ -13,28 +13,96 @@
 #ifndef __TLE_HISTORIC_SET__
 #define __TLE_HISTORIC_SET__
 
-struct TLECompare {
-    bool operator()(Zeptomoby::OrbitTools::cTle const & ta, Zeptomoby::OrbitTools::cTle const & tb) const
-    {
-        return ta.getTLEtime() < tb.getTLEtime();
-    }
+/*  An element set of a historic set. Its epoch is computed once, when it is added, and its orbit
+ *  model is initialized the first time that it is needed and kept for later propagations.
+ */
+struct TLEEntry {
+    Zeptomoby::OrbitTools::cTle tle;
+    std::time_t epoch;          /* TLE epoch (UNIX time), as given by `cTle::getTLEtime`.         */
+    mutable std::shared_ptr<const Zeptomoby::OrbitTools::cOrbit> orbit;    /* NULL until used.    */
+
+    /* Builds the TLE in place with the arguments of any `cTle` constructor. */
+    template<typename... Args>
+    TLEEntry(std::piecewise_construct_t, Args &&... args)
+        : tle(std::forward<Args>(args)...), epoch(tle.getTLEtime()) { }
+};
+
+/*  A part of the propagation span that is covered by a single TLE. Times (`tt_*`) are given in
+ *  seconds since the epoch of the TLE, which is rounded to `tle_time`.
+ */
+struct PropagationSegment {
+    const Zeptomoby::OrbitTools::cTle * tle;
+    std::shared_ptr<const Zeptomoby::OrbitTools::cOrbit> orbit;    /* Shared by the segment chunks. */
+    int tle_index;              /* Position of the TLE in the historic set (starting at 1).       */
+    std::time_t tle_time;       /* TLE epoch (UNIX time).                                         */
+    std::time_t tt_start;       /* First point of the segment.                                    */
+    std::time_t tt_end;         /* Segment end (the last point is at `tt_end` or before).         */
+    int points;                 /* Number of points in this segment.                              */
+    long first_point;           /* Number of points in previous segments.                         */
+};
+
+/*  A group of consecutive points of a segment that can be propagated independently. */
+struct PropagationChunk {
+    const PropagationSegment * segment;
+    std::time_t tt_first;       /* First point, in seconds since the epoch of the segment's TLE.  */
+    int points;                 /* Number of requested points.                                    */
+    int points_done;            /* Number of propagated points (less than `points` on errors).    */
+    std::string text;           /* Propagated points, in the format of the output file.           */
+    std::string error;          /* Error description (empty on success).                          */
+    std::atomic<bool> claimed;  /* Set when a thread starts propagating the chunk.                */
+    std::atomic<bool> done;     /* Set when the chunk has been propagated.                        */
+
+    PropagationChunk()
+        : segment(NULL), tt_first(0), points(0), points_done(0), claimed(false), done(false) { }
 };
 
+/*  Chunks of a propagation. In parallel mode, they are shared with the pool jobs, which may still
+ *  be queued when the propagation returns (if their chunk was propagated by another thread).
+ */
+struct PropagationChunkSet {
+    std::deque<PropagationChunk> chunks;
+    std::mutex lock;
+    std::condition_variable done_cv;    /* Signaled when a chunk is done.                         */
+};
+
+class WorkStealingPool;
+
 class TLEHistoricSet
 {
     int sat_id;
     string sat_name;
-    std::set<Zeptomoby::OrbitTools::cTle, TLECompare> data;
+    std::vector<TLEEntry> data; /* Sorted by epoch (without repeated epochs).                     */
+
+    bool placeLast(void);
+
+    void propagateChunk(PropagationChunk & chunk, std::time_t prop_time_step, PropFormat format,
+        double resolution, bool verbose, int * inner_count);
+    bool claimChunk(PropagationChunkSet & set, PropagationChunk & chunk,
+        std::time_t prop_time_step, PropFormat format, double resolution);
 
 public:
     TLEHistoricSet(int id);
     TLEHistoricSet(int sat_id, string sat_name);
     TLEHistoricSet(int sat_id, string sat_name, Zeptomoby::OrbitTools::cTle tle_init);
-    bool addTLE(Zeptomoby::OrbitTools::cTle tle);
+    bool addTLE(const Zeptomoby::OrbitTools::cTle & tle);
+    template<typename... Args> bool emplaceTLE(Args &&... args);
+    int getId(void);
     int getSize(void);
+    const std::vector<TLEEntry> & getTLEs(void) const;
+    const Zeptomoby::OrbitTools::cOrbit & getOrbit(int index) const;
+    int findValid(std::time_t t) const;
+    bool findOverlapping(std::time_t t_start, std::time_t t_end, int * first, int * last) const;
+    std::vector<PropagationSegment> planSegments(std::string output_path,
+        std::time_t prop_time_start, std::time_t prop_time_end, std::time_t prop_time_step);
     void displayData(void);
+    double estimateCost(std::time_t prop_time_start, std::time_t prop_time_end,
+        std::time_t prop_time_step);
     void propagate(std::string output_path_root, std::time_t prop_time_start,
-        std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, bool verbose);
+        std::time_t prop_time_end, std::time_t prop_time_step, int prop_n_points, bool verbose,
+        bool quiet = false, WorkStealingPool * pool = NULL, PropFormat format = PROP_FORMAT_CSV,
+        OutputWriter * writer = NULL, double resolution = PROPZ_RESOLUTION);
+    void fitEphemeris(std::string output_path_root, std::time_t prop_time_start,
+        std::time_t prop_time_end, std::time_t prop_time_step, double tolerance, bool quiet = false);
 
 };
 
@@ -46,6 +114,16 @@ class TLEHistoricSetException: public exception
     }
 };
 
+/*  Adds a TLE built in place with the arguments of any `cTle` constructor. Returns false (and the
+ *  TLE is discarded) if there is already a TLE with the same epoch.
+ */
+template<typename... Args>
+bool TLEHistoricSet::emplaceTLE(Args &&... args)
+{
+    data.emplace_back(std::piecewise_construct, std::forward<Args>(args)...);
+    return placeLast();
+}
+
 /* Forward declaration of helper functions: */
 void printHeader(bool first);
 void printFooter(void);
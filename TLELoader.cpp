@@ -0,0 +1,314 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: TLE loader.
+ *  \details    Finds the TLE collection files in a directory tree and parses them concurrently.
+ *              Workers decode files into their own buffers, which are merged into the historic
+ *              sets once all files have been read.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       08-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+/*  Hash of the data lines of a TLE (both of them, TLE_LINE_LENGTH bytes each), read 8 bytes at a
+ *  time and finished with MurmurHash3's mixer.
+ */
+static inline uint64_t hashLines(const char * line1, const char * line2)
+{
+    const char * lines[2] = { line1, line2 };
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for(int l = 0; l < 2; l++) {
+        const char * p = lines[l];
+        int i = 0;
+        for(; i + 8 <= TLE_LINE_LENGTH; i += 8) {
+            uint64_t w;
+            memcpy(&w, p + i, 8);
+            h = (h ^ w) * 0xff51afd7ed558ccdULL;
+            h ^= h >> 32;
+        }
+        for(; i < TLE_LINE_LENGTH; i++) {
+            h = (h ^ (unsigned char)p[i]) * 0x100000001b3ULL;
+        }
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+TLELoader::TLELoader(int n_threads)
+    : pool(NULL), duplicate_count(0), unique_count(0)
+{
+    if(n_threads > 1) {
+        pool = new WorkStealingPool(n_threads);
+    }
+    buffers.resize(n_threads > 1 ? n_threads + 1 : 1);
+    for(auto b = buffers.begin(); b != buffers.end(); b++) {
+        b->records = 0;
+        b->duplicates = 0;
+        b->failed = false;
+    }
+}
+
+TLELoader::~TLELoader()
+{
+    delete pool;
+}
+
+TLELoader::Buffer & TLELoader::localBuffer(void)
+{
+    return buffers[WorkStealingPool::currentWorker() + 1];
+}
+
+/* Runs a job in the pool or, if loading serially, right away. */
+void TLELoader::run(PoolJob job)
+{
+    if(pool != NULL) {
+        pool->submit(job);
+    } else {
+        job();
+    }
+}
+
+/*  Lists a directory: regular files are added to the local buffer and each sub-directory is
+ *  scanned as a new job. Hidden entries are skipped. Links are followed, but a directory that is
+ *  one of its own `parents` (i.e. a link loop) is not scanned again.
+ */
+void TLELoader::scanDirectory(std::string path, std::vector<DirectoryId> parents)
+{
+    DIR * dir;
+    struct dirent * entry;
+    struct stat entry_stat;
+
+    if(stat(path.c_str(), &entry_stat) == 0) {
+        DirectoryId id(entry_stat.st_dev, entry_stat.st_ino);
+        if(std::find(parents.begin(), parents.end(), id) != parents.end()) {
+            localBuffer().messages.push_back({-1, 0, "  WARNING: The TLE directory " + path +
+                " is a link to one of its parents. It will be skipped."});
+            return;
+        }
+        parents.push_back(id);
+    }
+    if((dir = opendir(path.c_str())) == NULL) {
+        Buffer & buffer = localBuffer();
+        buffer.messages.push_back({-1, 0, "  ERROR: Opening the TLE directory (" + path + ") failed. Aborting."});
+        buffer.failed = true;
+        return;
+    }
+    while((entry = readdir(dir)) != NULL) {
+        if(entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string entry_path = path + "/" + entry->d_name;
+        unsigned char type = entry->d_type;
+        if(type == DT_UNKNOWN || type == DT_LNK) {
+            if(stat(entry_path.c_str(), &entry_stat) == -1) {
+                continue;
+            }
+            type = (S_ISDIR(entry_stat.st_mode) ? DT_DIR : (S_ISREG(entry_stat.st_mode) ? DT_REG : DT_UNKNOWN));
+        }
+        if(type == DT_DIR) {
+            run([this, entry_path, parents] { scanDirectory(entry_path, parents); });
+        } else if(type == DT_REG) {
+            localBuffer().files.push_back(entry_path);
+        }
+    }
+    closedir(dir);
+}
+
+/*  Finds all the files in the directory tree under `input_path`. Returns false (after printing
+ *  the reason) if any directory could not be read.
+ */
+bool TLELoader::scan(std::string input_path)
+{
+    bool success = true;
+
+    files.clear();
+    run([this, input_path] { scanDirectory(input_path, std::vector<DirectoryId>()); });
+    if(pool != NULL) {
+        pool->wait();
+    }
+    for(auto b = buffers.begin(); b != buffers.end(); b++) {
+        files.insert(files.end(), b->files.begin(), b->files.end());
+        b->files.clear();
+        success = success && !b->failed;
+    }
+    /* Files are sorted so that TLE's are always merged in the same order. */
+    std::sort(files.begin(), files.end());
+    printMessages();
+    return success;
+}
+
+/*  Looks for an element set with the same data lines as `record` (found at the given `position` of
+ *  `file`) among those already read, and adds it to the table if there is none. Returns true if it
+ *  was found and its copy comes first (i.e. `record` is a duplicate). Otherwise, `record` becomes the
+ *  copy to be kept, and its `shard` and `entry` in the table are returned, so that the copy that
+ *  was replaced (if any) can be dropped when TLE's are merged.
+ */
+bool TLELoader::isDuplicate(const TLERecord & record, int file, int position, int * shard,
+    std::size_t * entry)
+{
+    uint64_t hash = hashLines(record.line1, record.line2);
+    *shard = hash % TLE_DEDUP_SHARDS;
+    DedupShard & s = shards[*shard];
+    std::pair<int, int> owner(file, position);
+    std::lock_guard<std::mutex> lk(s.lock);
+
+    auto range = s.entries.equal_range(hash);
+    for(auto e = range.first; e != range.second; e++) {
+        const char * lines = &s.lines[e->second * 2 * TLE_LINE_LENGTH];
+        if(memcmp(lines, record.line1, TLE_LINE_LENGTH) == 0 &&
+            memcmp(lines + TLE_LINE_LENGTH, record.line2, TLE_LINE_LENGTH) == 0) {
+            if(s.owners[e->second] < owner) {
+                return true;
+            }
+            s.owners[e->second] = owner;
+            *entry = e->second;
+            return false;
+        }
+    }
+    *entry = s.owners.size();
+    s.lines.insert(s.lines.end(), record.line1, record.line1 + TLE_LINE_LENGTH);
+    s.lines.insert(s.lines.end(), record.line2, record.line2 + TLE_LINE_LENGTH);
+    s.owners.push_back(owner);
+    s.entries.insert(std::make_pair(hash, *entry));
+    return false;
+}
+
+/*  Reads one file. Unless `all_ids` is set, only the TLE's whose NORAD ID is in `tle_data` (which
+ *  is not modified while files are being parsed) are kept. Element sets that have already been
+ *  read (e.g. in a previous snapshot) are dropped before their fields are decoded.
+ */
+void TLELoader::parseFile(int index, const std::unordered_map<int, TLEHistoricSet> * tle_data,
+    bool all_ids)
+{
+    Buffer & buffer = localBuffer();
+    TLEParser parser;
+    TLERecord record;
+    TLEParser::Status status;
+    int record_count = 0;
+
+    if(!parser.open(files[index])) {
+        buffer.messages.push_back({index, 0, "  ERROR: Could not open the TLE file (" + files[index] + ")."});
+        return;
+    }
+    while((status = parser.next(record, false)) != TLEParser::PARSE_END) {
+        if(status == TLEParser::PARSE_MALFORMED) {
+            buffer.messages.push_back({index, record.line_number, "  Malformed TLE file (" + files[index] +
+                "). Error appears in lines " + std::to_string(record.line_number) + " to " +
+                std::to_string(record.line_number + 2) + "."});
+            break;
+        } else if(status == TLEParser::PARSE_CHECKSUM) {
+            buffer.messages.push_back({index, record.line_number, "  WARNING: Wrong checksum in lines " +
+                std::to_string(record.line_number) + " to " + std::to_string(record.line_number + 2) +
+                " of " + files[index] + ". The TLE will be skipped."});
+            continue;
+        }
+        record_count++;
+        if(all_ids || tle_data->find(record.norad_id) != tle_data->end()) {
+            int shard;
+            std::size_t entry;
+            if(isDuplicate(record, index, record_count, &shard, &entry)) {
+                buffer.duplicates++;
+                continue;
+            }
+            TLEParser::decodeFields(record);
+            buffer.tles.push_back(LoadedTLE(index, record_count, record.norad_id, shard, entry,
+                TLEParser::makeTLE(record)));
+        }
+    }
+    buffer.records += record_count;
+}
+
+/*  Parses the files found by `scan` and adds their TLE's to the historic sets in `tle_data` (if
+ *  `all_ids` is set, sets are created for every satellite found). The result does not depend on
+ *  the number of threads: TLE's are merged in file (path) order and, within each file, in the
+ *  order they appear, and the first copy of each element set in that order is the one kept.
+ *  Returns the number of TLE's read.
+ */
+int TLELoader::load(std::unordered_map<int, TLEHistoricSet> & tle_data, bool all_ids)
+{
+    const std::unordered_map<int, TLEHistoricSet> * selection = &tle_data;
+    int records = 0;
+
+    duplicate_count = 0;
+    for(int f = 0; f < (int)files.size(); f++) {
+        run([this, f, selection, all_ids] { parseFile(f, selection, all_ids); });
+    }
+    if(pool != NULL) {
+        pool->wait();
+    }
+
+    /*  Copies that were replaced by an earlier one of the same element set (found later by
+     *  another worker) are dropped:
+     */
+    std::vector<const LoadedTLE *> merged;
+    for(auto b = buffers.begin(); b != buffers.end(); b++) {
+        for(auto t = b->tles.begin(); t != b->tles.end(); t++) {
+            if(shards[t->shard].owners[t->entry] == std::make_pair(t->file, t->record)) {
+                merged.push_back(&(*t));
+            } else {
+                duplicate_count++;
+            }
+        }
+        records += b->records;
+        duplicate_count += b->duplicates;
+    }
+    std::sort(merged.begin(), merged.end(), [](const LoadedTLE * a, const LoadedTLE * b) {
+        return (a->file != b->file ? a->file < b->file : a->record < b->record);
+    });
+    unique_count = merged.size();
+    for(auto t = merged.begin(); t != merged.end(); t++) {
+        auto set = tle_data.find((*t)->norad_id);
+        if(set == tle_data.end()) {
+            set = tle_data.insert({(*t)->norad_id, TLEHistoricSet((*t)->norad_id)}).first;
+        }
+        set->second.addTLE((*t)->tle);
+    }
+    for(auto b = buffers.begin(); b != buffers.end(); b++) {
+        b->tles.clear();
+        b->records = 0;
+        b->duplicates = 0;
+    }
+    printMessages();
+    return records;
+}
+
+/*  Prints (and clears) the errors and warnings of all buffers, in file and line order (directory
+ *  messages, which have neither, are sorted by text).
+ */
+void TLELoader::printMessages(void)
+{
+    std::vector<Message> messages;
+    for(auto b = buffers.begin(); b != buffers.end(); b++) {
+        messages.insert(messages.end(), b->messages.begin(), b->messages.end());
+        b->messages.clear();
+    }
+    std::stable_sort(messages.begin(), messages.end(), [](const Message & a, const Message & b) {
+        return (a.file != b.file ? a.file < b.file : (a.line != b.line ? a.line < b.line : a.text < b.text));
+    });
+    for(auto m = messages.begin(); m != messages.end(); m++) {
+        cerr << DBG_REDD << m->text << DBG_NOCOLOR << endl;
+    }
+}
+
+int TLELoader::getFileCount(void) const
+{
+    return files.size();
+}
+
+int TLELoader::getDuplicateCount(void) const
+{
+    return duplicate_count;
+}
+
+int TLELoader::getUniqueCount(void) const
+{
+    return unique_count;
+}
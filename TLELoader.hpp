@@ -0,0 +1,87 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: TLE loader.
+ *  \details    Finds the TLE collection files in a directory tree and parses them concurrently.
+ *              Workers decode files into their own buffers, which are merged into the historic
+ *              sets once all files have been read.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       08-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __TLE_LOADER__
+#define __TLE_LOADER__
+
+class TLELoader
+{
+    struct LoadedTLE {
+        int file;               /* Index of the file in `files`.                                  */
+        int record;             /* Position of the record in the file.                            */
+        int norad_id;
+        int shard;              /* Entry of its element set in the table of duplicates.           */
+        std::size_t entry;
+        Zeptomoby::OrbitTools::cTle tle;
+        LoadedTLE(int f, int r, int id, int s, std::size_t e, const Zeptomoby::OrbitTools::cTle & t)
+            : file(f), record(r), norad_id(id), shard(s), entry(e), tle(t) {}
+    };
+    struct Message {
+        int file;               /* Index of the file in `files` (-1 for directories).             */
+        int line;               /* Line where the problem was found (0 if not applicable).        */
+        std::string text;
+    };
+
+    /*  One buffer for each pool worker, plus one (the first) for the calling thread. Workers only
+     *  write to their own buffer, so no locking is needed until they are merged.
+     */
+    struct Buffer {
+        std::vector<std::string> files;
+        std::vector<LoadedTLE> tles;
+        std::vector<Message> messages;
+        int records;            /* Records read (including those that were not selected).         */
+        int duplicates;         /* Selected records that had already been read.                   */
+        bool failed;            /* A directory could not be read.                                 */
+    };
+
+    /*  Element sets that have already been read, identified by the contents of their data lines,
+     *  and the copy of each one that is kept: the first one in file (path) and record order,
+     *  regardless of the order in which workers find them. The table is split in shards (chosen by
+     *  the hash of the lines) so that workers seldom wait for each other.
+     */
+    struct DedupShard {
+        std::mutex lock;
+        std::unordered_multimap<uint64_t, std::size_t> entries; /* Hash -> entry.                 */
+        std::vector<char> lines;        /* Both data lines of each entry, back to back.           */
+        std::vector<std::pair<int, int> > owners;   /* File and record of the copy of each entry. */
+    };
+
+    /* A directory, identified by its device and i-node (i.e. regardless of the links to it). */
+    typedef std::pair<dev_t, ino_t> DirectoryId;
+
+    std::vector<Buffer> buffers;
+    std::vector<std::string> files;     /* Files found by `scan` (sorted).                        */
+    WorkStealingPool * pool;            /* NULL when loading serially.                            */
+    DedupShard shards[TLE_DEDUP_SHARDS];
+    int duplicate_count;                /* Duplicates dropped by the last `load`.                 */
+    int unique_count;                   /* Element sets kept by the last `load`.                  */
+
+    Buffer & localBuffer(void);
+    void run(PoolJob job);
+    void scanDirectory(std::string path, std::vector<DirectoryId> parents);
+    bool isDuplicate(const TLERecord & record, int file, int position, int * shard, std::size_t * entry);
+    void parseFile(int index, const std::unordered_map<int, TLEHistoricSet> * tle_data, bool all_ids);
+    void printMessages(void);
+
+public:
+    TLELoader(int n_threads);
+    ~TLELoader();
+    bool scan(std::string input_path);
+    int load(std::unordered_map<int, TLEHistoricSet> & tle_data, bool all_ids = false);
+    int getFileCount(void) const;
+    int getDuplicateCount(void) const;
+    int getUniqueCount(void) const;
+};
+
+#endif /* __TLE_LOADER__ */
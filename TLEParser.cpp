@@ -0,0 +1,335 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: TLE parser.
+ *  \details    Reads TLE collection files without intermediate copies: each file is memory-mapped,
+ *              record boundaries are found with a vectorized newline scan and the fixed columns of
+ *              the data lines are decoded straight into numeric fields, while their checksum is
+ *              verified.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       06-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+using Zeptomoby::OrbitTools::cTle;
+
+/* Powers of ten that are exactly representable as doubles. */
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+/*  Returns the first newline in [p, end), or `end` if there is none. Scans 16 bytes at a time when
+ *  SSE2 is available.
+ */
+static inline const char * findNewline(const char * p, const char * end)
+{
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for(; p + 16 <= end; p += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), newline));
+        if(mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    const char * q = (const char *)memchr(p, '\n', end - p);
+    return (q != NULL ? q : end);
+}
+
+/*  Decodes a decimal number in a fixed-width field. The value is computed as an integer mantissa
+ *  divided by an exact power of ten, so that it is correctly rounded (i.e. it is the same that
+ *  `atof` gives). When `prefixed` is set, the field follows an implicit "0" (as in the mean motion
+ *  derivative), so neither leading blanks nor a sign are accepted. Returns false, leaving the
+ *  field to `cTle`, if it holds anything else than one number padded with blanks.
+ */
+static bool decodeDecimal(const char * p, int length, bool prefixed, double * value)
+{
+    int i = 0;
+    bool negative = false;
+    long long mantissa = 0;
+    int digits = 0;
+    int decimals = -1;
+
+    if(!prefixed) {
+        while(i < length && p[i] == ' ') {
+            i++;
+        }
+        if(i < length && (p[i] == '-' || p[i] == '+')) {
+            negative = (p[i] == '-');
+            i++;
+        }
+    }
+    for(; i < length; i++) {
+        if(p[i] >= '0' && p[i] <= '9') {
+            mantissa = mantissa * 10 + (p[i] - '0');
+            digits++;
+            if(decimals >= 0) {
+                decimals++;
+            }
+        } else if(p[i] == '.' && decimals < 0) {
+            decimals = 0;
+        } else {
+            break;
+        }
+    }
+    for(; i < length; i++) {
+        if(p[i] != ' ') {
+            return false;
+        }
+    }
+    if(digits == 0 || digits > 15) {
+        return false;
+    }
+
+    *value = mantissa / exact_pow10[decimals < 0 ? 0 : decimals];
+    if(negative) {
+        *value = -*value;
+    }
+    return true;
+}
+
+/*  Decodes a field in TLE exponential notation ("[ |+|-]NNNNN[ |+|-]N", with the decimal point
+ *  assumed before the mantissa; e.g. " 12345-3" is 0.12345e-3).
+ */
+static bool decodeExponential(const char * p, double * value)
+{
+    long long mantissa = 0;
+    int exponent;
+
+    if(p[0] != ' ' && p[0] != '+' && p[0] != '-') {
+        return false;
+    }
+    for(int i = 1; i <= 5; i++) {
+        if(p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        mantissa = mantissa * 10 + (p[i] - '0');
+    }
+    if((p[6] != ' ' && p[6] != '+' && p[6] != '-') || p[7] < '0' || p[7] > '9') {
+        return false;
+    }
+    exponent = (p[6] == '-' ? -(p[7] - '0') : (p[7] - '0')) - 5;
+
+    if(exponent < 0) {
+        *value = mantissa / exact_pow10[-exponent];
+    } else {
+        *value = mantissa * exact_pow10[exponent];
+    }
+    if(p[0] == '-') {
+        *value = -*value;
+    }
+    return true;
+}
+
+TLEParser::TLEParser()
+    : fd(-1), data(NULL), size(0), cursor(NULL), line_count(0)
+{
+}
+
+TLEParser::~TLEParser()
+{
+    close();
+}
+
+/*  Maps a TLE collection file in memory. Returns false if the file can not be opened or mapped.
+ */
+bool TLEParser::open(std::string file_path)
+{
+    struct stat file_stat;
+
+    close();
+    if((fd = ::open(file_path.c_str(), O_RDONLY)) == -1) {
+        return false;
+    }
+    if(fstat(fd, &file_stat) == -1) {
+        close();
+        return false;
+    }
+    size = file_stat.st_size;
+    if(size > 0) {
+        void * map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED) {
+            close();
+            return false;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        data = (const char *)map;
+    }
+    path = file_path;
+    cursor = data;
+    line_count = 0;
+    return true;
+}
+
+void TLEParser::close(void)
+{
+    if(data != NULL) {
+        munmap((void *)data, size);
+    }
+    if(fd != -1) {
+        ::close(fd);
+    }
+    fd = -1;
+    data = NULL;
+    size = 0;
+    cursor = NULL;
+}
+
+/*  Gets the next line (without its line terminator, either "\n" or "\r\n"). Returns false at the
+ *  end of the file.
+ */
+bool TLEParser::nextLine(const char ** line, int * length)
+{
+    const char * end = data + size;
+    if(cursor == NULL || cursor >= end) {
+        return false;
+    }
+    const char * newline = findNewline(cursor, end);
+    *line = cursor;
+    *length = newline - cursor;
+    if(*length > 0 && cursor[*length - 1] == '\r') {
+        (*length)--;
+    }
+    cursor = (newline < end ? newline + 1 : end);
+    line_count++;
+    return true;
+}
+
+/*  Verifies the checksum of a data line: the sum of its digits (minus signs count as 1) modulo 10
+ *  has to match its last character. The first 64 characters are added 16 at a time when SSE2 is
+ *  available.
+ */
+bool TLEParser::checksum(const char * line)
+{
+    int sum = 0;
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i char_zero = _mm_set1_epi8('0');
+    const __m128i char_minus = _mm_set1_epi8('-');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i acc = zero;
+    for(; i + 16 <= TLE_LINE_LENGTH - 1; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(line + i));
+        __m128i d = _mm_sub_epi8(c, char_zero);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, nine), d);
+        __m128i v = _mm_or_si128(_mm_and_si128(is_digit, d),
+            _mm_and_si128(_mm_cmpeq_epi8(c, char_minus), one));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+    }
+    sum = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+    for(; i < TLE_LINE_LENGTH - 1; i++) {
+        if(line[i] >= '0' && line[i] <= '9') {
+            sum += line[i] - '0';
+        } else if(line[i] == '-') {
+            sum++;
+        }
+    }
+    return (line[TLE_LINE_LENGTH - 1] - '0') == (sum % 10);
+}
+
+/*  Decodes the numeric fields of both data lines (columns as in cTle.h). The international
+ *  designator is not numeric and is left to `cTle`, as well as any field that does not have the
+ *  expected format.
+ */
+void TLEParser::decodeFields(TLERecord & record)
+{
+    const char * l1 = record.line1;
+    const char * l2 = record.line2;
+    double * f = record.fields;
+    unsigned int mask = 0;
+
+    mask |= decodeDecimal(l1 +  2,  5, false, &f[cTle::FLD_NORADNUM])   << cTle::FLD_NORADNUM;
+    mask |= decodeDecimal(l1 + 64,  4, false, &f[cTle::FLD_SET])        << cTle::FLD_SET;
+    mask |= decodeDecimal(l1 + 18,  2, false, &f[cTle::FLD_EPOCHYEAR])  << cTle::FLD_EPOCHYEAR;
+    mask |= decodeDecimal(l1 + 20, 12, false, &f[cTle::FLD_EPOCHDAY])   << cTle::FLD_EPOCHDAY;
+    if(decodeDecimal(l1 + 34, 10, true, &f[cTle::FLD_MMOTIONDT])) {
+        if(l1[33] == '-') {
+            f[cTle::FLD_MMOTIONDT] = -f[cTle::FLD_MMOTIONDT];
+        }
+        mask |= 1u << cTle::FLD_MMOTIONDT;
+    }
+    mask |= decodeExponential(l1 + 44, &f[cTle::FLD_MMOTIONDT2])        << cTle::FLD_MMOTIONDT2;
+    mask |= decodeExponential(l1 + 53, &f[cTle::FLD_BSTAR])             << cTle::FLD_BSTAR;
+
+    mask |= decodeDecimal(l2 +  8,  8, false, &f[cTle::FLD_I])          << cTle::FLD_I;
+    mask |= decodeDecimal(l2 + 17,  8, false, &f[cTle::FLD_RAAN])       << cTle::FLD_RAAN;
+    long long e = 0;
+    int i;
+    for(i = 26; i < 33 && l2[i] >= '0' && l2[i] <= '9'; i++) {
+        e = e * 10 + (l2[i] - '0');
+    }
+    if(i == 33) {
+        f[cTle::FLD_E] = e / 1e7;   /* Decimal point assumed. */
+        mask |= 1u << cTle::FLD_E;
+    }
+    mask |= decodeDecimal(l2 + 34,  8, false, &f[cTle::FLD_ARGPER])     << cTle::FLD_ARGPER;
+    mask |= decodeDecimal(l2 + 43,  8, false, &f[cTle::FLD_M])          << cTle::FLD_M;
+    mask |= decodeDecimal(l2 + 52, 11, false, &f[cTle::FLD_MMOTION])    << cTle::FLD_MMOTION;
+    mask |= decodeDecimal(l2 + 63,  5, false, &f[cTle::FLD_ORBITNUM])   << cTle::FLD_ORBITNUM;
+
+    record.field_mask = mask;
+}
+
+/*  Reads the next record (a name line followed by two data lines; blank lines between records
+ *  are skipped). The record is malformed if its data lines are too short, are not numbered 1 and
+ *  2, or their satellite numbers differ; in that case `line_number` tells where it starts. Only
+ *  the NORAD ID is decoded if `decode` is false (see `decodeFields`).
+ */
+TLEParser::Status TLEParser::next(TLERecord & record, bool decode)
+{
+    const char * name;
+    int name_length;
+    int length1, length2;
+
+    bool blank;
+    do {
+        if(!nextLine(&name, &name_length)) {
+            return PARSE_END;
+        }
+        blank = true;
+        for(int i = 0; i < name_length && blank; i++) {
+            blank = (name[i] == ' ' || name[i] == '\t');
+        }
+    } while(blank);
+
+    record.name = name;
+    record.name_length = name_length;
+    record.line_number = line_count;
+    if(!nextLine(&record.line1, &length1) || !nextLine(&record.line2, &length2)) {
+        return PARSE_END;
+    }
+
+    if(length1 < TLE_LINE_LENGTH || length2 < TLE_LINE_LENGTH ||
+        record.line1[0] != '1' || record.line2[0] != '2' ||
+        memcmp(record.line1 + 2, record.line2 + 2, 5) != 0) {
+        return PARSE_MALFORMED;
+    }
+    if(!checksum(record.line1) || !checksum(record.line2)) {
+        return PARSE_CHECKSUM;
+    }
+
+    if(!decodeDecimal(record.line1 + 2, 5, false, &record.fields[cTle::FLD_NORADNUM])) {
+        return PARSE_MALFORMED;
+    }
+    record.norad_id = (int)record.fields[cTle::FLD_NORADNUM];
+    record.field_mask = 1u << cTle::FLD_NORADNUM;
+    if(decode) {
+        decodeFields(record);
+    }
+    return PARSE_OK;
+}
+
+/*  Builds a `cTle` object with the decoded values (the lines are only copied for this). */
+cTle TLEParser::makeTLE(const TLERecord & record)
+{
+    return cTle(record.name, record.name_length, record.line1, record.line2, record.fields,
+        record.field_mask);
+}
@@ -0,0 +1,63 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: TLE parser.
+ *  \details    Reads TLE collection files without intermediate copies: each file is memory-mapped,
+ *              record boundaries are found with a vectorized newline scan and the fixed columns of
+ *              the data lines are decoded straight into numeric fields, while their checksum is
+ *              verified.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       06-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __TLE_PARSER__
+#define __TLE_PARSER__
+
+/*  A decoded element set. Pointers refer to the mapped file and are only valid until the parser
+ *  is closed or moved to another file.
+ */
+struct TLERecord {
+    const char * name;          /* Name line (not null-terminated, without line terminator).     */
+    int name_length;            /* Length of the name line.                                       */
+    const char * line1;         /* First data line (TLE_LINE_LENGTH characters).                  */
+    const char * line2;         /* Second data line (TLE_LINE_LENGTH characters).                 */
+    int line_number;            /* Line number (in the file, 1-based) of the name line.           */
+    int norad_id;               /* Satellite number.                                              */
+    double fields[Zeptomoby::OrbitTools::cTle::FLD_LAST];   /* Values in native units.            */
+    unsigned int field_mask;    /* Bit (1 << field) is set for each field that has been decoded.  */
+};
+
+class TLEParser
+{
+    std::string path;           /* Path of the open file.                                         */
+    int fd;                     /* File descriptor (-1 if no file is open).                       */
+    const char * data;          /* Mapped file contents.                                          */
+    std::size_t size;           /* Size of the file (in bytes).                                   */
+    const char * cursor;        /* Start of the next line to read.                                */
+    int line_count;             /* Lines read so far.                                             */
+
+    bool nextLine(const char ** line, int * length);
+
+public:
+    enum Status {
+        PARSE_OK,               /* A record has been read.                                        */
+        PARSE_END,              /* End of file (incomplete trailing records are ignored).         */
+        PARSE_MALFORMED,        /* Malformed record: the rest of the file can not be trusted.     */
+        PARSE_CHECKSUM          /* Wrong checksum: the record should be skipped.                  */
+    };
+
+    TLEParser();
+    ~TLEParser();
+    bool open(std::string path);
+    void close(void);
+    Status next(TLERecord & record, bool decode = true);
+
+    static bool checksum(const char * line);
+    static void decodeFields(TLERecord & record);
+    static Zeptomoby::OrbitTools::cTle makeTLE(const TLERecord & record);
+};
+
+#endif /* __TLE_PARSER__ */
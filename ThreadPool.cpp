@@ -0,0 +1,179 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: Thread pool.
+ *  \details    Fixed-size pool of worker threads with one job deque per worker and work stealing.
+ *              Idle workers take jobs from the deques of busy workers, so that the pool stays busy
+ *              until the last job has been executed.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       18-jan-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+/* Index of the worker running in the calling thread (-1 for threads not owned by a pool). */
+static thread_local int pool_worker_index = -1;
+
+WorkStealingPool::WorkStealingPool(int n_threads)
+    : queued(0), pending(0), stopping(false), next_worker(0)
+{
+    if(n_threads < 1) {
+        n_threads = 1;
+    }
+    for(int w = 0; w < n_threads; w++) {
+        workers.push_back(new Worker());
+    }
+    for(int w = 0; w < n_threads; w++) {
+        threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, w));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    try {
+        wait();
+    } catch(...) {
+        /* Exceptions of jobs that nobody waited for are dropped. */
+    }
+    {
+        std::lock_guard<std::mutex> lk(idle_lock);
+        stopping = true;
+    }
+    idle_cv.notify_all();
+    for(auto t = threads.begin(); t != threads.end(); t++) {
+        t->join();
+    }
+    for(auto w = workers.begin(); w != workers.end(); w++) {
+        delete *w;
+    }
+}
+
+/*  Queues a job. When called from one of the workers, the job is placed at the front of its own
+ *  deque (i.e. it will be the next one to run there, unless it gets stolen first). Otherwise, jobs
+ *  are distributed among workers in a round-robin fashion.
+ */
+void WorkStealingPool::submit(PoolJob job)
+{
+    int w = pool_worker_index;
+    pending++;
+    if(w >= 0 && w < (int)workers.size()) {
+        std::lock_guard<std::mutex> lk(workers[w]->lock);
+        workers[w]->jobs.push_front(job);
+    } else {
+        w = next_worker++ % workers.size();
+        std::lock_guard<std::mutex> lk(workers[w]->lock);
+        workers[w]->jobs.push_back(job);
+    }
+    queued++;
+    {
+        std::lock_guard<std::mutex> lk(idle_lock);
+    }
+    idle_cv.notify_one();
+}
+
+/*  Queues a job at the back of the given worker's deque. Submitting jobs in decreasing order of
+ *  cost keeps every deque sorted (most expensive job first).
+ */
+void WorkStealingPool::submit(PoolJob job, int worker)
+{
+    worker = worker % workers.size();
+    pending++;
+    {
+        std::lock_guard<std::mutex> lk(workers[worker]->lock);
+        workers[worker]->jobs.push_back(job);
+    }
+    queued++;
+    {
+        std::lock_guard<std::mutex> lk(idle_lock);
+    }
+    idle_cv.notify_one();
+}
+
+bool WorkStealingPool::popJob(int worker, PoolJob & job)
+{
+    std::lock_guard<std::mutex> lk(workers[worker]->lock);
+    if(workers[worker]->jobs.empty()) {
+        return false;
+    }
+    job = workers[worker]->jobs.front();
+    workers[worker]->jobs.pop_front();
+    queued--;
+    return true;
+}
+
+/*  Takes the next job of another worker. Victims are visited starting from the thief's neighbour
+ *  so that thieves do not all contend for the same deque.
+ */
+bool WorkStealingPool::stealJob(int thief, PoolJob & job)
+{
+    int n = workers.size();
+    for(int k = 1; k <= n; k++) {
+        int victim = ((thief < 0 ? 0 : thief) + k) % n;
+        if(victim != thief && popJob(victim, job)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*  Runs a job. Exceptions do not leave the worker: the first one is kept and thrown by `wait`. */
+void WorkStealingPool::runJob(PoolJob & job)
+{
+    try {
+        job();
+    } catch(...) {
+        std::lock_guard<std::mutex> lk(idle_lock);
+        if(!error) {
+            error = std::current_exception();
+        }
+    }
+    if(--pending == 0) {
+        std::lock_guard<std::mutex> lk(idle_lock);
+        done_cv.notify_all();
+    }
+}
+
+void WorkStealingPool::workerLoop(int worker)
+{
+    pool_worker_index = worker;
+    while(1) {
+        PoolJob job;
+        if(popJob(worker, job) || stealJob(worker, job)) {
+            runJob(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(idle_lock);
+        idle_cv.wait(lk, [this] { return queued > 0 || stopping; });
+        if(stopping && queued == 0) {
+            break;
+        }
+    }
+    pool_worker_index = -1;
+}
+
+/*  Blocks the calling thread until every submitted job has finished. If any of them threw an
+ *  exception, the first one is thrown again here (once).
+ */
+void WorkStealingPool::wait(void)
+{
+    std::unique_lock<std::mutex> lk(idle_lock);
+    done_cv.wait(lk, [this] { return pending == 0; });
+    if(error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+int WorkStealingPool::size(void) const
+{
+    return workers.size();
+}
+
+int WorkStealingPool::currentWorker(void)
+{
+    return pool_worker_index;
+}
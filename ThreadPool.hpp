@@ -0,0 +1,57 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: Thread pool.
+ *  \details    Fixed-size pool of worker threads with one job deque per worker and work stealing.
+ *              Idle workers take jobs from the deques of busy workers, so that the pool stays busy
+ *              until the last job has been executed.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       18-jan-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#ifndef __THREAD_POOL__
+#define __THREAD_POOL__
+
+typedef std::function<void(void)> PoolJob;
+
+class WorkStealingPool
+{
+    /*  Each worker owns a deque. The front of the deque holds the job that has to be executed
+     *  next, both by its owner and by thieves: jobs are expected to be queued in decreasing order
+     *  of cost, so that the most expensive remaining job is always the first to be picked.
+     */
+    struct Worker {
+        std::mutex lock;
+        std::deque<PoolJob> jobs;
+    };
+
+    std::vector<Worker *> workers;
+    std::vector<std::thread> threads;
+    std::atomic<int> queued;        /* Jobs waiting in any of the deques.                         */
+    std::atomic<int> pending;       /* Jobs submitted and not yet finished.                       */
+    std::atomic<bool> stopping;
+    std::atomic<unsigned int> next_worker;  /* Round-robin counter for external submissions.      */
+    std::mutex idle_lock;
+    std::condition_variable idle_cv;    /* Signaled when jobs are queued or when stopping.        */
+    std::condition_variable done_cv;    /* Signaled when `pending` reaches zero.                  */
+    std::exception_ptr error;           /* First exception thrown by a job (see `wait`).          */
+
+    bool popJob(int worker, PoolJob & job);
+    bool stealJob(int thief, PoolJob & job);
+    void runJob(PoolJob & job);
+    void workerLoop(int worker);
+
+public:
+    WorkStealingPool(int n_threads);
+    ~WorkStealingPool();
+    void submit(PoolJob job);
+    void submit(PoolJob job, int worker);
+    void wait(void);
+    int size(void) const;
+    static int currentWorker(void);
+};
+
+#endif /* __THREAD_POOL__ */
@@ -7,7 +7,9 @@ function [cds, items] = orblearnLoad3(path_to_props, d_max, max_files, sort_meth
 %   to store the actual time for each of the cross-distance points: that's what the first column
 %   d(:,1) is used for.
 %
-% Args:   path_to_props ->  The path to a folder containing *.prop files. Should end in "/".
+% Args:   path_to_props ->  The path to a folder containing *.prop files. Should end in "/". It can
+%                           also be a catalog container (*.propc file, see orblearnLoadPropc), in
+%                           which all the satellites share the same time axis.
 %                 d_max ->  Maximum distance to consider an encounter.
 %             max_files ->  Limit the amount of scanned files.
 %           sort_method ->  Whether to sort propagation files randomly ("rand"), backwards
@@ -34,8 +36,15 @@ function [cds, items] = orblearnLoad3(path_to_props, d_max, max_files, sort_meth
 %                           or the total number of *.prop files.
 %
 
-    search_path = strcat(path_to_props, "*.prop");
-    csvfiles = dir(search_path);                    % Find all propagation files in this folder.
+    container = (numel(path_to_props) > 6 && strcmp(path_to_props(end-5:end), ".propc"));
+    if container
+        % Satellites are listed in the directory of the container (named like their *.prop file):
+        [~, ~, sat_ids, h] = orblearnLoadPropc(path_to_props, [], 1, 0);
+        csvfiles = struct("name", arrayfun(@(id) sprintf("%d.prop", id), sat_ids, "UniformOutput", false));
+    else
+        search_path = strcat(path_to_props, "*.prop");
+        csvfiles = dir(search_path);                % Find all propagation files in this folder.
+    end
     if strcmp(sort_method, "rand")
         % Randomize the order of '*.prop' files:
         csvfiles = csvfiles(randperm(numel(csvfiles)));
@@ -68,7 +77,7 @@ function [cds, items] = orblearnLoad3(path_to_props, d_max, max_files, sort_meth
     if numel(csvfiles) >= 2
         for ii = 1:iterator_max
             id_ii = str2num(strsplit(csvfiles(ii).name, "."){1});
-            prop_ii = csvread(strcat(path_to_props, csvfiles(ii).name))(7:end, 2:5);  % Load data.
+            prop_ii = loadPositions(path_to_props, csvfiles(ii).name, container);  % Load data.
             % Check that files are not empty:
             if size(prop_ii, 1) == 0
                 printf("[   !!] \x1b[31;1mError found in propagations: empty propagation file \"%s\"\x1b[0m\n", csvfiles(ii).name);
@@ -79,15 +88,18 @@ function [cds, items] = orblearnLoad3(path_to_props, d_max, max_files, sort_meth
                     id_jj = str2num(strsplit(csvfiles(jj).name, "."){1});
                     printf("[%5d] Generating cross-distance for %5u and %5u: ", nn, id_ii, id_jj);
                     fflush(stdout);
-                    prop_jj = csvread(strcat(path_to_props, csvfiles(jj).name))(7:end, 2:5);  % Load data.
+                    prop_jj = loadPositions(path_to_props, csvfiles(jj).name, container);  % Load data.
 
                     % Check that files are not empty:
                     if size(prop_jj, 1) == 0
                         printf("\x1b[31merror\x1b[0m\n[   !!] \x1b[31;1mError found in propagations: empty propagation file \"%s\"\x1b[0m\n", csvfiles(jj).name);
                         continue;
                     end
-                    % Check that times are consistent:
-                    c = sum(prop_ii([1 2 3 end-2 end-1 end], 1) != prop_jj([1 2 3 end-2 end-1 end], 1));
+                    % Check that times are consistent (they always are in a container):
+                    c = 0;
+                    if !container
+                        c = sum(prop_ii([1 2 3 end-2 end-1 end], 1) != prop_jj([1 2 3 end-2 end-1 end], 1));
+                    end
                     if c > 0
                         printf("\x1b[31merror\x1b[0m\n[   !!] \x1b[31;1mError found in propagations: time vector does not match\x1b[0m\n");
                         d_k = zeros(1, 2);
@@ -150,9 +162,15 @@ function [cds, items] = orblearnLoad3(path_to_props, d_max, max_files, sort_meth
                     % Save other details:
                     cds(nn).d = d_k;
                     cds(nn).p = [id_ii id_jj];
-                    cds(nn).tstart = csvread(strcat(path_to_props, csvfiles(jj).name))(2, 2);
-                    cds(nn).tend   = csvread(strcat(path_to_props, csvfiles(jj).name))(3, 2);
-                    cds(nn).tstep  = csvread(strcat(path_to_props, csvfiles(jj).name))(4, 2);
+                    if container
+                        cds(nn).tstart = h.tstart;
+                        cds(nn).tend   = h.tend;
+                        cds(nn).tstep  = h.tstep;
+                    else
+                        cds(nn).tstart = csvread(strcat(path_to_props, csvfiles(jj).name))(2, 2);
+                        cds(nn).tend   = csvread(strcat(path_to_props, csvfiles(jj).name))(3, 2);
+                        cds(nn).tstep  = csvread(strcat(path_to_props, csvfiles(jj).name))(4, 2);
+                    end
 
                     % Save in file:
                     if length(save_path) > 0
@@ -180,3 +198,17 @@ function [cds, items] = orblearnLoad3(path_to_props, d_max, max_files, sort_meth
         items = 0;
     end
 end
+
+function prop = loadPositions(path_to_props, file_name, container)
+% Loads the timestamp and the position of a satellite, either from its *.prop file or from a catalog
+%   container (where it is found by its NORAD ID). Satellites without any point are empty.
+    if container
+        [p, t] = orblearnLoadPropc(path_to_props, str2num(strsplit(file_name, "."){1}));
+        prop = [t reshape(p(:, 1, 3:5), [], 3)];
+        if all(isnan(prop(:, 2)))
+            prop = zeros(0, 4);
+        end
+    else
+        prop = csvread(strcat(path_to_props, file_name))(7:end, 2:5);
+    end
+end
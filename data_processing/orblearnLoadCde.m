@@ -0,0 +1,75 @@
+function [cdts, items] = orblearnLoadCde(path_to_cde, max_files = Inf)
+% ORBLEARNLOADCDE loads the encounter event files (cde_*.cde) generated by `orbprop -X <d_max>`
+%   from the specified directory. The resulting structs have the same event times as the ones of
+%   orblearnLoad4, as well as the amplitude of each encounter (see orblearnSingleEventAnalysis), but
+%   no cross-distances: `orbprop` finds the events while it propagates the catalog and interpolates
+%   the times at which the distance crosses `d_max`.
+%
+%   Encounter:   [ Ei-1 ]                     [╌╌╌ Ei ╌╌╌╌]            [ Ei+1 ]
+%   Periods:    ········ ◀─────── t1 ───────▶ ◀─── t2 ────▶ ····················
+%               ········ ◀────────────── t3 ──────────────▶ ····················
+%
+% Args:     path_to_cde ->  The path to a folder containing *.cde files. Should end in "/".
+%             max_files ->  Limit the amount of loaded files.
+%
+% Usage:  [cdts, items] = orblearnLoadCde("path/to/propagations/folder/")
+%   where          cdts ->  A Cross-Distance Times Struct, which has 10 children:
+%                               cdts.t1     ->  A [1xN] matrix that stores t1 for each enounter.
+%                               cdts.t2     ->  A [1xN] matrix that stores t2 for each enounter.
+%                               cdts.t3     ->  A [1xN] matrix that stores t3 for each enounter.
+%                               cdts.amp    ->  A [1xN] matrix that stores the minimum distance of
+%                                               each encounter.
+%                               cdts.start  ->  A [1xN] matrix that stores the start time of each
+%                                               encounter.
+%                               cdts.flags  ->  A [1xN] matrix with the flags of each encounter: 1
+%                                               if it was already on at its first sample, 2 if it
+%                                               was still on at its last sample.
+%                               cdts.p      ->  The pair of satellites that generate these events.
+%                               cdts.tstart ->  Start time of the propagation.
+%                               cdts.tend   ->  End time of the propagation.
+%                               cdts.tstep  ->  The sampling rate for this propagation.
+%                 items ->  The number of event files that have been loaded.
+%
+
+    cdefiles = dir(strcat(path_to_cde, "cde_*.cde"));  % Find all encounter event files.
+    items = min(numel(cdefiles), max_files);
+    cdts = struct("t1", {}, "t2", {}, "t3", {}, "amp", {}, "start", {}, "flags", {}, "p", {}, ...
+        "tstart", {}, "tend", {}, "tstep", {});
+
+    nn = 0;
+    for ii = 1:items
+        fid = fopen(strcat(path_to_cde, cdefiles(ii).name), "r");
+        % Header (see CrossDistance.hpp):
+        magic = fread(fid, [1 8], "char=>char");
+        version = fread(fid, 1, "uint32");
+        if !strcmp(magic, "ORBPCEVT") || version != 1
+            printf("[   !!] \x1b[31;1mError: \"%s\" is not an encounter event file\x1b[0m\n", cdefiles(ii).name);
+            fclose(fid);
+            continue;
+        end
+        fread(fid, 1, "uint32");                    % scan_intersec.
+        p = fread(fid, [1 2], "int32");
+        t = fread(fid, [1 3], "int64");             % Start, end and step.
+        fread(fid, 1, "double");                    % d_max.
+        % Events (start, t1 and t2, followed by the amplitude and the flags):
+        raw = fread(fid, [32 Inf], "uint8=>uint8");
+        fclose(fid);
+        times = reshape(typecast(reshape(raw(1:24, :), 1, []), "double"), 3, []);
+        amp = typecast(reshape(raw(25:28, :), 1, []), "single");
+        flags = typecast(reshape(raw(29:32, :), 1, []), "uint32");
+
+        ++nn;
+        cdts(nn).t1 = times(2, :);
+        cdts(nn).t2 = times(3, :);
+        cdts(nn).t3 = times(2, :) + times(3, :);
+        cdts(nn).amp = double(amp);
+        cdts(nn).start = times(1, :);
+        cdts(nn).flags = double(flags);
+        cdts(nn).p = p;
+        cdts(nn).tstart = t(1);
+        cdts(nn).tend   = t(2);
+        cdts(nn).tstep  = t(3);
+    end
+    items = nn;
+    printf("Done (%d encounter event sets).\n", items);
+end
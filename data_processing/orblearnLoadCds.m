@@ -0,0 +1,56 @@
+function [cds, items] = orblearnLoadCds(path_to_cdb, max_files = Inf)
+% ORBLEARNLOADCDS loads the cross-distance files (cds_*.cdb) generated by `orbprop -X <d_max>`
+%   from the specified directory. The resulting structs are the same as in orblearnLoad3, but the
+%   cross-distances are not computed here: `orbprop` computes them for all pairs of satellites while
+%   it propagates the catalog, and only writes files for pairs that have been within `d_max`.
+%
+% Args:     path_to_cdb ->  The path to a folder containing *.cdb files. Should end in "/".
+%             max_files ->  Limit the amount of loaded files.
+%
+% Usage:  [cds, items] = orblearnLoadCds("path/to/propagations/folder/")
+%   where           cds ->  A Cross-Distance Struct, which has 5 children:
+%                               cds.d       ->  A Kx2 matrix with the time of each sample (first
+%                                               column) and the cross-distance (second column).
+%                               cds.p       ->  The pair of satellites that generate this cross-
+%                                               distance.
+%                               cds.tstart  ->  Start time of the propagation.
+%                               cds.tend    ->  End time of the propagation.
+%                               cds.tstep   ->  The sampling rate for this propagation.
+%                 items ->  The number of cross-distances that have been loaded.
+%
+
+    cdbfiles = dir(strcat(path_to_cdb, "cds_*.cdb"));  % Find all cross-distance files.
+    items = min(numel(cdbfiles), max_files);
+    cds = struct("d", {}, "p", {}, "tstart", {}, "tend", {}, "tstep", {});
+
+    nn = 0;
+    for ii = 1:items
+        fid = fopen(strcat(path_to_cdb, cdbfiles(ii).name), "r");
+        % Header (see CrossDistance.hpp):
+        magic = fread(fid, [1 8], "char=>char");
+        version = fread(fid, 1, "uint32");
+        if !strcmp(magic, "ORBPCDST") || version != 1
+            printf("[   !!] \x1b[31;1mError: \"%s\" is not a cross-distance file\x1b[0m\n", cdbfiles(ii).name);
+            fclose(fid);
+            continue;
+        end
+        fread(fid, 1, "uint32");                    % scan_intersec.
+        p = fread(fid, [1 2], "int32");
+        t = fread(fid, [1 3], "int64");             % Start, end and step.
+        fread(fid, 1, "double");                    % d_max.
+        % Samples (step and distance):
+        samples = fread(fid, [2 Inf], "uint32=>double");
+        fclose(fid);
+        steps = samples(1, :)';
+        distances = typecast(uint32(samples(2, :)), "single")';
+
+        ++nn;
+        cds(nn).d = [(t(1) + steps * t(3)) double(distances)];
+        cds(nn).p = p;
+        cds(nn).tstart = t(1);
+        cds(nn).tend   = t(2);
+        cds(nn).tstep  = t(3);
+    end
+    items = nn;
+    printf("Done (%d cross-distances).\n", items);
+end
@@ -0,0 +1,53 @@
+function [p, h] = orblearnLoadPropb(path_to_propb, first = 1, count = Inf)
+% ORBLEARNLOADPROPB loads the points of a binary propagation file (*.propb) generated by
+%   `orbprop -b`. Records have a fixed size and there is one per time step, so any range of points
+%   is read directly (without parsing the previous ones). Points that could not be propagated are
+%   NaN (except for their time).
+%
+% Args:   path_to_propb ->  The path to a *.propb file.
+%                 first ->  First point to load (the one at `h.tstart`, by default).
+%                 count ->  Maximum number of points to load.
+%
+% Usage:  [p, h] = orblearnLoadPropb("path/to/propagations/folder/25338.propb")
+%   where             p ->  A Kx9 matrix with the same columns as *.prop files, except for the
+%                           formatted time: timestamp, latitude, longitude, x, y, z, vx, vy and vz.
+%                     h ->  The file header, which has 7 children:
+%                               h.id        ->  NORAD ID of the satellite.
+%                               h.created   ->  File generation time.
+%                               h.tstart    ->  Start time of the propagation.
+%                               h.tend      ->  End time of the propagation.
+%                               h.tstep     ->  The sampling rate for this propagation.
+%                               h.points    ->  Requested number of points.
+%                               h.records   ->  Number of points in the file.
+%
+
+    p = zeros(0, 9);
+    h = struct();
+    fid = fopen(path_to_propb, "r");
+    % Header (see PropagationFile.hpp):
+    magic = fread(fid, [1 8], "char=>char");
+    version = fread(fid, 1, "uint32");
+    if !strcmp(magic, "ORBPPROP") || version != 1
+        printf("[   !!] \x1b[31;1mError: \"%s\" is not a binary propagation file\x1b[0m\n", path_to_propb);
+        fclose(fid);
+        return;
+    end
+    header_size = fread(fid, 1, "uint32");
+    record_size = fread(fid, 1, "uint32");
+    h.id = fread(fid, 1, "int32");
+    t = fread(fid, [1 6], "int64");
+    h.created = t(1);
+    h.tstart  = t(2);
+    h.tend    = t(3);
+    h.tstep   = t(4);
+    h.points  = t(5);
+    h.records = t(6);
+
+    % Records (time, followed by 8 doubles):
+    count = max(0, min(count, h.records - first + 1));
+    fseek(fid, header_size + (first - 1) * record_size, SEEK_SET);
+    raw = fread(fid, [record_size count], "uint8=>uint8");
+    fclose(fid);
+    p = [double(typecast(reshape(raw(1:8, :), 1, []), "int64"))' ...
+        reshape(typecast(reshape(raw(9:72, :), 1, []), "double"), 8, [])'];
+end
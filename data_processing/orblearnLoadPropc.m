@@ -0,0 +1,93 @@
+function [p, t, ids, h] = orblearnLoadPropc(path_to_propc, ids = [], first = 1, count = Inf)
+% ORBLEARNLOADPROPC loads a slice of a catalog container (catalog.propc) generated by `orbprop -K`.
+%   All the satellites share the same time axis and have a point at every step (NaN if it could not
+%   be propagated), so any satellite or range of steps is read directly, without checking that the
+%   times of different satellites match.
+%
+% Args:   path_to_propc ->  The path to a *.propc file.
+%                   ids ->  NORAD IDs of the satellites to load (all of them, by default). IDs that
+%                           are not in the container are dropped.
+%                 first ->  First step to load (the one at `h.tstart`, by default).
+%                 count ->  Maximum number of steps to load.
+%
+% Usage:  [p, t, ids, h] = orblearnLoadPropc("path/to/propagations/folder/catalog.propc", [25338 25544])
+%   where             p ->  A KxSx8 array with the points of S satellites at K steps: latitude,
+%                           longitude, x, y, z, vx, vy and vz (p(:, s, :) belongs to ids(s)).
+%                     t ->  A Kx1 vector with the timestamp of each step.
+%                   ids ->  NORAD IDs of the loaded satellites.
+%                     h ->  The file header, which has 10 children:
+%                               h.created   ->  File generation time.
+%                               h.tstart    ->  Start time of the propagation.
+%                               h.tend      ->  End time of the propagation.
+%                               h.tstep     ->  The sampling rate for this propagation.
+%                               h.points    ->  Requested number of points.
+%                               h.steps     ->  Number of steps in the file.
+%                               h.ids       ->  NORAD IDs of all the satellites in the file.
+%                               h.tles      ->  Number of TLE's used for each satellite.
+%                               h.first     ->  First step covered by the TLE's of each satellite
+%                                               (1 for the one at `h.tstart`).
+%                               h.covered   ->  Number of steps covered by them.
+%
+
+    p = zeros(0, 0, 8);
+    t = zeros(0, 1);
+    h = struct();
+    fid = fopen(path_to_propc, "r");
+    % Header (see PropagationFile.hpp):
+    magic = fread(fid, [1 8], "char=>char");
+    version = fread(fid, 1, "uint32");
+    if !strcmp(magic, "ORBPCATL") || version != 1
+        printf("[   !!] \x1b[31;1mError: \"%s\" is not a catalog container\x1b[0m\n", path_to_propc);
+        fclose(fid);
+        ids = [];
+        return;
+    end
+    sizes = fread(fid, [1 3], "uint32");            % Header, directory entry and point sizes.
+    v = fread(fid, [1 10], "int64");
+    h.created = v(1);
+    h.tstart  = v(2);
+    h.tend    = v(3);
+    h.tstep   = v(4);
+    h.points  = v(5);
+    h.steps   = v(7);
+    n_sats = v(6);
+    point_size = sizes(3);
+
+    % Satellite directory (NORAD ID, TLE's, first step and steps covered):
+    fseek(fid, v(8), SEEK_SET);
+    raw = fread(fid, [sizes(2) n_sats], "uint8=>uint8");
+    h.ids     = double(typecast(reshape(raw(1:4, :), 1, []), "int32"))';
+    h.tles    = double(typecast(reshape(raw(5:8, :), 1, []), "int32"))';
+    h.first   = double(typecast(reshape(raw(9:16, :), 1, []), "int64"))' + 1;
+    h.covered = double(typecast(reshape(raw(17:24, :), 1, []), "int64"))';
+
+    % Satellites to load:
+    if isempty(ids)
+        cols = 1:n_sats;
+    else
+        [found, cols] = ismember(ids(:)', h.ids');
+        if any(!found)
+            printf("[    !] \x1b[33mWarning: %d satellites are not in \"%s\"\x1b[0m\n", sum(!found), path_to_propc);
+        end
+        cols = cols(found);
+    end
+    ids = h.ids(cols);
+
+    % Time axis:
+    count = max(0, min(count, h.steps - first + 1));
+    fseek(fid, v(9) + (first - 1) * 8, SEEK_SET);
+    t = fread(fid, count, "int64");
+
+    % Points ([time][satellite][component]):
+    if numel(cols) == 1
+        % Only the points of this satellite are read (the others are skipped):
+        fseek(fid, v(10) + ((first - 1) * n_sats + cols - 1) * point_size, SEEK_SET);
+        raw = fread(fid, [8 count], "8*double", (n_sats - 1) * point_size);
+        p = reshape(raw', count, 1, 8);
+    else
+        fseek(fid, v(10) + (first - 1) * n_sats * point_size, SEEK_SET);
+        raw = reshape(fread(fid, 8 * n_sats * count, "double"), 8, n_sats, count);
+        p = permute(raw(:, cols, :), [3 2 1]);
+    end
+    fclose(fid);
+end
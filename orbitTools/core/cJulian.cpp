@@ -249,11 +249,14 @@ time_t cJulian::ToTime() const
        */
       time_t now = time(NULL);
 
-      struct tm *gm = gmtime(&now);
-      time_t gmt = mktime(gm);
-
-      struct tm *loc = localtime(&now);
-      time_t local = mktime(loc);
+      // Reentrant versions: ToTime() is called from several propagation threads at once.
+      struct tm gm;
+      gmtime_r(&now, &gm);
+      time_t gmt = mktime(&gm);
+
+      struct tm loc;
+      localtime_r(&now, &loc);
+      time_t local = mktime(&loc);
 
       secDelta = difftime(gmt, local);
       /** END OF MODIFICATION ***********************************************************************/
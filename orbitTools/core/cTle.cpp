@@ -47,11 +47,34 @@ cTle::cTle(string& strName, string& strLine1, string& strLine2)
    m_strLine0  = strName;
    m_strLine1 = strLine1;
    m_strLine2 = strLine2;
+   m_NativeMask = 0;
 
    TrimRight(m_strLine0);
    Initialize();
 }
 
+/** MODIFICATION BY: C. Araguz ********************************************************************
+ *    Constructor for pre-decoded element sets (see cTle.h).
+ */
+cTle::cTle(const char *pName, size_t nameLen, const char *pLine1, const char *pLine2,
+           const double *pNative, unsigned int nativeMask)
+   : m_strLine0(pName, nameLen),
+     m_strLine1(pLine1, TLE_LEN_LINE_DATA),
+     m_strLine2(pLine2, TLE_LEN_LINE_DATA),
+     m_NativeMask(nativeMask)
+{
+   TrimRight(m_strLine0);
+
+   for (int fld = FLD_FIRST; fld < FLD_LAST; fld++)
+   {
+      if (m_NativeMask & (1u << fld))
+      {
+         m_Native[fld] = pNative[fld];
+      }
+   }
+}
+/**************************************************************************************************/
+
 /////////////////////////////////////////////////////////////////////////////
 cTle::cTle(const cTle &tle)
 {
@@ -61,10 +84,11 @@ cTle::cTle(const cTle &tle)
 
    for (int fld = FLD_FIRST; fld < FLD_LAST; fld++)
    {
-      m_Field[fld] = tle.m_Field[fld];
+      m_Field[fld]  = tle.m_Field[fld];
+      m_Native[fld] = tle.m_Native[fld];
    }
 
-   m_mapCache = tle.m_mapCache;
+   m_NativeMask = tle.m_NativeMask;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -91,6 +115,7 @@ double cTle::GetField(eField   fld,
    if (pstr)
    {
       // Return requested field in string form.
+      Initialize();
       *pstr = m_Field[fld];
 
       if (bStrUnits)
@@ -106,23 +131,15 @@ double cTle::GetField(eField   fld,
    else
    {
       // Return requested field in floating-point form.
-      // Return cache contents if it exists, else populate cache
-      FldKey key = Key(units, fld);
-
-      if (m_mapCache.find(key) == m_mapCache.end())
+      // Populate the cache if the value is not there yet.
+      if (!(m_NativeMask & (1u << fld)))
       {
-         // Value not in cache; add it
-         double valNative = atof(m_Field[fld].c_str());
-         double valConv   = ConvertUnits(valNative, fld, units);
-         m_mapCache[key]  = valConv;
-
-         return valConv;
-      }
-      else
-      {
-         // return cached value
-         return m_mapCache[key];
+         Initialize();
+         m_Native[fld] = atof(m_Field[fld].c_str());
+         m_NativeMask |= (1u << fld);
       }
+
+      return ConvertUnits(m_Native[fld], fld, units);
    }
 }
 
@@ -207,7 +224,7 @@ string cTle::ExpToAtof(const string &str)
 /////////////////////////////////////////////////////////////////////////////
 // Initialize()
 // Initialize the string array.
-void cTle::Initialize()
+void cTle::Initialize() const
 {
    // Have we already been initialized?
    if (m_Field[FLD_NORADNUM].size()) { return; }
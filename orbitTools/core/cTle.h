@@ -23,6 +23,17 @@ class cTle
 public:
    cTle(string&, string&, string&);
    cTle(const cTle &tle);
+
+   /** MODIFICATION BY: C. Araguz ******************************************************************
+    *   Builds the element set from lines whose numeric fields have already been decoded (e.g. by
+    *   TLEParser). Data lines must be TLE_LEN_LINE_DATA characters long; they need not be null-
+    *   terminated. pNative holds the field values in native units, indexed by eField, and bit
+    *   (1 << fld) of nativeMask tells whether each one is valid. Fields not in the mask, and text
+    *   fields, are extracted from the lines when they are first requested.
+    */
+   cTle(const char *pName, size_t nameLen, const char *pLine1, const char *pLine2,
+        const double *pNative, unsigned int nativeMask);
+   /***********************************************************************************************/
    ~cTle();
 
    enum eTleLine
@@ -87,7 +98,7 @@ public:
    string Line2() const { return m_strLine2; }
 
 protected:
-   void Initialize();
+   void Initialize() const;
 
    static string ExpToAtof(const string&);
    static double ConvertUnits(double val, eField fld, eUnits units);
@@ -104,13 +115,14 @@ private:
    string m_strLine1;
    string m_strLine2;
 
-   // Converted fields, in atof()-readable form
-   string m_Field[FLD_LAST];
+   // Converted fields, in atof()-readable form (filled on demand)
+   mutable string m_Field[FLD_LAST];
 
-   // Cache of field values in "double" format
-   typedef int FldKey;
-   FldKey Key(eUnits u, eField f) const { return (u * 100) + f; }
-   mutable map<FldKey, double>  m_mapCache;
+   // Cache of field values in native units; bit (1 << fld) of m_NativeMask
+   // tells whether m_Native[fld] is valid. Unit conversions are applied on
+   // every request (they are a single multiplication at most).
+   mutable double       m_Native[FLD_LAST];
+   mutable unsigned int m_NativeMask;
 };
 }
 }
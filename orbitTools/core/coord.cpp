@@ -31,6 +31,13 @@ cGeo::cGeo(const cEci& eci, cJulian date)
              fmod((AcTan(eci.Position().m_y, eci.Position().m_x) - date.ToGmst()), TWOPI));
 }
 
+/** MODIFICATION BY: C. Araguz *********************************************************************/
+cGeo::cGeo(const cVector &posEci, double gmst)
+{
+   Construct(posEci, fmod((AcTan(posEci.m_y, posEci.m_x) - gmst), TWOPI));
+}
+/**************************************************************************************************/
+
 void cGeo::Construct(const cVector &posEcf, double theta)
 {
    theta = fmod(theta, TWOPI);
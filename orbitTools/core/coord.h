@@ -25,6 +25,12 @@ class cGeo
 public:
    cGeo(const cEci& eci, cJulian date);
    cGeo(double latRad, double lonRad, double altKm);
+   /** MODIFICATION BY: C. Araguz ******************************************************************
+    *   Same as cGeo(eci, date), with the Greenwich Mean Sidereal Time of the date (radians, see
+    *   cJulian::ToGmst) already computed, so that it can be shared by many positions.
+    */
+   cGeo(const cVector &posEci, double gmst);
+   /**************************************************************************************************/
 
    virtual ~cGeo() {}
 
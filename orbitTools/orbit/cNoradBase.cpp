@@ -26,6 +26,7 @@
 #include "cVector.h"
 #include "cJulian.h"
 #include "exceptions.h"
+#include "cSgp4Batch.h"
 
 namespace Zeptomoby 
 {
@@ -34,7 +35,8 @@ namespace OrbitTools
 
 //////////////////////////////////////////////////////////////////////////////
 cNoradBase::cNoradBase(const cOrbit &orbit) :
-   m_Orbit(orbit)
+   m_Orbit(orbit),
+   m_pTable(NULL)
 {
    // Initialize any variables which are time-independent when
    // calculating the ECI coordinates of the satellite.
@@ -127,6 +129,33 @@ cNoradBase::cNoradBase(const cOrbit &orbit) :
               2.0 * temp3 * (3.0 - 7.0 * theta2)) * m_cosio;
    m_xnodcf = 3.5 * m_betao2 * xhdot1 * m_c1;
    m_t2cof  = 1.5 * m_c1;
+
+   // Flat record (derived classes add the terms of their model)
+   memset(&m_Rec, 0, sizeof(m_Rec));
+
+   m_Rec.m_NoradId            = atoi(m_Orbit.SatId().c_str());
+   m_Rec.m_jdEpoch            = m_Orbit.Epoch().Date();
+   m_Rec.m_Inclination        = m_Orbit.Inclination();
+   m_Rec.m_Eccentricity       = m_Orbit.Eccentricity();
+   m_Rec.m_RAAN               = m_Orbit.RAAN();
+   m_Rec.m_ArgPerigee         = m_Orbit.ArgPerigee();
+   m_Rec.m_BStar              = m_Orbit.BStar();
+   m_Rec.m_Drag               = m_Orbit.Drag();
+   m_Rec.m_TleMeanMotion      = m_Orbit.MeanMotionTle();
+   m_Rec.m_MeanAnomaly        = m_Orbit.MeanAnomaly();
+   m_Rec.m_aeAxisSemiMajorRec = m_Orbit.SemiMajor();
+   m_Rec.m_aeAxisSemiMinorRec = m_Orbit.SemiMinor();
+   m_Rec.m_rmMeanMotionRec    = m_Orbit.MeanMotion();
+   m_Rec.m_kmPerigeeRec       = m_Orbit.Perigee();
+   m_Rec.m_kmApogeeRec        = m_Orbit.Apogee();
+
+   m_Rec.m_cosio  = m_cosio;   m_Rec.m_sinio  = m_sinio;
+   m_Rec.m_betao2 = m_betao2;  m_Rec.m_betao  = m_betao;   m_Rec.m_s4    = m_s4;
+   m_Rec.m_qoms24 = m_qoms24;  m_Rec.m_tsi    = m_tsi;     m_Rec.m_eta   = m_eta;
+   m_Rec.m_eeta   = m_eeta;    m_Rec.m_coef   = m_coef;    m_Rec.m_coef1 = m_coef1;
+   m_Rec.m_c1     = m_c1;      m_Rec.m_c3     = m_c3;      m_Rec.m_c4    = m_c4;
+   m_Rec.m_a3ovk2 = m_a3ovk2;  m_Rec.m_xmdot  = m_xmdot;   m_Rec.m_omgdot = m_omgdot;
+   m_Rec.m_xnodot = m_xnodot;  m_Rec.m_xnodcf = m_xnodcf;  m_Rec.m_t2cof = m_t2cof;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -136,18 +165,32 @@ cNoradBase& cNoradBase::operator=(const cNoradBase &b)
    // "const-ness" in order to complete the assigment.
    *(const_cast<cOrbit*>(&m_Orbit)) = b.m_Orbit;
 
+   m_Rec = b.m_Rec;
+
    return *this;
 }
 
 //////////////////////////////////////////////////////////////////////////////
-cEciTime cNoradBase::FinalPosition(double incl, double  omega, 
-                                   double    e, double      a,
-                                   double   xl, double  xnode, 
-                                   double   xn, double tsince)
+// GetPositions()
+// Propagates the record of the model (see PropagateRecord()).
+int cNoradBase::GetPositions(const double *ptsince, int count,
+                             double *x,  double *y,  double *z,
+                             double *vx, double *vy, double *vz,
+                             int *pStatus)
+{
+   return PropagateRecord(m_Rec, ptsince, count, x, y, z, vx, vy, vz, pStatus, m_pTable);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int cNoradBase::FinalPosition(const cOrbitRecord &rec,
+                              double incl, double  omega, 
+                              double    e, double      a,
+                              double   xl, double  xnode, 
+                              double   xn, double *pos, double *vel)
 {
    if ((e * e) > 1.0)
    {
-      throw cPropagationException("Error in satellite data");
+      return cSgp4Batch::STATUS_ECCENTRICITY;
    }
 
    double beta = sqrt(1.0 - e * e);
@@ -156,10 +199,10 @@ cEciTime cNoradBase::FinalPosition(double incl, double  omega,
    double axn  = e * cos(omega);
    double temp = 1.0 / (a * beta * beta);
 
-   double sinip = sin(m_Orbit.Inclination());
-   double cosip = cos(m_Orbit.Inclination());
-   double aycof = 0.25 * m_a3ovk2 * sinip;
-   double xlcof = (0.125 * m_a3ovk2 * sinip * (3.0 + 5.0 * cosip)) / 
+   double sinip = sin(rec.m_Inclination);
+   double cosip = cos(rec.m_Inclination);
+   double aycof = 0.25 * rec.m_a3ovk2 * sinip;
+   double xlcof = (0.125 * rec.m_a3ovk2 * sinip * (3.0 + 5.0 * cosip)) / 
                   (1.0 + cosip);
    double xll  = temp * xlcof * axn;
    double aynl = temp * aycof;
@@ -233,8 +276,8 @@ cEciTime cNoradBase::FinalPosition(double incl, double  omega,
    double rk = r * (1.0 - 1.5 * temp2 * betal * x3thm1) + 
                0.5 * temp1 * x1mth2 * cos2u;
    double uk = u - 0.25 * temp2 * x7thm1 * sin2u;
-   double xnodek = xnode + 1.5 * temp2 * m_cosio * sin2u;
-   double xinck  = incl + 1.5 * temp2 * m_cosio * m_sinio * cos2u;
+   double xnodek = xnode + 1.5 * temp2 * rec.m_cosio * sin2u;
+   double xinck  = incl + 1.5 * temp2 * rec.m_cosio * rec.m_sinio * cos2u;
    double rdotk  = rdot - xn * temp1 * x1mth2 * sin2u;
    double rfdotk = rfdot + xn * temp1 * (x1mth2 * cos2u + 1.5 * x3thm1);
 
@@ -265,24 +308,58 @@ cEciTime cNoradBase::FinalPosition(double incl, double  omega,
    double altKm = (vecPos.Magnitude() * (XKMPER_WGS72 / AE));
 
    if (altKm < XKMPER_WGS72)
+   {
+      return cSgp4Batch::STATUS_DECAYED;
+   }
+   
+   pos[0] = x;
+   pos[1] = y;
+   pos[2] = z;
+
+   // Velocity
+   vel[0] = rdotk * ux + rfdotk * vx;
+   vel[1] = rdotk * uy + rfdotk * vy;
+   vel[2] = rdotk * uz + rfdotk * vz;
+
+   return cSgp4Batch::STATUS_OK;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+cEciTime cNoradBase::FinalPosition(double incl, double  omega, 
+                                   double    e, double      a,
+                                   double   xl, double  xnode, 
+                                   double   xn, double tsince) const
+{
+   double pos[3];
+   double vel[3];
+
+   int status = FinalPosition(m_Rec, incl, omega, e, a, xl, xnode, xn, pos, vel);
+
+   return EciTime(status, pos, vel, tsince);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+cEciTime cNoradBase::EciTime(int status, const double *pos, const double *vel,
+                             double tsince) const
+{
+   if (status == cSgp4Batch::STATUS_ECCENTRICITY)
+   {
+      throw cPropagationException("Error in satellite data");
+   }
+
+   if (status == cSgp4Batch::STATUS_DECAYED)
    {
       cJulian decayTime = m_Orbit.Epoch();
 
       decayTime.AddMin(tsince);
       throw cDecayException(decayTime, m_Orbit.SatName(true));
    }
-   
-   // Velocity
-   double xdot = rdotk * ux + rfdotk * vx;
-   double ydot = rdotk * uy + rfdotk * vy;
-   double zdot = rdotk * uz + rfdotk * vz;
-
-   cVector vecVel(xdot, ydot, zdot);
 
    cJulian gmt = m_Orbit.Epoch();
    gmt.AddMin(tsince);
 
-   cEciTime eci = cEciTime(vecPos, vecVel, gmt);
+   cEciTime eci = cEciTime(cVector(pos[0], pos[1], pos[2]), 
+                           cVector(vel[0], vel[1], vel[2]), gmt);
 
    return eci;
 }
@@ -9,6 +9,8 @@
 //
 #pragma once
 
+#include "cOrbitRecord.h"
+
 //////////////////////////////////////////////////////////////////////////////
 
 namespace Zeptomoby 
@@ -30,15 +32,42 @@ public:
 
    virtual cEciTime GetPosition(double tsince) = 0;
 
+   // Propagate to count instants (minutes past epoch). Positions (km) and
+   // velocities (km/sec) are written in flat arrays of count elements, and
+   // the status of each point (see cSgp4Batch::eStatus) in pStatus, if
+   // given. Returns the number of points that could not be propagated.
+   // Not virtual: the kernel is selected from the record (PropagateRecord()).
+   int GetPositions(const double *ptsince, int count,
+                    double *x,  double *y,  double *z,
+                    double *vx, double *vy, double *vz,
+                    int *pStatus);
+
    virtual cNoradBase* Clone(const cOrbit&) = 0;
 
+   // Flat record of the orbit and of all the constants of the model.
+   const cOrbitRecord& Record() const { return m_Rec; }
+
+   // Last stage of both models, on a record. Writes the position (AE) and
+   // velocity (AE/min) in pos[3] and vel[3] and returns the status (see
+   // cSgp4Batch::eStatus).
+   static int FinalPosition(const cOrbitRecord &rec,
+                            double incl, double omega, double  e, double    a, 
+                            double   xl, double xnode, double xn,
+                            double *pos, double *vel);
+
 protected:
    cNoradBase& operator=(const cNoradBase&);
 
    cEciTime FinalPosition(double incl, double omega, double  e, double    a, 
-                          double   xl, double xnode, double xn, double tsince);
+                          double   xl, double xnode, double xn, double tsince) const;
+
+   // Builds the result of FinalPosition(), or throws the exception that
+   // corresponds to the status.
+   cEciTime EciTime(int status, const double *pos, const double *vel, double tsince) const;
 
-   const cOrbit &m_Orbit;
+   const cOrbit    &m_Orbit;
+   cOrbitRecord     m_Rec;
+   cResonanceTable *m_pTable;   // SDP4 checkpoint table, if any
 
    // Orbital parameter variables which need only be calculated one
    // time for a given orbit (ECI position time-independent).
@@ -11,6 +11,8 @@
 #include "cEci.h"
 #include "cNoradSDP4.h"
 #include "cOrbit.h"
+#include "cSgp4Batch.h"
+#include "exceptions.h"
 
 namespace Zeptomoby 
 {
@@ -22,6 +24,9 @@ static const double zns  = 1.19459e-05;
 static const double znl  = 1.5835218e-04;   
 static const double thdt = 4.3752691e-03;
 
+// Integration steps between resonance integrator checkpoints
+static const int CHECKPOINT_STEPS = 8;
+
 //////////////////////////////////////////////////////////////////////////////
 cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
    cNoradBase(orbit)
@@ -31,9 +36,10 @@ cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
    double eqsq   = sqr(m_Orbit.Eccentricity());
    
    // Deep space initialization 
-   cJulian jd = m_Orbit.Epoch();
+   sDeepTerms &dp = m_Rec.m_Deep;
+   cJulian     jd = m_Orbit.Epoch();
 
-   dp_thgr = jd.ToGmst();
+   dp.thgr = jd.ToGmst();
 
    double eq     = m_Orbit.Eccentricity();
    double aqnv   = 1.0 / m_Orbit.SemiMajor();
@@ -54,7 +60,7 @@ cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
    double dpi_c      = 4.7199672 + 0.22997150 * day;
    double dpi_gam    = 5.8351514 + 0.0019443680 * day;
    
-   dp_zmol = Fmod2p(dpi_c - dpi_gam);
+   dp.zmol = Fmod2p(dpi_c - dpi_gam);
 
    double dpi_zx = 0.39785416 * dpi_stem / dpi_zsinil;
    double dpi_zy = dpi_zcoshl * dpi_ctem + 0.91744867 * dpi_zsinhl * dpi_stem;
@@ -64,8 +70,8 @@ cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
    double dpi_zcosgl = cos(dpi_zx);
    double dpi_zsingl = sin(dpi_zx);
 
-   dp_zmos   = 6.2565837 + 0.017201977 * day;
-   dp_zmos   = Fmod2p(dp_zmos);
+   dp.zmos   = 6.2565837 + 0.017201977 * day;
+   dp.zmos   = Fmod2p(dp.zmos);
    
    const double zcosis = 0.91744867;
    const double zsinis = 0.39785416;     
@@ -147,39 +153,39 @@ cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
          sh = 0.0;
       }
 
-      dp_ee2 =  2.0 * s1 * s6;
-      dp_e3  =  2.0 * s1 * s7;
-      dp_xi2 =  2.0 * s2 * z12;
-      dp_xi3 =  2.0 * s2 * (z13 - z11);
-      dp_xl2 = -2.0 * s3 * z2;
-      dp_xl3 = -2.0 * s3 * (z3 - z1);
-      dp_xl4 = -2.0 * s3 * (-21.0 - 9.0 * eqsq) * ze;
-      dp_xgh2 = 2.0 * s4 * z32;
-      dp_xgh3 = 2.0 * s4 * (z33 - z31);
-      dp_xgh4 = -18.0 * s4 * ze;
-      dp_xh2 = -2.0 * s2 * z22;
-      dp_xh3 = -2.0 * s2 * (z23 - z21);
+      dp.ee2 =  2.0 * s1 * s6;
+      dp.e3  =  2.0 * s1 * s7;
+      dp.xi2 =  2.0 * s2 * z12;
+      dp.xi3 =  2.0 * s2 * (z13 - z11);
+      dp.xl2 = -2.0 * s3 * z2;
+      dp.xl3 = -2.0 * s3 * (z3 - z1);
+      dp.xl4 = -2.0 * s3 * (-21.0 - 9.0 * eqsq) * ze;
+      dp.xgh2 = 2.0 * s4 * z32;
+      dp.xgh3 = 2.0 * s4 * (z33 - z31);
+      dp.xgh4 = -18.0 * s4 * ze;
+      dp.xh2 = -2.0 * s2 * z22;
+      dp.xh3 = -2.0 * s2 * (z23 - z21);
 
       if (pass == 1)
       {
          // Do lunar terms 
-         dp_sse = se;
-         dp_ssi = si;
-         dp_ssl = sl;
-         dp_ssh = sh / m_sinio;
-         dp_ssg = sgh - m_cosio * dp_ssh;
-         dp_se2 = dp_ee2;
-         dp_si2 = dp_xi2;
-         dp_sl2 = dp_xl2;
-         dp_sgh2 = dp_xgh2;
-         dp_sh2 = dp_xh2;
-         dp_se3 = dp_e3;
-         dp_si3 = dp_xi3;
-         dp_sl3 = dp_xl3;
-         dp_sgh3 = dp_xgh3;
-         dp_sh3 = dp_xh3;
-         dp_sl4 = dp_xl4;
-         dp_sgh4 = dp_xgh4;
+         dp.sse = se;
+         dp.ssi = si;
+         dp.ssl = sl;
+         dp.ssh = sh / m_sinio;
+         dp.ssg = sgh - m_cosio * dp.ssh;
+         dp.se2 = dp.ee2;
+         dp.si2 = dp.xi2;
+         dp.sl2 = dp.xl2;
+         dp.sgh2 = dp.xgh2;
+         dp.sh2 = dp.xh2;
+         dp.se3 = dp.e3;
+         dp.si3 = dp.xi3;
+         dp.sl3 = dp.xl3;
+         dp.sgh3 = dp.xgh3;
+         dp.sh3 = dp.xh3;
+         dp.sl4 = dp.xl4;
+         dp.sgh4 = dp.xgh4;
          zcosg = dpi_zcosgl;
          zsing = dpi_zsingl;
          zcosi = dpi_zcosil;
@@ -195,15 +201,15 @@ cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
       }
    }
 
-   dp_sse = dp_sse + se;
-   dp_ssi = dp_ssi + si;
-   dp_ssl = dp_ssl + sl;
-   dp_ssg = dp_ssg + sgh - m_cosio / m_sinio * sh;
-   dp_ssh = dp_ssh + sh / m_sinio;
+   dp.sse = dp.sse + se;
+   dp.ssi = dp.ssi + si;
+   dp.ssl = dp.ssl + sl;
+   dp.ssg = dp.ssg + sgh - m_cosio / m_sinio * sh;
+   dp.ssh = dp.ssh + sh / m_sinio;
 
    // Geopotential resonance initialization
-   gp_reso = false;
-   gp_sync = false;
+   dp.reso = false;
+   dp.sync = false;
 
    double g310;
    double f220;
@@ -215,8 +221,8 @@ cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
    {
       // Orbit is within the Clarke Belt (period is 24-hour resonant).
       // Synchronous resonance terms initialization
-      gp_reso = true;
-      gp_sync = true;
+      dp.reso = true;
+      dp.sync = true;
 
       double g200 = 1.0 + eqsq * (-2.5 + 0.8125 * eqsq);
 
@@ -234,18 +240,18 @@ cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
       const double q33 = 2.2123015e-07;   
 
       f330 = 1.875 * f330 * f330 * f330;
-      dp_del1 = 3.0 * m_Orbit.MeanMotion() * m_Orbit.MeanMotion() * aqnv * aqnv;
-      dp_del2 = 2.0 * dp_del1 * f220 * g200 * q22;
-      dp_del3 = 3.0 * dp_del1 * f330 * g300 * q33 * aqnv;
-      dp_del1 = dp_del1 * f311 * g310 * q31 * aqnv;
-      dp_xlamo = xmao + m_Orbit.RAAN() + m_Orbit.ArgPerigee() - dp_thgr;
+      dp.del1 = 3.0 * m_Orbit.MeanMotion() * m_Orbit.MeanMotion() * aqnv * aqnv;
+      dp.del2 = 2.0 * dp.del1 * f220 * g200 * q22;
+      dp.del3 = 3.0 * dp.del1 * f330 * g300 * q33 * aqnv;
+      dp.del1 = dp.del1 * f311 * g310 * q31 * aqnv;
+      dp.xlamo = xmao + m_Orbit.RAAN() + m_Orbit.ArgPerigee() - dp.thgr;
       bfact = m_xmdot + xpidot - thdt;
-      bfact = bfact + dp_ssl + dp_ssg + dp_ssh;
+      bfact = bfact + dp.ssl + dp.ssg + dp.ssh;
    }
    else if (((m_Orbit.MeanMotion() >= 8.26E-03) && (m_Orbit.MeanMotion() <= 9.24E-03)) && (eq >= 0.5))
    {
       // Period is 12-hour resonant
-      gp_reso = true;
+      dp.reso = true;
 
       double eoc  = eq * eqsq;
       double g201 = -0.306 - (eq - 0.64) * 0.440;
@@ -325,50 +331,50 @@ cNoradSDP4::cNoradSDP4(const cOrbit &orbit) :
       double temp1 = 3.0 * xno2 * ainv2;
       double temp  = temp1 * root22;
 
-      dp_d2201 = temp * f220 * g201;
-      dp_d2211 = temp * f221 * g211;
+      dp.d2201 = temp * f220 * g201;
+      dp.d2211 = temp * f221 * g211;
       temp1 = temp1 * aqnv;
       temp = temp1 * root32;
-      dp_d3210 = temp * f321 * g310;
-      dp_d3222 = temp * f322 * g322;
+      dp.d3210 = temp * f321 * g310;
+      dp.d3222 = temp * f322 * g322;
       temp1 = temp1 * aqnv;
       temp = 2.0 * temp1 * root44;
-      dp_d4410 = temp * f441 * g410;
-      dp_d4422 = temp * f442 * g422;
+      dp.d4410 = temp * f441 * g410;
+      dp.d4422 = temp * f442 * g422;
       temp1 = temp1 * aqnv;
       temp  = temp1 * root52;
-      dp_d5220 = temp * f522 * g520;
-      dp_d5232 = temp * f523 * g532;
+      dp.d5220 = temp * f522 * g520;
+      dp.d5232 = temp * f523 * g532;
       temp = 2.0 * temp1 * root54;
-      dp_d5421 = temp * f542 * g521;
-      dp_d5433 = temp * f543 * g533;
-      dp_xlamo = xmao + m_Orbit.RAAN() + m_Orbit.RAAN() - dp_thgr - dp_thgr;
+      dp.d5421 = temp * f542 * g521;
+      dp.d5433 = temp * f543 * g533;
+      dp.xlamo = xmao + m_Orbit.RAAN() + m_Orbit.RAAN() - dp.thgr - dp.thgr;
       bfact = m_xmdot + m_xnodot + m_xnodot - thdt - thdt;
-      bfact = bfact + dp_ssl + dp_ssh + dp_ssh;
+      bfact = bfact + dp.ssl + dp.ssh + dp.ssh;
    }
 
-   if (gp_reso || gp_sync)
+   if (dp.reso || dp.sync)
    {
-      dp_xfact = bfact - m_Orbit.MeanMotion();
+      dp.xfact = bfact - m_Orbit.MeanMotion();
 
       // Initialize integrator 
-      dp_xli   = dp_xlamo;
-      dp_xni   = m_Orbit.MeanMotion();
-      dp_atime = 0.0;
-      dp_stepp = 720.0;
-      dp_stepn = -720.0;
-      dp_step2 = 259200.0;
+      dp.stepp = 720.0;
+      dp.stepn = -720.0;
+      dp.step2 = 259200.0;
    }
    else
    {
-      dp_xfact = 0.0;
-      dp_xli   = 0.0;
-      dp_xni   = 0.0;
-      dp_atime = 0.0;
-      dp_stepp = 0.0;
-      dp_stepn = 0.0;
-      dp_step2 = 0.0;
+      dp.xfact = 0.0;
+      dp.stepp = 0.0;
+      dp.stepn = 0.0;
+      dp.step2 = 0.0;
    }
+
+   m_pTable = &m_Table;
+
+   m_Rec.m_Model  = cOrbitRecord::MODEL_SDP4;
+   m_Rec.m_Kernel = dp.sync ? cOrbitRecord::KERNEL_SDP4_SYNC :
+                    dp.reso ? cOrbitRecord::KERNEL_SDP4_12H  : cOrbitRecord::KERNEL_SDP4;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -378,21 +384,30 @@ cNoradSDP4::~cNoradSDP4()
 
 
 //////////////////////////////////////////////////////////////////////////////
-bool cNoradSDP4::DeepCalcDotTerms(double *pxndot, double *pxnddt, double *pxldot)
+template <int kKernel>
+bool cNoradSDP4::DeepCalcDotTerms(const cOrbitRecord &rec,
+                                  double *pxndot, double *pxnddt, double *pxldot,
+                                  const cResonanceState &state)
 {
+   const sDeepTerms &dp = rec.m_Deep;
+
+   const double xli   = state.m_xli;
+   const double xni   = state.m_xni;
+   const double atime = state.m_atime;
+
    const double fasx2 = 0.13130908;
    const double fasx4 = 2.8843198;
    const double fasx6 = 0.37448087;
 
    // Dot terms calculated 
-   if (gp_sync)
+   if (kKernel == cOrbitRecord::KERNEL_SDP4_SYNC)
    {
-      *pxndot = dp_del1 * sin(dp_xli - fasx2) + 
-                dp_del2 * sin(2.0 * (dp_xli - fasx4)) +
-                dp_del3 * sin(3.0 * (dp_xli - fasx6));
-      *pxnddt = dp_del1 * cos(dp_xli - fasx2) +
-                2.0 * dp_del2 * cos(2.0 * (dp_xli - fasx4)) +
-                3.0 * dp_del3 * cos(3.0 * (dp_xli - fasx6));
+      *pxndot = dp.del1 * sin(xli - fasx2) + 
+                dp.del2 * sin(2.0 * (xli - fasx4)) +
+                dp.del3 * sin(3.0 * (xli - fasx6));
+      *pxnddt = dp.del1 * cos(xli - fasx2) +
+                2.0 * dp.del2 * cos(2.0 * (xli - fasx4)) +
+                3.0 * dp.del3 * cos(3.0 * (xli - fasx6));
    }
    else
    {
@@ -402,61 +417,136 @@ bool cNoradSDP4::DeepCalcDotTerms(double *pxndot, double *pxnddt, double *pxldot
       const double g52 = 1.0508330;      
       const double g54 = 4.4108898;
 
-      double xomi  = m_Orbit.ArgPerigee() + m_omgdot * dp_atime;
+      double xomi  = rec.m_ArgPerigee + rec.m_omgdot * atime;
       double x2omi = xomi + xomi;
-      double x2li  = dp_xli + dp_xli;
-
-      *pxndot = dp_d2201 * sin(x2omi + dp_xli - g22) + 
-                dp_d2211 * sin(dp_xli - g22)         +
-                dp_d3210 * sin( xomi + dp_xli - g32) +
-                dp_d3222 * sin(-xomi + dp_xli - g32) +
-                dp_d4410 * sin(x2omi + x2li - g44)   +
-                dp_d4422 * sin(x2li - g44)           +
-                dp_d5220 * sin( xomi + dp_xli - g52) +
-                dp_d5232 * sin(-xomi + dp_xli - g52) +
-                dp_d5421 * sin( xomi + x2li - g54)   +
-                dp_d5433 * sin(-xomi + x2li - g54);
-
-      *pxnddt = dp_d2201 * cos(x2omi + dp_xli - g22) +
-                dp_d2211 * cos(dp_xli - g22)         +
-                dp_d3210 * cos( xomi + dp_xli - g32) +
-                dp_d3222 * cos(-xomi + dp_xli - g32) +
-                dp_d5220 * cos( xomi + dp_xli - g52) +
-                dp_d5232 * cos(-xomi + dp_xli - g52) +
-                2.0 * (dp_d4410 * cos(x2omi + x2li - g44) +
-                dp_d4422 * cos(x2li - g44)         +
-                dp_d5421 * cos( xomi + x2li - g54) +
-                dp_d5433 * cos(-xomi + x2li - g54));
+      double x2li  = xli + xli;
+
+      *pxndot = dp.d2201 * sin(x2omi + xli - g22) + 
+                dp.d2211 * sin(xli - g22)         +
+                dp.d3210 * sin( xomi + xli - g32) +
+                dp.d3222 * sin(-xomi + xli - g32) +
+                dp.d4410 * sin(x2omi + x2li - g44)   +
+                dp.d4422 * sin(x2li - g44)           +
+                dp.d5220 * sin( xomi + xli - g52) +
+                dp.d5232 * sin(-xomi + xli - g52) +
+                dp.d5421 * sin( xomi + x2li - g54)   +
+                dp.d5433 * sin(-xomi + x2li - g54);
+
+      *pxnddt = dp.d2201 * cos(x2omi + xli - g22) +
+                dp.d2211 * cos(xli - g22)         +
+                dp.d3210 * cos( xomi + xli - g32) +
+                dp.d3222 * cos(-xomi + xli - g32) +
+                dp.d5220 * cos( xomi + xli - g52) +
+                dp.d5232 * cos(-xomi + xli - g52) +
+                2.0 * (dp.d4410 * cos(x2omi + x2li - g44) +
+                dp.d4422 * cos(x2li - g44)         +
+                dp.d5421 * cos( xomi + x2li - g54) +
+                dp.d5433 * cos(-xomi + x2li - g54));
    }
 
-   *pxldot = dp_xni + dp_xfact;
+   *pxldot = xni + dp.xfact;
    *pxnddt = (*pxnddt) * (*pxldot);
 
    return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////
-void cNoradSDP4::DeepCalcIntegrator(double *pxndot, double *pxnddt, 
-                                    double *pxldot, double delt)
+template <int kKernel>
+void cNoradSDP4::DeepCalcIntegrator(const cOrbitRecord &rec,
+                                    double *pxndot, double *pxnddt, 
+                                    double *pxldot, double delt,
+                                    cResonanceState &state)
+{
+   const sDeepTerms &dp = rec.m_Deep;
+
+   DeepCalcDotTerms<kKernel>(rec, pxndot, pxnddt, pxldot, state);
+
+   state.m_xli = state.m_xli + (*pxldot) * delt + (*pxndot) * dp.step2;
+   state.m_xni = state.m_xni + (*pxndot) * delt + (*pxnddt) * dp.step2;
+   state.m_atime = state.m_atime + delt;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// DeepCheckpoint()
+// Sets the integrator state to the checkpoint closest to tsince (towards
+// epoch), extending the checkpoint table if needed. The state obtained is
+// the same one that integrating from epoch would give, so results do not
+// depend on the order of the queries. Without a table, the state is reset
+// to the epoch.
+template <int kKernel>
+void cNoradSDP4::DeepCheckpoint(const cOrbitRecord &rec, double tsince,
+                                cResonanceState &state, cResonanceTable *pTable)
 {
-   DeepCalcDotTerms(pxndot, pxnddt, pxldot);
+   const sDeepTerms &dp = rec.m_Deep;
+
+   // Epoch restart 
+   cResonanceState epoch;
+
+   epoch.m_atime = 0.0;
+   epoch.m_xni   = rec.m_rmMeanMotionRec;
+   epoch.m_xli   = dp.xlamo;
+
+   if (pTable == NULL)
+   {
+      state = epoch;
+      return;
+   }
+
+   double delt  = (tsince < 0.0) ? dp.stepn : dp.stepp;
+   double xndot = 0.0;
+   double xnddt = 0.0;
+   double xldot = 0.0;
+
+   std::lock_guard<std::mutex> lock(pTable->m_Lock);
 
-   dp_xli = dp_xli + (*pxldot) * delt + (*pxndot) * dp_step2;
-   dp_xni = dp_xni + (*pxndot) * delt + (*pxnddt) * dp_step2;
-   dp_atime = dp_atime + delt;
+   std::vector<cResonanceState> &table = (tsince < 0.0) ? pTable->m_Backward 
+                                                         : pTable->m_Forward;
+
+   if (table.empty())
+   {
+      table.push_back(epoch);
+   }
+
+   // Last checkpoint that the integration towards tsince goes through
+   int idx = (int)(fabs(tsince) / (CHECKPOINT_STEPS * dp.stepp));
+
+   while ((idx > 0) &&
+          (fabs(tsince - delt * (idx * CHECKPOINT_STEPS - 1)) < dp.stepp))
+   {
+      idx--;
+   }
+
+   while ((int)table.size() <= idx)
+   {
+      cResonanceState cp = table.back();
+
+      for (int i = 0; i < CHECKPOINT_STEPS; i++)
+      {
+         DeepCalcIntegrator<kKernel>(rec, &xndot, &xnddt, &xldot, delt, cp);
+      }
+
+      table.push_back(cp);
+   }
+
+   state = table[idx];
 }
 
 //////////////////////////////////////////////////////////////////////////////
-bool cNoradSDP4::DeepSecular(double *xmdf, double *omgadf, double *xnode,
+template <int kKernel>
+bool cNoradSDP4::DeepSecular(const cOrbitRecord &rec,
+                             double *xmdf, double *omgadf, double *xnode,
                              double *emm,  double *xincc,  double *xnn,
-                             double tsince)
+                             double tsince, cResonanceState &state,
+                             cResonanceTable *pTable)
 {
+   const sDeepTerms &dp = rec.m_Deep;
+
    // Deep space secular effects 
-   *xmdf   = (*xmdf)   + dp_ssl * tsince;
-   *omgadf = (*omgadf) + dp_ssg * tsince;
-   *xnode  = (*xnode)  + dp_ssh * tsince;
-   *emm    = m_Orbit.Eccentricity() + dp_sse * tsince;
-   *xincc  = m_Orbit.Inclination()  + dp_ssi * tsince;
+   *xmdf   = (*xmdf)   + dp.ssl * tsince;
+   *omgadf = (*omgadf) + dp.ssg * tsince;
+   *xnode  = (*xnode)  + dp.ssh * tsince;
+   *emm    = rec.m_Eccentricity + dp.sse * tsince;
+   *xincc  = rec.m_Inclination  + dp.ssi * tsince;
 
    if ((*xincc) < 0.0)
    {
@@ -471,69 +561,40 @@ bool cNoradSDP4::DeepSecular(double *xmdf, double *omgadf, double *xnode,
    double ft    = 0.0;
    double delt  = 0.0;
 
-   bool fDone = false;
-
-   if (gp_reso) 
+   if (kKernel != cOrbitRecord::KERNEL_SDP4)   // Resonant
    {
-      while (!fDone)
+      delt = (tsince < 0) ? dp.stepn : dp.stepp;
+
+      // Integration always proceeds away from epoch. Restart from the
+      // closest checkpoint when the state is at epoch, on the other side of
+      // it, past tsince, or more than CHECKPOINT_STEPS steps behind.
+      if ((state.m_atime == 0.0)                     ||
+         ((tsince >= 0.0) && (state.m_atime <  0.0)) ||
+         ((tsince <  0.0) && (state.m_atime >= 0.0)) ||
+         (fabs(tsince) < fabs(state.m_atime))        ||
+         ((pTable != NULL) &&
+          (fabs(tsince - state.m_atime) >= CHECKPOINT_STEPS * dp.stepp)))
       {
-         if ((dp_atime == 0.0)                     ||
-            ((tsince >= 0.0) && (dp_atime <  0.0)) ||
-            ((tsince <  0.0) && (dp_atime >= 0.0)))
-         {
-            delt = (tsince < 0) ? dp_stepn : dp_stepp;
-
-            // Epoch restart 
-            dp_atime = 0.0;
-            dp_xni = m_Orbit.MeanMotion();
-            dp_xli = dp_xlamo;
-
-            fDone = true;
-         }
-         else
-         {
-            if (fabs(tsince) < fabs(dp_atime))
-            {
-               delt = dp_stepp;
-
-               if (tsince >= 0.0)
-               {
-                  delt = dp_stepn;
-               }
-
-               DeepCalcIntegrator(&xndot, &xnddt, &xldot, delt);
-            }
-            else
-            {
-               delt = dp_stepn;
-
-               if (tsince > 0.0)
-               {
-                  delt = dp_stepp;
-               }
-
-               fDone = true;
-            }
-         }
+         DeepCheckpoint<kKernel>(rec, tsince, state, pTable);
       }
 
-      while (fabs(tsince - dp_atime) >= dp_stepp)
+      while (fabs(tsince - state.m_atime) >= dp.stepp)
       {
-         DeepCalcIntegrator(&xndot, &xnddt, &xldot, delt);
+         DeepCalcIntegrator<kKernel>(rec, &xndot, &xnddt, &xldot, delt, state);
       }
 
-      ft = tsince - dp_atime;
+      ft = tsince - state.m_atime;
 
-      DeepCalcDotTerms(&xndot, &xnddt, &xldot);
+      DeepCalcDotTerms<kKernel>(rec, &xndot, &xnddt, &xldot, state);
 
-      *xnn = dp_xni + xndot * ft + xnddt * ft * ft * 0.5;
+      *xnn = state.m_xni + xndot * ft + xnddt * ft * ft * 0.5;
 
-      double xl   = dp_xli + xldot * ft + xndot * ft * ft * 0.5;
-      double temp = -(*xnode) + dp_thgr + tsince * thdt;
+      double xl   = state.m_xli + xldot * ft + xndot * ft * ft * 0.5;
+      double temp = -(*xnode) + dp.thgr + tsince * thdt;
 
       *xmdf = xl - (*omgadf) + temp;
 
-      if (!gp_sync)
+      if (kKernel != cOrbitRecord::KERNEL_SDP4_SYNC)
       {
          *xmdf = xl + temp + temp;
       }
@@ -543,10 +604,13 @@ bool cNoradSDP4::DeepSecular(double *xmdf, double *omgadf, double *xnode,
 }
 
 //////////////////////////////////////////////////////////////////////////////
-bool cNoradSDP4::DeepPeriodics(double *e,      double *xincc,
+bool cNoradSDP4::DeepPeriodics(const cOrbitRecord &rec,
+                               double *e,      double *xincc,
                                double *omgadf, double *xnode,
                                double *xmam,   double tsince)
 {
+   const sDeepTerms &dp = rec.m_Deep;
+
    // Lunar-solar periodics 
    double sinis = sin(*xincc);
    double cosis = cos(*xincc);
@@ -565,29 +629,29 @@ bool cNoradSDP4::DeepPeriodics(double *e,      double *xincc,
    // Here the terms are calculated for all propagation times.
    
    // Apply lunar-solar terms
-   double zm = dp_zmos + zns * tsince;
+   double zm = dp.zmos + zns * tsince;
    double zf = zm + 2.0 * zes * sin(zm);
    double sinzf = sin(zf);
    double f2  = 0.5 * sinzf * sinzf - 0.25;
    double f3  = -0.5 * sinzf * cos(zf);
-   double ses = dp_se2 * f2 + dp_se3 * f3;
-   double sis = dp_si2 * f2 + dp_si3 * f3;
-   double sls = dp_sl2 * f2 + dp_sl3 * f3 + dp_sl4 * sinzf;
+   double ses = dp.se2 * f2 + dp.se3 * f3;
+   double sis = dp.si2 * f2 + dp.si3 * f3;
+   double sls = dp.sl2 * f2 + dp.sl3 * f3 + dp.sl4 * sinzf;
 
-   sghs = dp_sgh2 * f2 + dp_sgh3 * f3 + dp_sgh4 * sinzf;
-   shs  = dp_sh2  * f2 + dp_sh3  * f3;
-   zm = dp_zmol + znl * tsince;
+   sghs = dp.sgh2 * f2 + dp.sgh3 * f3 + dp.sgh4 * sinzf;
+   shs  = dp.sh2  * f2 + dp.sh3  * f3;
+   zm = dp.zmol + znl * tsince;
    zf = zm + 2.0 * zel * sin(zm);
    sinzf = sin(zf);
    f2 = 0.5 * sinzf * sinzf - 0.25;
    f3 = -0.5 * sinzf * cos(zf);
 
-   double sel  = dp_ee2 * f2 + dp_e3  * f3;
-   double sil  = dp_xi2 * f2 + dp_xi3 * f3;
-   double sll  = dp_xl2 * f2 + dp_xl3 * f3 + dp_xl4 * sinzf;
+   double sel  = dp.ee2 * f2 + dp.e3  * f3;
+   double sil  = dp.xi2 * f2 + dp.xi3 * f3;
+   double sll  = dp.xl2 * f2 + dp.xl3 * f3 + dp.xl4 * sinzf;
 
-   sghl = dp_xgh2 * f2 + dp_xgh3 * f3 + dp_xgh4 * sinzf;
-   sh1  = dp_xh2  * f2 + dp_xh3  * f3;
+   sghl = dp.xgh2 * f2 + dp.xgh3 * f3 + dp.xgh4 * sinzf;
+   sh1  = dp.xh2  * f2 + dp.xh3  * f3;
    pe   = ses + sel;
    pinc = sis + sil;
    pl   = sls + sll;
@@ -598,11 +662,11 @@ bool cNoradSDP4::DeepPeriodics(double *e,      double *xincc,
    *xincc = (*xincc) + pinc;
    *e  = (*e) + pe;
 
-   if (m_Orbit.Inclination() >= 0.2)
+   if (rec.m_Inclination >= 0.2)
    {
       // Apply periodics directly 
-      ph  = ph / m_sinio;
-      pgh = pgh - m_cosio * ph;
+      ph  = ph / rec.m_sinio;
+      pgh = pgh - rec.m_cosio * ph;
       *omgadf = (*omgadf) + pgh;
       *xnode  = (*xnode) + ph;
       *xmam   = (*xmam) + pl;
@@ -640,33 +704,130 @@ bool cNoradSDP4::DeepPeriodics(double *e,      double *xincc,
 //
 // tsince - Time in minutes since the TLE epoch (GMT).
 cEciTime cNoradSDP4::GetPosition(double tsince)
+{
+   return GetPosition(tsince, m_State);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+cEciTime cNoradSDP4::GetPosition(double tsince, cResonanceState &state) const
+{
+   double pos[3];
+   double vel[3];
+
+   int status = Propagate(m_Rec, tsince, state, &m_Table, pos, vel);
+
+   return EciTime(status, pos, vel, tsince);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Propagate()
+// SDP4 model on a record. Writes the position (AE) and velocity (AE/min) in
+// pos[3] and vel[3] and returns the status (see cSgp4Batch::eStatus).
+int cNoradSDP4::Propagate(const cOrbitRecord &rec, double tsince,
+                          cResonanceState &state, cResonanceTable *pTable,
+                          double *pos, double *vel)
+{
+   switch (rec.m_Kernel)
+   {
+      case cOrbitRecord::KERNEL_SDP4_SYNC:
+         return PropagatePoint<cOrbitRecord::KERNEL_SDP4_SYNC>(rec, tsince, state, pTable, pos, vel);
+
+      case cOrbitRecord::KERNEL_SDP4_12H:
+         return PropagatePoint<cOrbitRecord::KERNEL_SDP4_12H>(rec, tsince, state, pTable, pos, vel);
+
+      default:
+         return PropagatePoint<cOrbitRecord::KERNEL_SDP4>(rec, tsince, state, pTable, pos, vel);
+   }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <int kKernel>
+int cNoradSDP4::PropagatePoint(const cOrbitRecord &rec, double tsince,
+                               cResonanceState &state, cResonanceTable *pTable,
+                               double *pos, double *vel)
 {
    // Update for secular gravity and atmospheric drag 
-   double xmdf   = m_Orbit.MeanAnomaly() + m_xmdot  * tsince;
-   double omgadf = m_Orbit.ArgPerigee()  + m_omgdot * tsince;
-   double xnoddf = m_Orbit.RAAN() + m_xnodot * tsince;
+   double xmdf   = rec.m_MeanAnomaly + rec.m_xmdot  * tsince;
+   double omgadf = rec.m_ArgPerigee  + rec.m_omgdot * tsince;
+   double xnoddf = rec.m_RAAN + rec.m_xnodot * tsince;
    double tsq    = tsince * tsince;
-   double xnode  = xnoddf + m_xnodcf * tsq;
-   double tempa  = 1.0 - m_c1 * tsince;
-   double tempe  = m_Orbit.BStar() * m_c4 * tsince;
-   double templ  = m_t2cof * tsq;
-   double xn     = m_Orbit.MeanMotion();
+   double xnode  = xnoddf + rec.m_xnodcf * tsq;
+   double tempa  = 1.0 - rec.m_c1 * tsince;
+   double tempe  = rec.m_BStar * rec.m_c4 * tsince;
+   double templ  = rec.m_t2cof * tsq;
+   double xn     = rec.m_rmMeanMotionRec;
    double em;
    double xinc;
 
-   DeepSecular(&xmdf, &omgadf, &xnode, &em, &xinc, &xn, tsince);
+   DeepSecular<kKernel>(rec, &xmdf, &omgadf, &xnode, &em, &xinc, &xn, tsince, state, pTable);
 
    double a    = pow(XKE / xn, 2.0 / 3.0) * sqr(tempa);
    double e    = em - tempe;
-   double xmam = xmdf + m_Orbit.MeanMotion() * templ;
+   double xmam = xmdf + rec.m_rmMeanMotionRec * templ;
 
-   DeepPeriodics(&e, &xinc, &omgadf, &xnode, &xmam, tsince);
+   DeepPeriodics(rec, &e, &xinc, &omgadf, &xnode, &xmam, tsince);
 
    double xl = xmam + omgadf + xnode;
 
    xn = XKE / pow(a, 1.5);
 
-   return FinalPosition(xinc, omgadf, e, a, xl, xnode, xn, tsince);
+   return FinalPosition(rec, xinc, omgadf, e, a, xl, xnode, xn, pos, vel);
 }
+
+//////////////////////////////////////////////////////////////////////////////
+// PropagateTimes()
+// Propagates a record of the kKernel kind to count instants. Positions are
+// written in km and velocities in km/sec; points that could not be
+// propagated are set to zero.
+template <int kKernel>
+int cNoradSDP4::PropagateTimes(const cOrbitRecord &rec, const double *ptsince, int count,
+                               double *x,  double *y,  double *z,
+                               double *vx, double *vy, double *vz,
+                               int *pStatus, cResonanceTable *pTable)
+{
+   const double radiusAe = XKMPER_WGS72 / AE;
+   const double velScale = radiusAe * (MIN_PER_DAY / 86400);
+
+   cResonanceState state;
+   int failed = 0;
+
+   for (int i = 0; i < count; i++)
+   {
+      double pos[3];
+      double vel[3];
+
+      int status = PropagatePoint<kKernel>(rec, ptsince[i], state, pTable, pos, vel);
+
+      if (status == cSgp4Batch::STATUS_OK)
+      {
+         x[i]  = pos[0] * radiusAe;
+         y[i]  = pos[1] * radiusAe;
+         z[i]  = pos[2] * radiusAe;
+         vx[i] = vel[0] * velScale;
+         vy[i] = vel[1] * velScale;
+         vz[i] = vel[2] * velScale;
+      }
+      else
+      {
+         x[i] = y[i] = z[i] = vx[i] = vy[i] = vz[i] = 0.0;
+         failed++;
+      }
+
+      if (pStatus != NULL)
+      {
+         pStatus[i] = status;
+      }
+   }
+
+   return failed;
+}
+
+// Kernels dispatched by PropagateRecord()
+template int cNoradSDP4::PropagateTimes<cOrbitRecord::KERNEL_SDP4>(const cOrbitRecord&, const double*, int,
+   double*, double*, double*, double*, double*, double*, int*, cResonanceTable*);
+template int cNoradSDP4::PropagateTimes<cOrbitRecord::KERNEL_SDP4_SYNC>(const cOrbitRecord&, const double*, int,
+   double*, double*, double*, double*, double*, double*, int*, cResonanceTable*);
+template int cNoradSDP4::PropagateTimes<cOrbitRecord::KERNEL_SDP4_12H>(const cOrbitRecord&, const double*, int,
+   double*, double*, double*, double*, double*, double*, int*, cResonanceTable*);
 }
 }
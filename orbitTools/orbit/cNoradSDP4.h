@@ -10,6 +10,9 @@
 //
 #pragma once
 
+#include <vector>
+#include <mutex>
+
 #include "cNoradBase.h"
 
 namespace Zeptomoby
@@ -19,6 +22,43 @@ namespace OrbitTools
 
 class cOrbit;
 
+//////////////////////////////////////////////////////////////////////////////
+// State of the resonance integrator of an SDP4 model (12-hour and
+// geosynchronous orbits). It is owned by the caller, so that one model can
+// be used by several threads at once, each one with its own state.
+class cResonanceState
+{
+public:
+   cResonanceState() : m_atime(0.0), m_xli(0.0), m_xni(0.0) { }
+
+private:
+   friend class cNoradSDP4;
+
+   double m_atime;   // Integration time (minutes past epoch)
+   double m_xli;
+   double m_xni;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Integrator states of a resonant SDP4 orbit at every CHECKPOINT_STEPS steps
+// from epoch, forward (positive times) and backward. Built on demand; one
+// table can be shared by several threads.
+class cResonanceTable
+{
+public:
+   cResonanceTable() { }
+
+private:
+   cResonanceTable(const cResonanceTable&);
+   cResonanceTable& operator=(const cResonanceTable&);
+
+   friend class cNoradSDP4;
+
+   std::vector<cResonanceState> m_Forward;
+   std::vector<cResonanceState> m_Backward;
+   std::mutex                   m_Lock;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 class cNoradSDP4 : public cNoradBase
 {
@@ -26,36 +66,62 @@ public:
    cNoradSDP4(const cOrbit &orbit);
    virtual ~cNoradSDP4();
 
+   // Uses the model's own integrator state (not thread-safe).
    virtual cEciTime GetPosition(double tsince);
 
+   // Uses the given integrator state; the model is not modified.
+   cEciTime GetPosition(double tsince, cResonanceState &state) const;
+
    virtual cNoradBase* Clone(const cOrbit& orbit) { return new cNoradSDP4(orbit); }
 
+   // SDP4 model on a record (see cOrbitRecord). Writes the position (AE)
+   // and velocity (AE/min) in pos[3] and vel[3] and returns the status (see
+   // cSgp4Batch::eStatus). pTable may be NULL.
+   static int Propagate(const cOrbitRecord &rec, double tsince,
+                        cResonanceState &state, cResonanceTable *pTable,
+                        double *pos, double *vel);
+
+   // Same as above, to count instants, for a record of the kKernel kind
+   // (see cOrbitRecord::eKernel). Units and return value as in
+   // cNoradBase::GetPositions(). Instantiated for the three SDP4 kernels.
+   template <int kKernel>
+   static int PropagateTimes(const cOrbitRecord &rec, const double *ptsince, int count,
+                             double *x,  double *y,  double *z,
+                             double *vx, double *vy, double *vz,
+                             int *pStatus, cResonanceTable *pTable);
+
 protected:
-   bool DeepSecular(double *xmdf,  double *omgadf,double *xnode, double *emm, 
-                    double *xincc, double *xnn,   double tsince);
-   bool DeepCalcDotTerms  (double *pxndot, double *pxnddt, double *pxldot);
-   void DeepCalcIntegrator(double *pxndot, double *pxnddt, double *pxldot, double delt);
-   bool DeepPeriodics(double *e,     double *xincc,  double *omgadf, 
-                      double *xnode, double *xmam,   double tsince);
-   
-   double dp_e3;     double dp_ee2;    double dp_se2;    double dp_se3;
-   double dp_sgh2;   double dp_sgh3;   double dp_sgh4;   double dp_sh2;
-   double dp_sh3;    double dp_si2;    double dp_si3;    double dp_sl2;
-   double dp_sl3;    double dp_sl4;    double dp_xgh2;   double dp_xgh3;
-   double dp_xgh4;   double dp_xh2;    double dp_xh3;    double dp_xi2;
-   double dp_xi3;    double dp_xl2;    double dp_xl3;    double dp_xl4;
-   double dp_zmol;   double dp_zmos;
-
-   double dp_atime;  double dp_d2201;  double dp_d2211;  double dp_d3210;
-   double dp_d3222;  double dp_d4410;  double dp_d4422;  double dp_d5220;
-   double dp_d5232;  double dp_d5421;  double dp_d5433;  double dp_del1;
-   double dp_del2;   double dp_del3;   double dp_sse;    double dp_ssg;
-   double dp_ssh;    double dp_ssi;    double dp_ssl;    double dp_step2;
-   double dp_stepn;  double dp_stepp;  double dp_thgr;   double dp_xfact;
-   double dp_xlamo;  double dp_xli;    double dp_xni;
-
-   bool gp_reso;
-   bool gp_sync;
+   // The deep-space terms below are specialized on the kernel of the
+   // record, so that no resonance test is made per point.
+   template <int kKernel>
+   static int  PropagatePoint(const cOrbitRecord &rec, double tsince,
+                              cResonanceState &state, cResonanceTable *pTable,
+                              double *pos, double *vel);
+   template <int kKernel>
+   static bool DeepSecular(const cOrbitRecord &rec,
+                           double *xmdf,  double *omgadf,double *xnode, double *emm, 
+                           double *xincc, double *xnn,   double tsince,
+                           cResonanceState &state, cResonanceTable *pTable);
+   template <int kKernel>
+   static bool DeepCalcDotTerms  (const cOrbitRecord &rec,
+                                  double *pxndot, double *pxnddt, double *pxldot,
+                                  const cResonanceState &state);
+   template <int kKernel>
+   static void DeepCalcIntegrator(const cOrbitRecord &rec,
+                                  double *pxndot, double *pxnddt, double *pxldot, 
+                                  double delt, cResonanceState &state);
+   static bool DeepPeriodics(const cOrbitRecord &rec,
+                             double *e,     double *xincc,  double *omgadf, 
+                             double *xnode, double *xmam,   double tsince);
+
+   template <int kKernel>
+   static void DeepCheckpoint(const cOrbitRecord &rec, double tsince,
+                              cResonanceState &state, cResonanceTable *pTable);
+
+   // The deep-space constants are kept in m_Rec.m_Deep (see sDeepTerms).
+
+   cResonanceState         m_State;   // Used by GetPosition(double)
+   mutable cResonanceTable m_Table;
 };
 }
 }
@@ -28,6 +28,18 @@ cNoradSGP4::cNoradSGP4(const cOrbit &orbit) :
    m_xmcof  = -(2.0 / 3.0) * m_coef * m_Orbit.BStar() * AE / m_eeta;
    m_delmo  = pow(1.0 + m_eta * cos(m_Orbit.MeanAnomaly()), 3.0);
    m_sinmo  = sin(m_Orbit.MeanAnomaly());
+
+   // For perigee less than 220 kilometers, the isimp flag is set and
+   // the equations are truncated to linear variation in sqrt a and
+   // quadratic variation in mean anomaly.  Also, the m_c3 term, the
+   // delta omega term, and the delta m term are dropped.
+   bool isimp = (m_Orbit.SemiMajor() * (1.0 - m_Orbit.Eccentricity()) / AE) < 
+                (220.0 / XKMPER_WGS72 + AE);
+
+   m_Rec.m_Model  = cOrbitRecord::MODEL_SGP4;
+   m_Rec.m_Kernel = isimp ? cOrbitRecord::KERNEL_SGP4_SIMPLE : cOrbitRecord::KERNEL_SGP4_FULL;
+
+   cSgp4Batch::InitTerms(*this, m_Rec.m_Sgp4);
 }
 
 cNoradSGP4::~cNoradSGP4(void)
@@ -44,41 +56,19 @@ cNoradSGP4::~cNoradSGP4(void)
 // tsince - Time in minutes since the TLE epoch (GMT).
 cEciTime cNoradSGP4::GetPosition(double tsince)
 {
-   // For m_perigee less than 220 kilometers, the isimp flag is set and
-   // the equations are truncated to linear variation in sqrt a and
-   // quadratic variation in mean anomaly.  Also, the m_c3 term, the
-   // delta omega term, and the delta m term are dropped.
-   bool isimp = false;
+   // The isimp test and d2..t5cof are evaluated once, at construction
+   // (see cSgp4Batch::InitTerms()).
+   const double *term = m_Rec.m_Sgp4;
 
-   if ((m_Orbit.SemiMajor() * (1.0 - m_Orbit.Eccentricity()) / AE) < (220.0 / XKMPER_WGS72 + AE))
-   {
-      isimp = true;
-   }
-
-   double d2 = 0.0;
-   double d3 = 0.0;
-   double d4 = 0.0;
+   bool isimp = (m_Rec.m_Kernel == cOrbitRecord::KERNEL_SGP4_SIMPLE);
 
-   double t3cof = 0.0;
-   double t4cof = 0.0;
-   double t5cof = 0.0;
+   double d2 = term[cSgp4Batch::T_D2];
+   double d3 = term[cSgp4Batch::T_D3];
+   double d4 = term[cSgp4Batch::T_D4];
 
-   if (!isimp)
-   {
-      double c1sq = m_c1 * m_c1;
-
-      d2 = 4.0 * m_Orbit.SemiMajor() * m_tsi * c1sq;
-
-      double temp = d2 * m_tsi * m_c1 / 3.0;
-
-      d3 = (17.0 * m_Orbit.SemiMajor() + m_s4) * temp;
-      d4 = 0.5 * temp * m_Orbit.SemiMajor() * m_tsi * 
-           (221.0 * m_Orbit.SemiMajor() + 31.0 * m_s4) * m_c1;
-      t3cof = d2 + 2.0 * c1sq;
-      t4cof = 0.25 * (3.0 * d3 + m_c1 * (12.0 * d2 + 10.0 * c1sq));
-      t5cof = 0.2 * (3.0 * d4 + 12.0 * m_c1 * d3 + 6.0 * 
-                     d2 * d2 + 15.0 * c1sq * (2.0 * d2 + c1sq));
-   }
+   double t3cof = term[cSgp4Batch::T_T3COF];
+   double t4cof = term[cSgp4Batch::T_T4COF];
+   double t5cof = term[cSgp4Batch::T_T5COF];
 
    // Update for secular gravity and atmospheric drag. 
    double xmdf   = m_Orbit.MeanAnomaly() + m_xmdot * tsince;
@@ -30,6 +30,8 @@ public:
    virtual cNoradBase* Clone(const cOrbit& orbit) { return new cNoradSGP4(orbit); }
 
 protected:
+   friend class cSgp4Batch;   // Copies the time-invariant terms
+
    double m_c5; 
    double m_omgcof;
    double m_xmcof;
@@ -209,6 +209,17 @@ cEciTime cOrbit::PositionEci(double mpe) const
    return eci;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Vector-of-times version of PositionEci(). Near-earth orbits are propagated
+// with the vectorized SGP4 kernel; nothing is allocated per point.
+int cOrbit::PositionEci(const double *mpe, int count,
+                        double *x,  double *y,  double *z,
+                        double *vx, double *vy, double *vz,
+                        int *pStatus /* = NULL */) const
+{
+   return m_pNoradModel->GetPositions(mpe, count, x, y, z, vx, vy, vz, pStatus);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // SatName()
 // Return the name of the satellite. If requested, the NORAD number is
@@ -38,6 +38,15 @@ public:
    // Return satellite ECI data at given minutes past epoch.
    cEciTime PositionEci(double mpe) const;
    cEciTime GetPosition(double mpe) const; // Deprecated, use PositionEci().
+
+   // Return satellite ECI data at count instants, given in minutes past
+   // epoch, in flat arrays: positions in km, velocities in km/sec. The
+   // number of points that could not be propagated is returned, and the
+   // status of every point (see cSgp4Batch::eStatus) set in pStatus.
+   int PositionEci(const double *mpe, int count,
+                   double *x,  double *y,  double *z,
+                   double *vx, double *vy, double *vz,
+                   int *pStatus = NULL) const;
    
    double Inclination()   const { return m_Inclination;   }
    double Eccentricity()  const { return m_Eccentricity;  }
@@ -68,6 +77,9 @@ public:
    double Apogee()     const { return m_kmApogeeRec;        }  // apogee in km
    double Period()     const;                                  // period in seconds
 
+   // Flat record of the elements and model constants (see cOrbitRecord)
+   const cOrbitRecord& Record() const { return m_pNoradModel->Record(); }
+
 protected:
    double RadGet(cTle::eField fld) const { return m_tle.GetField(fld, cTle::U_RAD); }
    double DegGet(cTle::eField fld) const { return m_tle.GetField(fld, cTle::U_DEG); }
@@ -0,0 +1,53 @@
+//
+// cOrbitRecord.cpp
+//
+// Propagation of flat orbit records (see cOrbitRecord.h).
+//
+#include "stdafx.h"
+
+#include <type_traits>
+
+#include "cOrbitRecord.h"
+#include "cNoradSDP4.h"
+#include "cSgp4Batch.h"
+
+namespace Zeptomoby 
+{
+namespace OrbitTools
+{
+
+static_assert(std::is_trivially_copyable<cOrbitRecord>::value,
+              "cOrbitRecord must be trivially copyable");
+
+//////////////////////////////////////////////////////////////////////////////
+// PropagateRecord()
+int PropagateRecord(const cOrbitRecord &rec, const double *ptsince, int count,
+                    double *x,  double *y,  double *z,
+                    double *vx, double *vy, double *vz,
+                    int *pStatus /* = NULL */, cResonanceTable *pTable /* = NULL */)
+{
+   switch (rec.m_Kernel)
+   {
+      case cOrbitRecord::KERNEL_SGP4_SIMPLE:
+         return cSgp4Batch::PropagateOrbit(rec.m_Sgp4, true, ptsince, count, 
+                                           x, y, z, vx, vy, vz, pStatus);
+
+      case cOrbitRecord::KERNEL_SGP4_FULL:
+         return cSgp4Batch::PropagateOrbit(rec.m_Sgp4, false, ptsince, count, 
+                                           x, y, z, vx, vy, vz, pStatus);
+
+      case cOrbitRecord::KERNEL_SDP4_SYNC:
+         return cNoradSDP4::PropagateTimes<cOrbitRecord::KERNEL_SDP4_SYNC>(
+                   rec, ptsince, count, x, y, z, vx, vy, vz, pStatus, pTable);
+
+      case cOrbitRecord::KERNEL_SDP4_12H:
+         return cNoradSDP4::PropagateTimes<cOrbitRecord::KERNEL_SDP4_12H>(
+                   rec, ptsince, count, x, y, z, vx, vy, vz, pStatus, pTable);
+
+      default:
+         return cNoradSDP4::PropagateTimes<cOrbitRecord::KERNEL_SDP4>(
+                   rec, ptsince, count, x, y, z, vx, vy, vz, pStatus, pTable);
+   }
+}
+}
+}
@@ -0,0 +1,113 @@
+//
+// cOrbitRecord.h
+//
+// Flat, trivially-copyable record of an orbit: the decoded TLE elements,
+// the elements recovered from them, and all the precomputed constants of
+// its SGP4 or SDP4 model. A record can be copied with memcpy(), stored in
+// contiguous arrays or mapped from disk, and propagated without the
+// cTle/cOrbit/cNoradBase objects it was built from (see PropagateRecord()).
+//
+#pragma once
+
+#include "cSgp4Batch.h"
+
+namespace Zeptomoby
+{
+namespace OrbitTools
+{
+
+class cResonanceTable;
+
+//////////////////////////////////////////////////////////////////////////////
+// Deep-space constants of the SDP4 model (see cNoradSDP4)
+struct sDeepTerms
+{
+   double e3;     double ee2;    double se2;    double se3;
+   double sgh2;   double sgh3;   double sgh4;   double sh2;
+   double sh3;    double si2;    double si3;    double sl2;
+   double sl3;    double sl4;    double xgh2;   double xgh3;
+   double xgh4;   double xh2;    double xh3;    double xi2;
+   double xi3;    double xl2;    double xl3;    double xl4;
+   double zmol;   double zmos;
+
+   double d2201;  double d2211;  double d3210;  double d3222;
+   double d4410;  double d4422;  double d5220;  double d5232;
+   double d5421;  double d5433;  double del1;   double del2;
+   double del3;   double sse;    double ssg;    double ssh;
+   double ssi;    double ssl;    double step2;  double stepn;
+   double stepp;  double thgr;   double xfact;  double xlamo;
+
+   int    reso;   // Resonant orbit (12-hour or synchronous)
+   int    sync;   // Synchronous orbit
+};
+
+//////////////////////////////////////////////////////////////////////////////
+struct cOrbitRecord
+{
+   enum eModel
+   {
+      MODEL_SGP4,   // Near-earth (period < 225 minutes)
+      MODEL_SDP4    // Deep space
+   };
+
+   // Propagation kernel, selected once when the record is built
+   enum eKernel
+   {
+      KERNEL_SGP4_SIMPLE,  // Perigee below 220 km (isimp): no drag terms
+      KERNEL_SGP4_FULL,
+      KERNEL_SDP4,         // Non-resonant
+      KERNEL_SDP4_SYNC,    // 24-hour (synchronous) resonance
+      KERNEL_SDP4_12H      // 12-hour resonance
+   };
+
+   int    m_Model;
+   int    m_Kernel;
+   int    m_NoradId;
+   double m_jdEpoch;
+
+   // TLE elements (see cOrbit)
+   double m_Inclination;
+   double m_Eccentricity;
+   double m_RAAN;
+   double m_ArgPerigee;
+   double m_BStar;
+   double m_Drag;
+   double m_TleMeanMotion;
+   double m_MeanAnomaly;
+
+   // Recovered from the TLE elements
+   double m_aeAxisSemiMajorRec;  // semimajor axis, in AE units
+   double m_aeAxisSemiMinorRec;  // semiminor axis, in AE units
+   double m_rmMeanMotionRec;     // radians per minute
+   double m_kmPerigeeRec;        // perigee, in km
+   double m_kmApogeeRec;         // apogee, in km
+
+   // Time-independent terms common to both models (see cNoradBase)
+   double m_cosio;   double m_sinio;
+   double m_betao2;  double m_betao;   double m_s4;
+   double m_qoms24;  double m_tsi;     double m_eta;
+   double m_eeta;    double m_coef;    double m_coef1;
+   double m_c1;      double m_c3;      double m_c4;
+   double m_a3ovk2;  double m_xmdot;   double m_omgdot;
+   double m_xnodot;  double m_xnodcf;  double m_t2cof;
+
+   // Model-specific terms
+   double     m_Sgp4[cSgp4Batch::T_COUNT];   // MODEL_SGP4
+   sDeepTerms m_Deep;                        // MODEL_SDP4
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// PropagateRecord()
+// Propagate the orbit of a record to count instants (ptsince[count],
+// minutes past epoch). Positions (km) and velocities (km/sec) are written
+// in flat arrays, and the status of every point (see cSgp4Batch::eStatus)
+// in pStatus, if given. Returns the number of points that could not be
+// propagated. Resonant deep-space orbits are integrated from epoch, unless
+// a checkpoint table is given (see cResonanceTable). The kernel of the
+// record is selected once per call, not per point.
+int PropagateRecord(const cOrbitRecord &rec, const double *ptsince, int count,
+                    double *x,  double *y,  double *z,
+                    double *vx, double *vy, double *vz,
+                    int *pStatus = NULL, cResonanceTable *pTable = NULL);
+}
+}
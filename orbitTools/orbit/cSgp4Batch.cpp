@@ -0,0 +1,679 @@
+//
+// cSgp4Batch.cpp
+//
+// Batched NORAD SGP4 implementation. The equations are the ones found in
+// cNoradSGP4::GetPosition() and cNoradBase::FinalPosition(), rewritten
+// without data-dependent branches so that the compiler can evaluate them
+// for several orbits at once. Orbits are processed in blocks of BLOCK
+// lanes; every stage of the model is a separate loop over the lanes of a
+// block.
+//
+// The kernel is compiled once per instruction set (AVX-512, AVX2 and the
+// baseline x86-64 one) and the best version is selected at load time.
+// Floating-point contraction is disabled for this file (see Makefile),
+// hence all the versions produce the same results.
+//
+#include "stdafx.h"
+
+#include "cSgp4Batch.h"
+#include "cOrbit.h"
+#include "cNoradSGP4.h"
+
+namespace Zeptomoby
+{
+namespace OrbitTools
+{
+
+namespace
+{
+
+// Number of orbits propagated together by the kernel
+const int BLOCK = 16;
+
+#if defined(__GNUC__) && !defined(__clang__)
+   #define SGP4_INLINE     inline __attribute__((always_inline))
+#else
+   #define SGP4_INLINE     inline
+#endif
+
+// AVX-512 and AVX2 clones of the kernels (x86 only, selected at load time)
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+   #define SGP4_MULTIARCH  __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+   #define SGP4_MULTIARCH
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// SinCos()
+// Branchless sine and cosine of the same angle (Cephes sin.c/cos.c). The
+// argument is reduced to [-PI/4, PI/4] with a three-part PI/4 constant,
+// which keeps the error below 1 ulp for the angles found in SGP4 (|x| up
+// to ~1e7 radians).
+SGP4_INLINE void SinCos(double x, double *pSin, double *pCos)
+{
+   const double DP1 = 7.85398125648498535156E-1;
+   const double DP2 = 3.77489470793079817668E-8;
+   const double DP3 = 2.69515142907905952645E-15;
+   const double FOPI = 1.27323954473516268615;   // 4 / PI
+
+   double ax = fabs(x);
+   double y  = floor(ax * FOPI);
+
+   // Map zeros to origin (odd octants are folded onto the next one)
+   y += y - 2.0 * floor(0.5 * y);
+
+   double q  = y - 8.0 * floor(0.125 * y);  // 0, 2, 4 or 6
+   double z  = ((ax - y * DP1) - y * DP2) - y * DP3;
+   double zz = z * z;
+
+   double ps = 1.58962301576546568060E-10;
+   ps = ps * zz - 2.50507477628578072866E-8;
+   ps = ps * zz + 2.75573136213857245213E-6;
+   ps = ps * zz - 1.98412698295895385996E-4;
+   ps = ps * zz + 8.33333333332211858878E-3;
+   ps = ps * zz - 1.66666666666666307295E-1;
+   ps = z + z * zz * ps;
+
+   double pc = -1.13585365213876817300E-11;
+   pc = pc * zz + 2.08757008419747316778E-9;
+   pc = pc * zz - 2.75573141792967388112E-7;
+   pc = pc * zz + 2.48015872888517045348E-5;
+   pc = pc * zz - 1.38888888888730564116E-3;
+   pc = pc * zz + 4.16666666666665929218E-2;
+   pc = 1.0 - 0.5 * zz + zz * zz * pc;
+
+   bool swap = (q == 2.0) || (q == 6.0);
+   double s  = swap ? pc : ps;
+   double c  = swap ? ps : pc;
+
+   s = (q >= 4.0) ? -s : s;
+   c = ((q == 2.0) || (q == 4.0)) ? -c : c;
+
+   *pSin = (x < 0.0) ? -s : s;
+   *pCos = c;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Branchless version of Fmod2p()
+SGP4_INLINE double Mod2p(double x)
+{
+   return x - TWOPI * floor(x * (1.0 / TWOPI));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Sgp4Block()
+// Propagates n (<= BLOCK) lanes. t[] points to the first lane of every
+// term array; tsince[], the outputs and pStatus[] are indexed by lane.
+// kStride is 1 for one orbit per lane, and 0 for a single orbit
+// propagated to a different time in every lane. kSimple drops the drag
+// terms of the isimp orbits (perigee below 220 km) altogether; otherwise
+// they are covered by zeroed terms.
+#define TERM(k) t[cSgp4Batch::k][kStride * i]
+
+template <int kStride, bool kSimple>
+SGP4_INLINE int Sgp4Block(const double *const *t, const double *tsince, int n,
+                          double *px,  double *py,  double *pz,
+                          double *pvx, double *pvy, double *pvz,
+                          int *pStatus)
+{
+   const double E6A = 1.0e-06;
+
+   // Values carried across stages
+   double xnode[BLOCK], a[BLOCK], xn[BLOCK];
+   double axn[BLOCK], ayn[BLOCK], capu[BLOCK];
+   double epw[BLOCK], sinepw[BLOCK], cosepw[BLOCK];
+   double temp3[BLOCK], temp4[BLOCK], temp5[BLOCK], temp6[BLOCK];
+   int    status[BLOCK];
+
+   // Update for secular gravity and atmospheric drag. With !kSimple, the
+   // isimp case is covered by zeroed omgcof, xmcof, c5, d2, d3, d4, t3cof,
+   // t4cof and t5cof.
+   #pragma omp simd
+   for (int i = 0; i < n; i++)
+   {
+      double ts     = tsince[i];
+      double xmdf   = TERM(T_M0) + TERM(T_XMDOT)  * ts;
+      double omgdf  = TERM(T_W0) + TERM(T_OMGDOT) * ts;
+      double xnoddf = TERM(T_O0) + TERM(T_XNODOT) * ts;
+      double tsq    = ts * ts;
+      double xnd    = xnoddf + TERM(T_XNODCF) * tsq;
+      double tempa  = 1.0 - TERM(T_C1) * ts;
+      double tempe  = TERM(T_BC4) * ts;
+      double templ  = TERM(T_T2COF) * tsq;
+      double xmp    = xmdf;
+      double omega  = omgdf;
+
+      if (!kSimple)
+      {
+         double sinm, cosm;
+         SinCos(xmdf, &sinm, &cosm);
+
+         double delomg = TERM(T_OMGCOF) * ts;
+         double dm     = 1.0 + TERM(T_ETA) * cosm;
+         double delm   = TERM(T_XMCOF) * (dm * dm * dm - TERM(T_DELMO));
+         double temp   = delomg + delm;
+         double tcube  = tsq * ts;
+         double tfour  = ts * tcube;
+
+         xmp   = xmdf  + temp;
+         omega = omgdf - temp;
+
+         double sinxmp, cosxmp;
+         SinCos(xmp, &sinxmp, &cosxmp);
+
+         tempa = tempa - TERM(T_D2) * tsq - TERM(T_D3) * tcube -
+                 TERM(T_D4) * tfour;
+         tempe = tempe + TERM(T_BC5) * (sinxmp - TERM(T_SINMO));
+         templ = templ + TERM(T_T3COF) * tcube +
+                 tfour * (TERM(T_T4COF) + ts * TERM(T_T5COF));
+      }
+
+      double aa = TERM(T_A0) * tempa * tempa;
+      double e  = TERM(T_E0) - tempe;
+      double xl = xmp + omega + xnd + TERM(T_N0) * templ;
+
+      xnode[i]  = xnd;
+      a[i]      = aa;
+      xn[i]     = XKE / (aa * sqrt(aa));
+
+      // Long period periodics (the scalar model passes omgadf here too)
+      status[i] = (e * e > 1.0) ? cSgp4Batch::STATUS_ECCENTRICITY : cSgp4Batch::STATUS_OK;
+
+      double beta2 = (e * e > 1.0) ? 1.0 : 1.0 - e * e;
+      double sinw, cosw;
+      SinCos(omgdf, &sinw, &cosw);
+
+      double tmp  = 1.0 / (aa * beta2);
+      double ax   = e * cosw;
+      double xll  = tmp * TERM(T_XLCOF) * ax;
+      double aynl = tmp * TERM(T_AYCOF);
+
+      axn[i]  = ax;
+      ayn[i]  = e * sinw + aynl;
+      capu[i] = Mod2p(xl + xll - xnd);
+      epw[i]  = capu[i];
+   }
+
+   // Solve Kepler's Equation. Converged lanes keep their angle, so that
+   // further iterations recompute the very same values for them.
+   bool done[BLOCK];
+
+   for (int i = 0; i < n; i++)
+   {
+      done[i] = false;
+   }
+
+   for (int iter = 1; iter <= 10; iter++)
+   {
+      int pending = 0;
+
+      #pragma omp simd reduction(+:pending)
+      for (int i = 0; i < n; i++)
+      {
+         double s, c;
+         SinCos(epw[i], &s, &c);
+
+         double t3 = axn[i] * s;
+         double t4 = ayn[i] * c;
+         double t5 = axn[i] * c;
+         double t6 = ayn[i] * s;
+         double next = (capu[i] - t4 + t3 - epw[i]) / (1.0 - t5 - t6) + epw[i];
+         bool   conv = done[i] || (fabs(next - epw[i]) <= E6A);
+
+         sinepw[i] = s;
+         cosepw[i] = c;
+         temp3[i]  = t3;
+         temp4[i]  = t4;
+         temp5[i]  = t5;
+         temp6[i]  = t6;
+         epw[i]    = conv ? epw[i] : next;
+         done[i]   = conv;
+         pending  += conv ? 0 : 1;
+      }
+
+      if (pending == 0)
+      {
+         break;
+      }
+   }
+
+   // Short period preliminary quantities, short periodics, orientation
+   // vectors, position and velocity.
+   int failed = 0;
+
+   #pragma omp simd reduction(+:failed)
+   for (int i = 0; i < n; i++)
+   {
+      double aa    = a[i];
+      double ecose = temp5[i] + temp6[i];
+      double esine = temp3[i] - temp4[i];
+      double elsq  = axn[i] * axn[i] + ayn[i] * ayn[i];
+      double temp  = 1.0 - elsq;
+      double pl    = aa * temp;
+      double r     = aa * (1.0 - ecose);
+      double temp1 = 1.0 / r;
+      double rdot  = XKE * sqrt(aa) * esine * temp1;
+      double rfdot = XKE * sqrt(fabs(pl)) * temp1;
+      double temp2 = aa * temp1;
+      double betal = sqrt(fabs(temp));
+      double tmp3  = 1.0 / (1.0 + betal);
+      double cosu  = temp2 * (cosepw[i] - axn[i] + ayn[i] * esine * tmp3);
+      double sinu  = temp2 * (sinepw[i] - ayn[i] - axn[i] * esine * tmp3);
+      double sin2u = 2.0 * sinu * cosu;
+      double cos2u = 2.0 * cosu * cosu - 1.0;
+
+      // Unit vector of the argument of latitude: u = atan2(sinu, cosu)
+      double ru    = 1.0 / sqrt(sinu * sinu + cosu * cosu);
+      double sinun = sinu * ru;
+      double cosun = cosu * ru;
+
+      temp  = 1.0 / pl;
+      temp1 = CK2 * temp;
+      temp2 = temp1 * temp;
+
+      // Update for short periodics
+      double cosio  = TERM(T_COSIO);
+      double x3thm1 = TERM(T_X3THM1);
+      double x1mth2 = TERM(T_X1MTH2);
+      double rk     = r * (1.0 - 1.5 * temp2 * betal * x3thm1) +
+                      0.5 * temp1 * x1mth2 * cos2u;
+      double duk    = -0.25 * temp2 * TERM(T_X7THM1) * sin2u;
+      double xnodek = xnode[i] + 1.5 * temp2 * cosio * sin2u;
+      double xinck  = TERM(T_I0) +
+                      1.5 * temp2 * cosio * TERM(T_SINIO) * cos2u;
+      double rdotk  = rdot - xn[i] * temp1 * x1mth2 * sin2u;
+      double rfdotk = rfdot + xn[i] * temp1 * (x1mth2 * cos2u + 1.5 * x3thm1);
+
+      // Orientation vectors (uk = u + duk)
+      double sindu, cosdu, sinik, cosik, sinnok, cosnok;
+      SinCos(duk,    &sindu,  &cosdu);
+      SinCos(xinck,  &sinik,  &cosik);
+      SinCos(xnodek, &sinnok, &cosnok);
+
+      double sinuk = sinun * cosdu + cosun * sindu;
+      double cosuk = cosun * cosdu - sinun * sindu;
+      double xmx = -sinnok * cosik;
+      double xmy = cosnok * cosik;
+      double ux  = xmx * sinuk + cosnok * cosuk;
+      double uy  = xmy * sinuk + sinnok * cosuk;
+      double uz  = sinik * sinuk;
+      double vx  = xmx * cosuk - cosnok * sinuk;
+      double vy  = xmy * cosuk - sinnok * sinuk;
+      double vz  = sinik * cosuk;
+
+      // Position
+      double x = rk * ux;
+      double y = rk * uy;
+      double z = rk * uz;
+
+      // Validate on altitude
+      double altKm = sqrt(x * x + y * y + z * z) * (XKMPER_WGS72 / AE);
+      int    st    = status[i];
+
+      st = (st == cSgp4Batch::STATUS_OK && altKm < XKMPER_WGS72) ?
+           cSgp4Batch::STATUS_DECAYED : st;
+
+      // Velocity
+      double xdot = rdotk * ux + rfdotk * vx;
+      double ydot = rdotk * uy + rfdotk * vy;
+      double zdot = rdotk * uz + rfdotk * vz;
+
+      // Convert from AE (AE/min) to kilometers (km/sec). Orbits that could
+      // not be propagated are set to zero.
+      const double radiusAe = XKMPER_WGS72 / AE;
+      const double velScale = radiusAe * (MIN_PER_DAY / 86400);
+      bool ok = (st == cSgp4Batch::STATUS_OK);
+
+      px[i]  = ok ? x    * radiusAe : 0.0;
+      py[i]  = ok ? y    * radiusAe : 0.0;
+      pz[i]  = ok ? z    * radiusAe : 0.0;
+      pvx[i] = ok ? xdot * velScale : 0.0;
+      pvy[i] = ok ? ydot * velScale : 0.0;
+      pvz[i] = ok ? zdot * velScale : 0.0;
+
+      status[i] = st;
+      failed   += ok ? 0 : 1;
+   }
+
+   if (pStatus != NULL)
+   {
+      for (int i = 0; i < n; i++)
+      {
+         pStatus[i] = status[i];
+      }
+   }
+
+   return failed;
+}
+
+#undef TERM
+
+//////////////////////////////////////////////////////////////////////////////
+// Sgp4Kernel()
+// Propagates count orbits, BLOCK at a time. When tsince is NULL, every
+// orbit is propagated to uniformTime.
+template <bool kSimple>
+SGP4_MULTIARCH
+int Sgp4Kernel(const double *const *term, int count,
+               const double *tsince, double uniformTime,
+               double *x,  double *y,  double *z,
+               double *vx, double *vy, double *vz,
+               int *pStatus)
+{
+   const double *t[cSgp4Batch::T_COUNT];
+   double ts[BLOCK];
+   int    failed = 0;
+
+   for (int i = 0; i < BLOCK; i++)
+   {
+      ts[i] = uniformTime;
+   }
+
+   for (int base = 0; base < count; base += BLOCK)
+   {
+      int n = (count - base < BLOCK) ? (count - base) : BLOCK;
+
+      for (int k = 0; k < cSgp4Batch::T_COUNT; k++)
+      {
+         t[k] = term[k] + base;
+      }
+
+      failed += Sgp4Block<1, kSimple>(t, (tsince != NULL) ? (tsince + base) : ts, n,
+                                      x + base,  y + base,  z + base,
+                                      vx + base, vy + base, vz + base,
+                                      (pStatus != NULL) ? (pStatus + base) : NULL);
+   }
+
+   return failed;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Sgp4KernelTimes()
+// Propagates one orbit to count instants, BLOCK at a time.
+template <bool kSimple>
+SGP4_MULTIARCH
+int Sgp4KernelTimes(const double *term, int count, const double *tsince,
+                    double *x,  double *y,  double *z,
+                    double *vx, double *vy, double *vz,
+                    int *pStatus)
+{
+   const double *t[cSgp4Batch::T_COUNT];
+   int failed = 0;
+
+   for (int k = 0; k < cSgp4Batch::T_COUNT; k++)
+   {
+      t[k] = term + k;
+   }
+
+   for (int base = 0; base < count; base += BLOCK)
+   {
+      int n = (count - base < BLOCK) ? (count - base) : BLOCK;
+
+      failed += Sgp4Block<0, kSimple>(t, tsince + base, n,
+                                      x + base,  y + base,  z + base,
+                                      vx + base, vy + base, vz + base,
+                                      (pStatus != NULL) ? (pStatus + base) : NULL);
+   }
+
+   return failed;
+}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+cSgp4Batch::cSgp4Batch() :
+   m_Count(0),
+   m_FullCount(0)
+{
+}
+
+cSgp4Batch::~cSgp4Batch()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void cSgp4Batch::Clear()
+{
+   for (int k = 0; k < T_COUNT; k++)
+   {
+      m_Term[k].clear();
+   }
+
+   m_Epoch.clear();
+   m_Full.clear();
+   m_Count     = 0;
+   m_FullCount = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// InitTerms()
+// Computes the time-invariant terms of an SGP4 model, including the ones
+// that cNoradSGP4::GetPosition() computes for every call (d2..t5cof).
+void cSgp4Batch::InitTerms(const cNoradSGP4 &model, double *term)
+{
+   const cOrbit &orbit = model.m_Orbit;
+
+   bool isimp = (orbit.SemiMajor() * (1.0 - orbit.Eccentricity()) / AE) <
+                (220.0 / XKMPER_WGS72 + AE);
+
+   term[T_M0]     = orbit.MeanAnomaly();
+   term[T_W0]     = orbit.ArgPerigee();
+   term[T_O0]     = orbit.RAAN();
+   term[T_E0]     = orbit.Eccentricity();
+   term[T_I0]     = orbit.Inclination();
+   term[T_A0]     = orbit.SemiMajor();
+   term[T_N0]     = orbit.MeanMotion();
+   term[T_XMDOT]  = model.m_xmdot;
+   term[T_OMGDOT] = model.m_omgdot;
+   term[T_XNODOT] = model.m_xnodot;
+   term[T_XNODCF] = model.m_xnodcf;
+   term[T_T2COF]  = model.m_t2cof;
+   term[T_C1]     = model.m_c1;
+   term[T_BC4]    = orbit.BStar() * model.m_c4;
+   term[T_ETA]    = model.m_eta;
+   term[T_DELMO]  = model.m_delmo;
+   term[T_SINMO]  = model.m_sinmo;
+
+   if (isimp)
+   {
+      term[T_BC5]    = 0.0;
+      term[T_OMGCOF] = 0.0;
+      term[T_XMCOF]  = 0.0;
+      term[T_D2]     = 0.0;
+      term[T_D3]     = 0.0;
+      term[T_D4]     = 0.0;
+      term[T_T3COF]  = 0.0;
+      term[T_T4COF]  = 0.0;
+      term[T_T5COF]  = 0.0;
+   }
+   else
+   {
+      double a    = orbit.SemiMajor();
+      double c1   = model.m_c1;
+      double c1sq = c1 * c1;
+      double d2   = 4.0 * a * model.m_tsi * c1sq;
+      double temp = d2 * model.m_tsi * c1 / 3.0;
+      double d3   = (17.0 * a + model.m_s4) * temp;
+      double d4   = 0.5 * temp * a * model.m_tsi * (221.0 * a + 31.0 * model.m_s4) * c1;
+
+      term[T_BC5]    = orbit.BStar() * model.m_c5;
+      term[T_OMGCOF] = model.m_omgcof;
+      term[T_XMCOF]  = model.m_xmcof;
+      term[T_D2]     = d2;
+      term[T_D3]     = d3;
+      term[T_D4]     = d4;
+      term[T_T3COF]  = d2 + 2.0 * c1sq;
+      term[T_T4COF]  = 0.25 * (3.0 * d3 + c1 * (12.0 * d2 + 10.0 * c1sq));
+      term[T_T5COF]  = 0.2 * (3.0 * d4 + 12.0 * c1 * d3 + 6.0 *
+                              d2 * d2 + 15.0 * c1sq * (2.0 * d2 + c1sq));
+   }
+
+   // Long period and short period constants (see FinalPosition())
+   double cosip  = model.m_cosio;
+   double cosip2 = cosip * cosip;
+
+   term[T_AYCOF]  = 0.25 * model.m_a3ovk2 * model.m_sinio;
+   term[T_XLCOF]  = (0.125 * model.m_a3ovk2 * model.m_sinio * (3.0 + 5.0 * cosip)) /
+                    (1.0 + cosip);
+   term[T_X3THM1] = 3.0 * cosip2 - 1.0;
+   term[T_X1MTH2] = 1.0 - cosip2;
+   term[T_X7THM1] = 7.0 * cosip2 - 1.0;
+   term[T_COSIO]  = model.m_cosio;
+   term[T_SINIO]  = model.m_sinio;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Add()
+// Copies the time-invariant terms of the SGP4 model of the orbit.
+int cSgp4Batch::Add(const cOrbit &orbit)
+{
+   return Add(orbit.Record());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int cSgp4Batch::Add(const cOrbitRecord &rec)
+{
+   if (rec.m_Model != cOrbitRecord::MODEL_SGP4)
+   {
+      return -1;  // Deep space, see cOrbit::cOrbit()
+   }
+
+   for (int k = 0; k < T_COUNT; k++)
+   {
+      m_Term[k].push_back(rec.m_Sgp4[k]);
+   }
+
+   m_Epoch.push_back(rec.m_jdEpoch);
+   m_Full.push_back(rec.m_Kernel == cOrbitRecord::KERNEL_SGP4_FULL);
+
+   if (m_Full.back())
+   {
+      m_FullCount++;
+   }
+
+   return m_Count++;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Set()
+// Overwrites the terms at an index, so that the rest of the batch keeps
+// its layout.
+bool cSgp4Batch::Set(int index, const cOrbit &orbit)
+{
+   return Set(index, orbit.Record());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool cSgp4Batch::Set(int index, const cOrbitRecord &rec)
+{
+   if (rec.m_Model != cOrbitRecord::MODEL_SGP4)
+   {
+      return false;
+   }
+
+   for (int k = 0; k < T_COUNT; k++)
+   {
+      m_Term[k][index] = rec.m_Sgp4[k];
+   }
+
+   m_Epoch[index] = rec.m_jdEpoch;
+
+   bool full = (rec.m_Kernel == cOrbitRecord::KERNEL_SGP4_FULL);
+
+   if (full != (bool)m_Full[index])
+   {
+      m_FullCount += (full ? 1 : -1);
+      m_Full[index] = full;
+   }
+
+   return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int cSgp4Batch::PropagateOrbit(const double *term, bool simple,
+                               const double *ptsince, int count,
+                               double *x,  double *y,  double *z,
+                               double *vx, double *vy, double *vz,
+                               int *pStatus /* = NULL */)
+{
+   if (count <= 0)
+   {
+      return 0;
+   }
+
+   if (simple)
+   {
+      return Sgp4KernelTimes<true>(term, count, ptsince, x, y, z, vx, vy, vz, pStatus);
+   }
+
+   return Sgp4KernelTimes<false>(term, count, ptsince, x, y, z, vx, vy, vz, pStatus);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int cSgp4Batch::Propagate(double tsince,
+                          double *x,  double *y,  double *z,
+                          double *vx, double *vy, double *vz,
+                          int *pStatus /* = NULL */) const
+{
+   if (m_Count == 0)
+   {
+      return 0;
+   }
+
+   const double *term[T_COUNT];
+
+   for (int k = 0; k < T_COUNT; k++)
+   {
+      term[k] = &m_Term[k][0];
+   }
+
+   if (m_FullCount == 0)
+   {
+      return Sgp4Kernel<true>(term, m_Count, NULL, tsince, x, y, z, vx, vy, vz, pStatus);
+   }
+
+   return Sgp4Kernel<false>(term, m_Count, NULL, tsince, x, y, z, vx, vy, vz, pStatus);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int cSgp4Batch::Propagate(const double *ptsince,
+                          double *x,  double *y,  double *z,
+                          double *vx, double *vy, double *vz,
+                          int *pStatus /* = NULL */) const
+{
+   if (m_Count == 0)
+   {
+      return 0;
+   }
+
+   const double *term[T_COUNT];
+
+   for (int k = 0; k < T_COUNT; k++)
+   {
+      term[k] = &m_Term[k][0];
+   }
+
+   if (m_FullCount == 0)
+   {
+      return Sgp4Kernel<true>(term, m_Count, ptsince, 0.0, x, y, z, vx, vy, vz, pStatus);
+   }
+
+   return Sgp4Kernel<false>(term, m_Count, ptsince, 0.0, x, y, z, vx, vy, vz, pStatus);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int cSgp4Batch::PropagateAt(const cJulian &gmt,
+                            double *x,  double *y,  double *z,
+                            double *vx, double *vy, double *vz,
+                            int *pStatus /* = NULL */) const
+{
+   std::vector<double> tsince(m_Count);
+
+   for (int i = 0; i < m_Count; i++)
+   {
+      tsince[i] = (gmt.Date() - m_Epoch[i]) * MIN_PER_DAY;
+   }
+
+   return Propagate(m_Count ? &tsince[0] : NULL, x, y, z, vx, vy, vz, pStatus);
+}
+}
+}
@@ -0,0 +1,115 @@
+//
+// cSgp4Batch.h
+//
+// This class propagates a batch of near-earth (SGP4) orbits at once. The
+// time-invariant terms of every orbit are stored in structure-of-arrays
+// form, and the propagation kernel processes several orbits per
+// instruction (AVX2 / AVX-512 when the CPU supports them).
+//
+// Results agree with cOrbit::PositionEci() to well below one millimeter:
+// trigonometric functions are evaluated with vectorizable polynomials and
+// the argument of latitude is rotated instead of recovered with atan().
+//
+#pragma once
+
+#include <vector>
+
+#include "cJulian.h"
+
+namespace Zeptomoby
+{
+namespace OrbitTools
+{
+
+class cOrbit;
+class cNoradSGP4;
+struct cOrbitRecord;
+
+//////////////////////////////////////////////////////////////////////////////
+class cSgp4Batch
+{
+public:
+   cSgp4Batch();
+   ~cSgp4Batch();
+
+   // Propagation status of each orbit
+   enum eStatus
+   {
+      STATUS_OK,
+      STATUS_ECCENTRICITY, // Eccentricity out of range (orbit data error)
+      STATUS_DECAYED       // Satellite is below the Earth's surface
+   };
+
+   // Adds an orbit to the batch and returns its index. Deep-space (SDP4)
+   // orbits are not supported: -1 is returned for them.
+   int  Add(const cOrbit &orbit);
+   int  Add(const cOrbitRecord &rec);
+   // Replaces the orbit at an index (e.g. with a newer element set of the
+   // same satellite). Returns false, leaving the batch unchanged, for
+   // deep-space orbits.
+   bool Set(int index, const cOrbit &orbit);
+   bool Set(int index, const cOrbitRecord &rec);
+   int  Count() const { return m_Count; }
+   void Clear();
+
+   cJulian Epoch(int index) const { return cJulian(m_Epoch[index]); }
+
+   // Propagate every orbit of the batch. Times are given in minutes past
+   // the epoch of each orbit, either the same for all of them (tsince) or
+   // one for each orbit (ptsince[Count()]). Positions (km) and velocities
+   // (km/sec) are written in arrays of Count() elements. The number of
+   // orbits that could not be propagated is returned; the reason is written
+   // in pStatus[Count()], if given.
+   int Propagate(double tsince,
+                 double *x,  double *y,  double *z,
+                 double *vx, double *vy, double *vz,
+                 int *pStatus = NULL) const;
+
+   int Propagate(const double *ptsince,
+                 double *x,  double *y,  double *z,
+                 double *vx, double *vy, double *vz,
+                 int *pStatus = NULL) const;
+
+   // Same as above, with every orbit propagated to the same instant (GMT).
+   int PropagateAt(const cJulian &gmt,
+                   double *x,  double *y,  double *z,
+                   double *vx, double *vy, double *vz,
+                   int *pStatus = NULL) const;
+
+   // Propagate a single orbit, given its terms (see InitTerms()), to count
+   // instants (ptsince[count], minutes past epoch). simple selects the
+   // kernel of the orbits with perigee below 220 km (isimp, see
+   // cOrbitRecord::KERNEL_SGP4_SIMPLE). Units and return value as in
+   // Propagate().
+   static int PropagateOrbit(const double *term, bool simple,
+                             const double *ptsince, int count,
+                             double *x,  double *y,  double *z,
+                             double *vx, double *vy, double *vz,
+                             int *pStatus = NULL);
+
+   // Time-invariant terms, one array of Count() values per term.
+   enum eTerm
+   {
+      T_M0,     T_W0,     T_O0,     T_E0,     T_I0,     T_A0,
+      T_N0,     T_XMDOT,  T_OMGDOT, T_XNODOT, T_XNODCF, T_T2COF,
+      T_C1,     T_BC4,    T_BC5,    T_OMGCOF, T_XMCOF,  T_ETA,
+      T_DELMO,  T_SINMO,  T_D2,     T_D3,     T_D4,     T_T3COF,
+      T_T4COF,  T_T5COF,  T_AYCOF,  T_XLCOF,  T_X3THM1, T_X1MTH2,
+      T_X7THM1, T_COSIO,  T_SINIO,
+      T_COUNT   // MUST be last
+   };
+
+   static void InitTerms(const cNoradSGP4 &model, double *term);
+
+private:
+   cSgp4Batch(const cSgp4Batch&);
+   cSgp4Batch& operator=(const cSgp4Batch&);
+
+   int                 m_Count;
+   int                 m_FullCount;   // Orbits that are not isimp
+   std::vector<char>   m_Full;        // Whether each orbit is not isimp
+   std::vector<double> m_Term[T_COUNT];
+   std::vector<double> m_Epoch;   // Julian dates
+};
+}
+}
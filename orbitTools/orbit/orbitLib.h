@@ -13,5 +13,6 @@ using namespace std;
 
 #include "cOrbit.h"
 #include "cSatellite.h"
+#include "cSgp4Batch.h"
 
 using namespace Zeptomoby::OrbitTools;
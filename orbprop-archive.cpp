@@ -0,0 +1,95 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: TLE archive tool.
+ *  \details    Builds binary TLE archives (see TLEArchive) from TLE collection folders, so that
+ *              `orbprop` can load historic data without parsing text files.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       10-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+using namespace std;
+
+void printHelp(void)
+{
+    /*  COMMAND     OPTION      VALUE           DESCRIPTION:
+     *  build                                   Builds an archive.
+     *              -t          folder path     Path to the TLE folder (scanned recursively).
+     *              -o          file path       Path of the archive.
+     *              -j          integer         Number of threads with which to load the TLE's.
+     *  info        <file path>                 Shows the contents of an archive.
+     */
+    cout << "Usage: orbprop-archive build [-t <TLE folder>] [-o <archive>] [-j <threads>]" << endl;
+    cout << "       orbprop-archive info <archive>" << endl;
+    cout << DBG_WHITEB "OPTION   VALUE                 DESCRIPTION" DBG_NOCOLOR << endl;
+    cout << DBG_REDD   "  -t     " DBG_YELLOWD "Path to TLE folder    " DBG_NOCOLOR "Folder with TLE collection files (default: tle_collections/historic)." << endl;
+    cout << DBG_REDD   "  -o     " DBG_YELLOWD "Path to file          " DBG_NOCOLOR "Archive that will be written (default: tle_collections/historic.tlea)." << endl;
+    cout << DBG_REDD   "  -j     " DBG_YELLOWD "integer               " DBG_NOCOLOR "Number of threads with which to load TLE files (default: 1)." << endl;
+}
+
+int main(int argc, char **argv)
+{
+    string input_path = "tle_collections/historic";     /* TLE folder.                            */
+    string archive_path = "tle_collections/historic.tlea"; /* Archive file.                       */
+    int threads = 1;                                    /* Number of loading threads.             */
+    string error;
+    unordered_map<int, TLEHistoricSet> tle_data;
+
+    if(argc == 3 && string(argv[1]) == "info") {
+        TLEArchive archive;
+        if(!archive.open(argv[2], &error)) {
+            cerr << DBG_REDD "  ERROR: " << argv[2] << ": " << error << "." DBG_NOCOLOR << endl;
+            return -1;
+        }
+        cout << "  " << argv[2] << ": " << archive.getRecordCount() << " TLE's of "
+             << archive.getSatelliteCount() << " satellites." << endl;
+        return 0;
+    }
+    if(argc < 2 || string(argv[1]) != "build") {
+        printHelp();
+        return -1;
+    }
+    for(int arg_iterator = 2; arg_iterator < argc; arg_iterator++) {
+        string str(argv[arg_iterator]);
+        if(str == "-t" && (arg_iterator + 1) < argc) {
+            input_path = string(argv[++arg_iterator]);
+        } else if(str == "-o" && (arg_iterator + 1) < argc) {
+            archive_path = string(argv[++arg_iterator]);
+        } else if(str == "-j" && (arg_iterator + 1) < argc) {
+            if((threads = atoi(argv[++arg_iterator])) < 1) {
+                cerr << DBG_REDD "The number of threads should be a positive integer." DBG_NOCOLOR << endl;
+                return -1;
+            }
+        } else {
+            cerr << DBG_REDD "Wrong argument: \'" << str << "\'" DBG_NOCOLOR << endl;
+            printHelp();
+            return -1;
+        }
+    }
+
+    TLELoader tle_loader(threads);
+    if(!tle_loader.scan(input_path)) {
+        return -1;
+    }
+    cout << "  " << tle_loader.getFileCount() << " TLE files have been found." << endl;
+    int tle_count = tle_loader.load(tle_data, true);
+    cout << "  " << tle_count << " TLE's have been read (" << tle_loader.getDuplicateCount()
+         << " duplicates dropped, " << tle_loader.getUniqueCount() << " unique element sets)." << endl;
+
+    if(!TLEArchive::write(archive_path, tle_data, &error)) {
+        cerr << DBG_REDD "  ERROR: " << archive_path << ": " << error << "." DBG_NOCOLOR << endl;
+        return -1;
+    }
+    int unique_count = 0;
+    for(auto t = tle_data.begin(); t != tle_data.end(); t++) {
+        unique_count += t->second.getSize();
+    }
+    cout << "  " << archive_path << ": " << unique_count << " TLE's of " << tle_data.size()
+         << " satellites have been archived." << endl;
+    return 0;
+}
@@ -0,0 +1,198 @@
+/***********************************************************************************************//**
+ *  \brief      Orbit propagator: compressed propagation file decoder.
+ *  \details    Decodes compressed propagation files (`.propz`, see PropCodec) into the usual CSV
+ *              `.prop` format, one chunk after another, so that they can be piped to other tools or
+ *              loaded with the existing scripts. Chebyshev ephemerides (`.cheb` files, see
+ *              ChebyshevEphemeris) are evaluated at any time step into the same format.
+ *  \author     Carles Araguz, carles.araguz@upc.edu
+ *  \version    0.1
+ *  \date       22-feb-2017
+ *  \copyright  GNU Public License (v3). This files are part of an on-going non-commercial research
+ *              project at NanoSat Lab (http://nanosatlab.upc.edu) of the Technical University of
+ *              Catalonia - UPC BarcelonaTech. Third-party libraries used in this framework might be
+ *              subject to different copyright conditions.
+ **************************************************************************************************/
+
+#include "orbprop.hpp"
+
+using namespace std;
+
+void printHelp(void)
+{
+    /*  COMMAND     OPTION      VALUE           DESCRIPTION:
+     *  <file path>                             Decodes a compressed file or evaluates a Chebyshev
+     *                                          ephemeris (to the standard output).
+     *              -o          file path       Path of the CSV file.
+     *              -d          integer         Time step of the points of an ephemeris (seconds).
+     *  info        <file path>                 Shows the header of a compressed file or ephemeris.
+     */
+    cout << "Usage: orbprop-decode <compressed file | ephemeris> [-o <CSV file>] [-d <seconds>]" << endl;
+    cout << "       orbprop-decode info <compressed file | ephemeris>" << endl;
+    cout << DBG_WHITEB "OPTION   VALUE                 DESCRIPTION" DBG_NOCOLOR << endl;
+    cout << DBG_REDD   "  -o     " DBG_YELLOWD "Path to file          " DBG_NOCOLOR "CSV propagation file (.prop) that will be written (default: the standard output)." << endl;
+    cout << DBG_REDD   "  -d     " DBG_YELLOWD "integer               " DBG_NOCOLOR "Seconds between the points evaluated from a Chebyshev ephemeris (.cheb) (default: 1)." << endl;
+}
+
+bool isEphemeris(const string & path)
+{
+    return (path.size() > 5 && path.compare(path.size() - 5, 5, ".cheb") == 0);
+}
+
+/*  Shows the header of a Chebyshev ephemeris. */
+int showEphemeris(const string & input_path)
+{
+    ChebyshevEphemeris ephemeris;
+    std::time_t prop_time_start = 0, prop_time_end = 0;
+    if(!ephemeris.load(input_path, &prop_time_start, &prop_time_end)) {
+        cerr << DBG_REDD "  ERROR: " << input_path << ": not a Chebyshev ephemeris of degree " << CHEB_DEGREE << "." DBG_NOCOLOR << endl;
+        return -1;
+    }
+    printf("  %s: %d granules (%.0f to %.0f, propagation from %ld to %ld).\n", input_path.c_str(),
+        ephemeris.getSize(), ephemeris.getStart(), ephemeris.getEnd(), prop_time_start, prop_time_end);
+    printf("  Max. errors at check points: %.3f m, %.3f mm/s (%d granules above tolerance).\n",
+        ephemeris.getMaxPositionError() * 1000.0, ephemeris.getMaxVelocityError() * 1e6,
+        ephemeris.getCoarseGranules());
+    return 0;
+}
+
+/*  Evaluates a Chebyshev ephemeris every `step` seconds of its propagation span (the same points as
+ *  a `.prop` file with that step) and writes them in CSV format. Points that are not covered by the
+ *  ephemeris (i.e. that could not be propagated) are not written. Latitude and longitude are those
+ *  of the evaluated position at the time of each point.
+ */
+int decodeEphemeris(const string & input_path, FILE * output_file, std::time_t step, long * point_count)
+{
+    ChebyshevEphemeris ephemeris;
+    std::time_t prop_time_start = 0, prop_time_end = 0;
+    if(!ephemeris.load(input_path, &prop_time_start, &prop_time_end)) {
+        cerr << DBG_REDD "  ERROR: " << input_path << ": not a Chebyshev ephemeris of degree " << CHEB_DEGREE << "." DBG_NOCOLOR << endl;
+        return -1;
+    }
+
+    PropTimeFormatter time_formatter;
+    string text;
+    char line[256];
+    double pos[3], vel[3];
+    writePropHeader(output_file, prop_time_start, prop_time_end, step,
+        (int)ceil((double)(prop_time_end - prop_time_start) / step));
+    for(std::time_t t = prop_time_start; t <= prop_time_end; t += step) {
+        if(!ephemeris.evaluate(t, pos, vel)) {
+            continue;
+        }
+        Zeptomoby::OrbitTools::cGeo geo(Zeptomoby::OrbitTools::cVector(pos[0], pos[1], pos[2]),
+            Zeptomoby::OrbitTools::cJulian(t).ToGmst());
+        text.append(line, formatPoint(line, sizeof(line), time_formatter.format(t), t,
+            geo.LatitudeDeg(), geo.LongitudeDeg(), pos[0], pos[1], pos[2], vel[0], vel[1], vel[2]));
+        if(++(*point_count) % PROP_CHUNK_POINTS == 0) {
+            fwrite(text.data(), 1, text.size(), output_file);
+            text.clear();
+        }
+    }
+    fwrite(text.data(), 1, text.size(), output_file);
+    return 0;
+}
+
+/*  Decodes a compressed propagation file into CSV format. */
+int decodeCompressed(const string & input_path, FILE * output_file, long * point_count)
+{
+    string error;
+    PropDecoder decoder;
+    PropBinaryRecord r;
+    if(!decoder.open(input_path, &error)) {
+        cerr << DBG_REDD "  ERROR: " << input_path << ": " << error << "." DBG_NOCOLOR << endl;
+        return -1;
+    }
+
+    /* Points are formatted in a buffer, which is written every PROP_CHUNK_POINTS points: */
+    const PropCompressedHeader & h = decoder.getHeader();
+    PropTimeFormatter time_formatter;
+    string text;
+    char line[256];
+    writePropHeader(output_file, h.time_start, h.time_end, h.time_step, h.points);
+    while(decoder.next(r, &error)) {
+        text.append(line, formatPoint(line, sizeof(line), time_formatter.format(r.time), r.time, r.lat,
+            r.lon, r.x, r.y, r.z, r.vx, r.vy, r.vz));
+        if(++(*point_count) % PROP_CHUNK_POINTS == 0) {
+            fwrite(text.data(), 1, text.size(), output_file);
+            text.clear();
+        }
+    }
+    fwrite(text.data(), 1, text.size(), output_file);
+    if(!error.empty()) {
+        cerr << DBG_REDD "  ERROR: " << input_path << ": " << error << " (after " << *point_count << " points)." DBG_NOCOLOR << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    string input_path;          /* Compressed file or ephemeris.                                  */
+    string output_path;         /* CSV file (empty for the standard output).                      */
+    std::time_t step = 1;       /* Time step of the points of an ephemeris.                       */
+    string error;
+    long point_count = 0;
+
+    if(argc == 3 && string(argv[1]) == "info") {
+        if(isEphemeris(argv[2])) {
+            return showEphemeris(argv[2]);
+        }
+        PropDecoder decoder;
+        PropBinaryRecord r;
+        if(!decoder.open(argv[2], &error)) {
+            cerr << DBG_REDD "  ERROR: " << argv[2] << ": " << error << "." DBG_NOCOLOR << endl;
+            return -1;
+        }
+        while(decoder.next(r, &error)) {
+            point_count++;
+        }
+        const PropCompressedHeader & h = decoder.getHeader();
+        cout << "  " << argv[2] << ": NORAD ID " << h.norad_id << ", " << point_count << " of " << h.points
+             << " points (" << h.time_start << " to " << h.time_end << ", " << h.time_step << " s step)." << endl;
+        cout << "  Resolution: " << (h.quantum[2] * 1000.0) << " m, " << (h.quantum[5] * 1e6) << " mm/s, "
+             << h.quantum[0] << " deg." << endl;
+        if(!error.empty()) {
+            cerr << DBG_REDD "  ERROR: " << argv[2] << ": " << error << "." DBG_NOCOLOR << endl;
+            return -1;
+        }
+        return 0;
+    }
+    for(int arg_iterator = 1; arg_iterator < argc; arg_iterator++) {
+        string str(argv[arg_iterator]);
+        if(str == "-o" && (arg_iterator + 1) < argc) {
+            output_path = string(argv[++arg_iterator]);
+        } else if(str == "-d" && (arg_iterator + 1) < argc) {
+            if((step = strtol(argv[arg_iterator + 1], NULL, 10)) <= 0) {
+                cerr << DBG_REDD "Wrong argument value: \'-d " << string(argv[arg_iterator + 1]) << "\'" DBG_NOCOLOR << endl;
+                return -1;
+            }
+            arg_iterator++;
+        } else if(input_path.empty() && str[0] != '-') {
+            input_path = str;
+        } else {
+            cerr << DBG_REDD "Wrong argument: \'" << str << "\'" DBG_NOCOLOR << endl;
+            printHelp();
+            return -1;
+        }
+    }
+    if(input_path.empty()) {
+        printHelp();
+        return -1;
+    }
+
+    FILE * output_file = stdout;
+    if(!output_path.empty() && (output_file = fopen(output_path.c_str(), "w")) == NULL) {
+        cerr << DBG_REDD "Unable to open file " << output_path << DBG_NOCOLOR << endl;
+        return -1;
+    }
+    int result = (isEphemeris(input_path) ? decodeEphemeris(input_path, output_file, step, &point_count) :
+        decodeCompressed(input_path, output_file, &point_count));
+    if(output_file != stdout) {
+        fclose(output_file);
+    }
+    if(result == 0 && !output_path.empty()) {
+        cout << "  " << output_path << ": " << point_count << " points have been "
+             << (isEphemeris(input_path) ? "evaluated." : "decoded.") << endl;
+    }
+    return result;
+}
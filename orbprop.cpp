@@ -25,6 +25,7 @@ void printHelp(void)
 {
     /*  OPTION      VALUE           DESCRIPTION:
      *  -t          folder path     Path to the TLE folder.
+     *  -a          file path       Path to a TLE archive (replaces the TLE folder).
      *  -o          folder path     Path to the results folder.
      *  -C          (none)          TLE collections will be looked for in the `current` folder.
      *  -H          (none)          TLE collections will be looked for in the `historic` folder.
@@ -32,20 +33,39 @@ void printHelp(void)
      *  -e          UNIX time       Propagation end.
      *  -d          integer         A positive integer representing the amount of seconds of
      *                              resolution (i.e. propagation step).
-     *  -j          integer         Number of threads with which to perform the propagation.
+     *  -j          integer         Number of threads with which to load TLE's and propagate.
+     *  -E          float           Chebyshev ephemeris mode, with the given tolerance (meters).
+     *  -T          (none)          Time-major mode: the whole catalog is propagated step by step.
+     *  -b          (none)          Binary output (.propb files instead of CSV .prop files).
+     *  -K          (none)          Catalog container output (a single .propc file, time-major).
+     *  -z          float           Compressed output (.propz files), with the given resolution (m).
+     *  -X          float           Cross-distance mode, with the given encounter distance (km).
+     *  -n          (none)          Cross-distances: samples next to encounters are not kept.
+     *  -V          (none)          Cross-distances: only encounter events are written.
+     *  -A          float           Closest-approach mode, with the given encounter distance (km).
      *  -h          (none)          Shows the help menu.
      *  -v          (none)          Verbose: outputs all data points as it generates them.
      */
     cout << "List of possible arguments:" << endl;
     cout << DBG_WHITEB "OPTION   VALUE                 DESCRIPTION" DBG_NOCOLOR << endl;
     cout << DBG_REDD   "  -t     " DBG_YELLOWD "Path to TLE folder    " DBG_NOCOLOR "Path to a folder containing (only) Two-Line Elements collection files." << endl;
+    cout << DBG_REDD   "  -a     " DBG_YELLOWD "Path to TLE archive   " DBG_NOCOLOR "Loads TLE's from an archive built with `orbprop-archive build` instead of a TLE folder." << endl;
     cout << DBG_REDD   "  -C     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "TLE collections will be looked for in <path>/current (default)." << endl;
     cout << DBG_REDD   "  -H     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "TLE collections will be looked for in <path>/historic." << endl;
     cout << DBG_REDD   "  -o     " DBG_YELLOWD "Path to folder        " DBG_NOCOLOR "Path to the results folder (if it doesn't exist, it'll be created)." << endl;
     cout << DBG_REDD   "  -s     " DBG_YELLOWD "UNIX time             " DBG_NOCOLOR "Orbit propagation start time." << endl;
     cout << DBG_REDD   "  -e     " DBG_YELLOWD "UNIX time             " DBG_NOCOLOR "Orbit propagation end time." << endl;
     cout << DBG_REDD   "  -d     " DBG_YELLOWD "integer               " DBG_NOCOLOR "Positive amount of seconds between each propagation point." << endl;
-    cout << DBG_REDD   "  -j     " DBG_YELLOWD "integer               " DBG_NOCOLOR "Number of threads with which to perform the propagation." << endl;
+    cout << DBG_REDD   "  -j     " DBG_YELLOWD "integer               " DBG_NOCOLOR "Number of threads with which to load TLE files and perform the propagation (default: 1)." << endl;
+    cout << DBG_REDD   "  -E     " DBG_YELLOWD "float                 " DBG_NOCOLOR "Fits Chebyshev ephemerides (.cheb files) with the given position tolerance (in meters)." << endl;
+    cout << DBG_REDD   "  -T     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "Time-major mode: propagates all the satellites together, one time step after another." << endl;
+    cout << DBG_REDD   "  -b     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "Writes binary propagation files (.propb) instead of CSV ones (.prop)." << endl;
+    cout << DBG_REDD   "  -z     " DBG_YELLOWD "float                 " DBG_NOCOLOR "Writes compressed propagation files (.propz) with the given position resolution (in meters)." << endl;
+    cout << DBG_REDD   "  -K     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "Writes all the satellites to a single catalog container (" PROPC_FILE_NAME ", implies -T)." << endl;
+    cout << DBG_REDD   "  -X     " DBG_YELLOWD "float                 " DBG_NOCOLOR "Computes the distances between all pairs of satellites (.cdb files) and keeps those below the given value (in km)." << endl;
+    cout << DBG_REDD   "  -n     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "With -X, only distances below the given value are kept (not the samples around each encounter)." << endl;
+    cout << DBG_REDD   "  -V     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "With -X, only the encounter events (.cde files) are written, not the distances." << endl;
+    cout << DBG_REDD   "  -A     " DBG_YELLOWD "float                 " DBG_NOCOLOR "Finds the time of closest approach of all the encounters below the given distance (in km)." << endl;
     cout << DBG_REDD   "  -v     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "Verbose; will output all data points as it generates them." << endl;
     cout << DBG_REDD   "  -h     " DBG_YELLOWD "(none)                " DBG_NOCOLOR "Shows this help." << endl;
 }
@@ -59,20 +79,25 @@ int main(int argc, char **argv)
     time_t prop_time_end;       /* In seconds                                                     */
     time_t prop_time_step;      /* In seconds                                                     */
     string input_path;          /* Input path where TLE files are located.                        */
+    string archive_path;        /* TLE archive (if set, TLE files are not read).                  */
     string output_path_root;    /* Path folder for the resulting files.                           */
     string output_path;         /* Output path for the resulting files.                           */
-    vector<string> tle_files;   /* A vector of TLE file paths (<*>/<*>/<*>.txt)                   */
-    FILE * tle_file;            /* TLE input file.                                                */
     FILE * conf_file;           /* Program configuration file.                                    */
     char file_line[200];        /* One single line from an open file.                             */
     int line_count = 0;         /* Line counter (debug purposes).                                 */
-    string tle_line1;           /* Line 1 in the TLE file.                                        */
-    string tle_line2;           /* Line 2 in the TLE file.                                        */
-    string tle_line3;           /* Line 3 in the TLE file.                                        */
     struct tm *tmp;             /* Time struct (debug purposes).                                  */
     char time_formated[21];     /* Time in the format "yyyy-mm-dd hh:mm:ss"                       */
     double julian_days;         /* Time in Julian days (debug purposes).                          */
     bool verbose = false;       /* Whether to print all data points as they are generated.        */
+    int prop_threads = 1;       /* Number of threads with which to perform the propagation.       */
+    double cheb_tolerance = 0;  /* Chebyshev ephemeris tolerance (in km); 0 for regular output.   */
+    bool time_major = false;    /* Whether to propagate the whole catalog one step after another. */
+    PropFormat prop_format = PROP_FORMAT_CSV;   /* Format of the propagation files.               */
+    double prop_resolution = PROPZ_RESOLUTION;  /* Position resolution of compressed files (m).   */
+    double cross_distance = 0;  /* Encounter distance (km); 0 if cross-distances are not computed. */
+    double tca_distance = 0;    /* Encounter distance (km); 0 if closest approaches are not found. */
+    bool scan_intersec = true;  /* Whether cross-distances next to each encounter are kept.       */
+    bool write_samples = true;  /* Whether cross-distances are written (or only encounter events). */
     unordered_map<int, TLEHistoricSet> tle_data; /* TLE data for each NORAD ID and with
                                                   * historical records.
                                                   */
@@ -93,6 +118,7 @@ int main(int argc, char **argv)
     if(argc > 1) {
         /*  OPTION      VALUE           DESCRIPTION:
          *  -t          folder path     Path to the TLE folder.
+         *  -a          file path       Path to a TLE archive (replaces the TLE folder).
          *  -o          folder path     Path to the results folder.
          *  -c          (none)          TLE collections will be looked for in the `current` folder.
          *  -H          (none)          TLE collections will be looked for in the `historic` folder.
@@ -100,7 +126,16 @@ int main(int argc, char **argv)
          *  -e          UNIX time       Propagation end.
          *  -d          integer         A positive integer representing the amount of seconds of
          *                              resolution (i.e. propagation step).
-         *  -j          integer         Number of threads with which to perform the propagation.
+         *  -j          integer         Number of threads with which to load TLE's and propagate.
+         *  -E          float           Chebyshev ephemeris mode, with the given tolerance (meters).
+         *  -T          (none)          Time-major mode: the whole catalog is propagated step by step.
+         *  -b          (none)          Binary output (.propb files instead of CSV .prop files).
+         *  -K          (none)          Catalog container output (a single .propc file, time-major).
+         *  -z          float           Compressed output (.propz files), with the given resolution (m).
+         *  -X          float           Cross-distance mode, with the given encounter distance (km).
+         *  -n          (none)          Cross-distances: samples next to encounters are not kept.
+         *  -V          (none)          Cross-distances: only encounter events are written.
+         *  -A          float           Closest-approach mode, with the given encounter distance (km).
          *  -h          (none)          Shows the help menu.
          *  -v          (none)          Verbose: outputs all data points as it generates them.
          */
@@ -111,6 +146,9 @@ int main(int argc, char **argv)
             if(str == "-t" && (arg_iterator + 1) < argc) {
                 input_path = string(argv[arg_iterator + 1]);
                 arg_iterator++;
+            } else if(str == "-a" && (arg_iterator + 1) < argc) {
+                archive_path = string(argv[arg_iterator + 1]);
+                arg_iterator++;
             } else if(str == "-o" && (arg_iterator + 1) < argc) {
                 output_path_root = string(argv[arg_iterator + 1]);
                 arg_iterator++;
@@ -152,12 +190,66 @@ int main(int argc, char **argv)
                 arg_iterator++;
             } else if(str == "-v") {
                 verbose = true;
+            } else if(str == "-T") {
+                time_major = true;
+            } else if(str == "-b") {
+                prop_format = PROP_FORMAT_BINARY;
+            } else if(str == "-K") {
+                prop_format = PROP_FORMAT_CONTAINER;
+            } else if(str == "-n") {
+                scan_intersec = false;
+            } else if(str == "-V") {
+                write_samples = false;
             } else if(str == "-C") {
                 input_path = "tle_collections/current";
             } else if(str == "-H") {
                 input_path = "tle_collections/historic";
-            } else if(str == "-j") {
-                cerr << DBG_REDD "Multi-threaded propagation is still not supported." DBG_NOCOLOR << endl;
+            } else if(str == "-j" && (arg_iterator + 1) < argc) {
+                if((prop_threads = strtol(argv[arg_iterator + 1], NULL, 10)) <= 0)
+                {
+                    cerr << DBG_REDD "Wrong argument value: \'-j " << string(argv[arg_iterator + 1]) << "\'" DBG_NOCOLOR << endl;
+                    cerr << DBG_REDD "The number of threads should be a positive integer." DBG_NOCOLOR << endl;
+                    printHelp();
+                    return -1;
+                }
+                arg_iterator++;
+            } else if(str == "-E" && (arg_iterator + 1) < argc) {
+                if((cheb_tolerance = strtod(argv[arg_iterator + 1], NULL) / 1000.0) <= 0)
+                {
+                    cerr << DBG_REDD "Wrong argument value: \'-E " << string(argv[arg_iterator + 1]) << "\'" DBG_NOCOLOR << endl;
+                    cerr << DBG_REDD "The ephemeris tolerance should be a positive number (in meters)." DBG_NOCOLOR << endl;
+                    printHelp();
+                    return -1;
+                }
+                arg_iterator++;
+            } else if(str == "-z" && (arg_iterator + 1) < argc) {
+                if((prop_resolution = strtod(argv[arg_iterator + 1], NULL)) <= 0)
+                {
+                    cerr << DBG_REDD "Wrong argument value: \'-z " << string(argv[arg_iterator + 1]) << "\'" DBG_NOCOLOR << endl;
+                    cerr << DBG_REDD "The resolution should be a positive number (in meters)." DBG_NOCOLOR << endl;
+                    printHelp();
+                    return -1;
+                }
+                prop_format = PROP_FORMAT_COMPRESSED;
+                arg_iterator++;
+            } else if(str == "-X" && (arg_iterator + 1) < argc) {
+                if((cross_distance = strtod(argv[arg_iterator + 1], NULL)) <= 0)
+                {
+                    cerr << DBG_REDD "Wrong argument value: \'-X " << string(argv[arg_iterator + 1]) << "\'" DBG_NOCOLOR << endl;
+                    cerr << DBG_REDD "The encounter distance should be a positive number (in km)." DBG_NOCOLOR << endl;
+                    printHelp();
+                    return -1;
+                }
+                arg_iterator++;
+            } else if(str == "-A" && (arg_iterator + 1) < argc) {
+                if((tca_distance = strtod(argv[arg_iterator + 1], NULL)) <= 0)
+                {
+                    cerr << DBG_REDD "Wrong argument value: \'-A " << string(argv[arg_iterator + 1]) << "\'" DBG_NOCOLOR << endl;
+                    cerr << DBG_REDD "The encounter distance should be a positive number (in km)." DBG_NOCOLOR << endl;
+                    printHelp();
+                    return -1;
+                }
+                arg_iterator++;
             } else {
                 cout << "Unknown argument: \'" << str << "\'" << endl;
                 printHelp();
@@ -185,7 +277,55 @@ int main(int argc, char **argv)
     cout << "  T(end)  : " << prop_time_end << " (" << time_formated << " UTC, Julian date: " << (1900 + tmp->tm_year) << ", " << julian_days << ")" << endl;
     cout << "  T(step) : " << prop_time_step << " seconds (" << (prop_time_step/60.0) <<" min.)" << endl;
     cout << "  Span    : " << ((prop_time_end - prop_time_start) / 3600.0) << " hours (" << ((prop_time_end - prop_time_start) / 3600.0)/24.0 << " days)." << endl;
-    cout << "  Output  : " << prop_n_points << " points." << endl << endl;
+    if(prop_format != PROP_FORMAT_CSV && (cheb_tolerance > 0 || cross_distance > 0 || tca_distance > 0)) {
+        cerr << DBG_REDD "  WARNING: Only propagation files can be written in binary, compressed or container format ("
+             << (prop_format == PROP_FORMAT_BINARY ? "-b" : (prop_format == PROP_FORMAT_COMPRESSED ? "-z" : "-K"))
+             << " is ignored)." DBG_NOCOLOR << endl;
+        prop_format = PROP_FORMAT_CSV;
+    } else if(prop_format == PROP_FORMAT_CONTAINER) {
+        time_major = true;      /* Containers are written one time step after another. */
+    }
+    if(cheb_tolerance > 0) {
+        cout << "  Output  : Chebyshev ephemeris, " << (cheb_tolerance * 1000.0) << " m tolerance." << endl << endl;
+        verbose = false;
+        if(time_major || cross_distance > 0 || tca_distance > 0) {
+            cerr << DBG_REDD "  WARNING: Chebyshev ephemerides are fitted satellite by satellite (-T, -X and -A are ignored)." DBG_NOCOLOR << endl;
+            time_major = false;
+            cross_distance = 0;
+            tca_distance = 0;
+        }
+    } else if(tca_distance > 0) {
+        cout << "  Output  : Closest approaches below " << tca_distance << " km, " << prop_n_points << " points (time-major)." << endl << endl;
+        verbose = false;
+        if(cross_distance > 0) {
+            cerr << DBG_REDD "  WARNING: Closest approaches and cross-distances are not computed together (-X is ignored)." DBG_NOCOLOR << endl;
+            cross_distance = 0;
+        }
+    } else if(cross_distance > 0) {
+        if(write_samples) {
+            cout << "  Output  : Cross-distances below " << cross_distance << " km" << (scan_intersec ? " (and around encounters)" : "")
+                 << " and encounter events, " << prop_n_points << " points (time-major)." << endl << endl;
+        } else {
+            cout << "  Output  : Encounter events below " << cross_distance << " km, " << prop_n_points << " points (time-major)." << endl << endl;
+        }
+        verbose = false;
+    } else if(time_major) {
+        cout << "  Output  : " << prop_n_points << " points (time-major" << (prop_format == PROP_FORMAT_BINARY ? ", binary" : "")
+             << (prop_format == PROP_FORMAT_CONTAINER ? ", catalog container" : "")
+             << (prop_format == PROP_FORMAT_COMPRESSED ? ", compressed" : "") << ")." << endl << endl;
+        verbose = false;
+    } else {
+        cout << "  Output  : " << prop_n_points << " points" << (prop_format == PROP_FORMAT_BINARY ? " (binary)" : "")
+             << (prop_format == PROP_FORMAT_COMPRESSED ? " (compressed)" : "") << "." << endl << endl;
+    }
+
+    if(prop_threads > 1) {
+        cout << "  Threads : " << prop_threads << endl << endl;
+        if(verbose) {
+            cerr << DBG_REDD "  WARNING: Verbose output is disabled in multi-threaded propagations." DBG_NOCOLOR << endl;
+            verbose = false;
+        }
+    }
 
     if(prop_time_start > prop_time_end) {
         cerr << DBG_REDD "  ERROR: Start time is after end time." DBG_NOCOLOR << endl;
@@ -224,121 +364,28 @@ int main(int argc, char **argv)
     }
 
     /* Load TLE data from files: ---------------------------------------------------------------- */
-    struct linux_dirent {
-        long           d_ino;
-        off_t          d_off;
-        unsigned short d_reclen;
-        char           d_name[];
-    };
-
-    int tle_directory, tle_sub_directory;
-    int nread, nread_sub;
-    int bpos, bpos_sub;
-    char dents_buf[2048], dents_buf_sub[20148], d_type;
-    struct linux_dirent *d;
-
-    if((tle_directory = open(input_path.c_str(), O_RDONLY | O_DIRECTORY)) == -1) {
-        cout << DBG_REDD "  ERROR: Opening the TLE directory failed. Aborting." DBG_NOCOLOR << endl;
-        exit(-1);
-    }
-
-    while(1) {
-        nread = syscall(SYS_getdents, tle_directory, dents_buf, 2048);
-        if(nread == -1) {
-            cout << DBG_REDD "  ERROR: TLE directory scan failed. Aborting." DBG_NOCOLOR << endl;
+    if(!archive_path.empty()) {
+        /* Only the TLE's of the selected satellites that are needed for the span are loaded. */
+        TLEArchive tle_archive;
+        string error;
+        if(!tle_archive.open(archive_path, &error)) {
+            cerr << DBG_REDD "  ERROR: Opening the TLE archive (" << archive_path << ") failed: " << error << ". Aborting." DBG_NOCOLOR << endl;
             exit(-1);
-        } else if(nread == 0) {
-            break;
         }
-        for(bpos = 0; bpos < nread;) {
-            d = (struct linux_dirent *)(dents_buf + bpos);
-            d_type = *(dents_buf + bpos + d->d_reclen - 1);
-            bpos += d->d_reclen;
-            switch(d_type) {
-                case DT_DIR:
-                    if(strcmp(d->d_name, ".") && strcmp(d->d_name, "..")) {
-                        string subdir_path = input_path + "/" + string(d->d_name);
-                        if((tle_sub_directory = open(subdir_path.c_str(), O_RDONLY | O_DIRECTORY)) == -1) {
-                            cout << DBG_REDD "  ERROR: Opening the TLE sub-directory (" << subdir_path << ") failed. Aborting." DBG_NOCOLOR << endl;
-                            exit(-1);
-                        }
-                        while(1) {
-                            nread_sub = syscall(SYS_getdents, tle_sub_directory, dents_buf_sub, 2048);
-                            if(nread_sub == -1) {
-                                cout << DBG_REDD "  ERROR: TLE sub-directory scan failed. Aborting." DBG_NOCOLOR << endl;
-                                exit(-1);
-                            } else if(nread_sub == 0) {
-                                break;
-                            }
-                            for(bpos_sub = 0; bpos_sub < nread_sub;) {
-                                d = (struct linux_dirent *)(dents_buf_sub + bpos_sub);
-                                d_type = *(dents_buf_sub + bpos_sub + d->d_reclen - 1);
-                                bpos_sub += d->d_reclen;
-                                if(d_type == DT_REG) {
-                                    tle_files.push_back(subdir_path + "/" + string(d->d_name));
-                                }
-                            }
-                        }
-                    }
-                    break;
-                case DT_REG:
-                    tle_files.push_back(input_path + "/" + string(d->d_name));
-                    break;
-                default:
-                    /* Ignored entries. */
-                    break;
-            }
-        }
-    }
-    cout << "  " << tle_files.size() << " TLE files have been found." << endl;
-
-    char sat_name[25];
-    int sat_identifier;
-    line_count = 0;
-    for(vector<string>::const_iterator f = tle_files.begin(); f != tle_files.end(); f++) {
-        if((tle_file = fopen((*f).c_str(), "r")) != NULL) {
-            /* Will look for TLE ID's and iterate files: -------------------------------- */
-            while(fgets(file_line, 80, tle_file) != NULL) {
-                if(sscanf(file_line, "%24[^\n\t\r]", sat_name) < 1) {
-                    cerr << DBG_REDD "  WARNING: Can't read satellite name, will try to continue." DBG_NOCOLOR << endl;
-                } else {
-                    tle_line1 = string(file_line);
-                }
-                line_count++;
-                if(fgets(file_line, 80, tle_file) != NULL) {
-                    tle_line2 = string(file_line);
-                } else {
-                    break;
-                }
-                line_count++;
-                if(fgets(file_line, 80, tle_file) != NULL) {
-                    tle_line3 = string(file_line);
-                } else {
-                    break;
-                }
-                line_count++;
-
-                /* At this point, three lines have been read: check that they are well formed. */
-                if(tle_line2.substr(2, 5) == tle_line3.substr(2, 5)) {
-                    sat_identifier = stoi(tle_line2.substr(2, 5), NULL);
-                    /* Check whether this TLE has to be propagated or not: */
-                    unordered_map<int, TLEHistoricSet>::iterator tle_data_it = tle_data.find(sat_identifier);
-                    if(tle_data_it != tle_data.end()) {
-                        TLEHistoricSet tlehs = tle_data_it->second;
-                        tlehs.addTLE(Zeptomoby::OrbitTools::cTle(tle_line1, tle_line2, tle_line3));
-                        tle_data_it->second = tlehs;
-                    }
-                } else {
-                    cerr << DBG_REDD "  Malformed TLE file. Error appears in lines " << (line_count - 3) << " to " << line_count << "." DBG_NOCOLOR << endl;
-                    break;
-                }
-            }
-            fclose(tle_file);
-
-        } else {
-            cerr << DBG_REDD "  ERROR: Could not open the TLE file (" << (*f) << ")." DBG_NOCOLOR << endl;
-            continue;
+        int tle_count = tle_archive.load(tle_data, prop_time_start, prop_time_end);
+        cout << "  " << tle_count << " TLE's have been loaded from " << archive_path << "." << endl;
+    } else {
+        /*  The directory tree is scanned and files are parsed with as many threads as the
+         *  propagation. TLE's are merged in the same order regardless of the number of threads.
+         */
+        TLELoader tle_loader(prop_threads);
+        if(!tle_loader.scan(input_path)) {
+            exit(-1);
         }
+        cout << "  " << tle_loader.getFileCount() << " TLE files have been found." << endl;
+        int tle_count = tle_loader.load(tle_data);
+        cout << "  " << tle_count << " TLE's have been read (" << tle_loader.getDuplicateCount()
+             << " duplicates dropped, " << tle_loader.getUniqueCount() << " unique element sets)." << endl;
     }
     cout << endl;
 
@@ -346,12 +393,105 @@ int main(int argc, char **argv)
     /* -- Create results folder: */
     system(string("mkdir -p " + output_path_root).c_str()); /* Linux/Bash-specific. */
     /* -- Propagate each individual orbit: */
-    for(auto t = tle_data.begin(); t != tle_data.end(); t++) {
-        try {
-            t->second.propagate(output_path_root, prop_time_start, prop_time_end, prop_time_step, prop_n_points, verbose);
-        } catch(exception& e) {
-            // cerr << DBG_REDD "  Propagation of " << t->first << " throwed an EXCEPTION: " << e.what() << DBG_NOCOLOR << endl;
+    if(cross_distance > 0 || tca_distance > 0) {
+        /*  The catalog is propagated in time-major mode (ECI positions only) and, instead of writing
+         *  the positions, the distances of all pairs are computed at each step or the times of
+         *  closest approach are found. Satellites whose orbits can not get close to any other one
+         *  are not propagated.
+         */
+        double d_max = (tca_distance > 0 ? tca_distance : cross_distance);
+        WorkStealingPool * pool = (prop_threads > 1 ? new WorkStealingPool(prop_threads) : NULL);
+        CatalogPropagator catalog(tle_data, "", PROP_FORMAT_CSV, prop_time_start, prop_time_end, prop_time_step, false, pool);
+        OrbitFilter filter(catalog, d_max);
+        int isolated = 0;
+        filter.findPartners(pool);
+        for(int k = 0; k < catalog.getSatelliteCount(); k++) {
+            if(!filter.hasPartner(k)) {
+                catalog.exclude(k);
+                isolated++;
+            }
+        }
+        cout << "  " << isolated << " of " << catalog.getSatelliteCount() << " satellites can not approach any other within "
+             << d_max << " km." << endl;
+        if(tca_distance > 0) {
+            ClosestApproach tca(catalog, output_path_root, tca_distance, pool);
+            tca.compute(catalog);
+            cout << "  " << tca.getEventCount() << " encounters within " << tca_distance << " km ("
+                 << tca.getEvaluationCount() << " refinement propagations)." << endl;
+        } else {
+            CrossDistance cross(catalog, output_path_root, cross_distance, scan_intersec, pool, write_samples);
+            cross.compute(catalog);
+            cout << "  " << cross.getEncounterPairCount() << " of " << cross.getPairCount() << " pairs have been within "
+                 << cross_distance << " km (" << cross.getSampleCount() << " samples, " << cross.getEventCount() << " events)." << endl;
+        }
+        delete pool;
+    } else if(time_major) {
+        /*  All the satellites are propagated together, one time step after another. With several
+         *  threads, slices of the catalog are propagated (and formatted) concurrently. Files are
+         *  written by the output writer thread in the meantime.
+         */
+        WorkStealingPool * pool = (prop_threads > 1 ? new WorkStealingPool(prop_threads) : NULL);
+        OutputWriter writer;
+        CatalogPropagator catalog(tle_data, output_path_root, prop_format, prop_time_start, prop_time_end, prop_time_step, true, pool);
+        catalog.propagate(prop_n_points, false, &writer, prop_resolution);
+        delete pool;
+    } else if(prop_threads <= 1) {
+        OutputWriter writer;    /* Files are written while the next points are propagated. */
+        for(auto t = tle_data.begin(); t != tle_data.end(); t++) {
+            try {
+                if(cheb_tolerance > 0) {
+                    t->second.fitEphemeris(output_path_root, prop_time_start, prop_time_end, prop_time_step, cheb_tolerance);
+                } else {
+                    t->second.propagate(output_path_root, prop_time_start, prop_time_end, prop_time_step, prop_n_points, verbose,
+                        false, NULL, prop_format, &writer, prop_resolution);
+                }
+            } catch(exception& e) {
+                // cerr << DBG_REDD "  Propagation of " << t->first << " throwed an EXCEPTION: " << e.what() << DBG_NOCOLOR << endl;
+            }
+        }
+    } else {
+        /*  Jobs are sorted by estimated cost (most expensive first) and dealt to the workers in a
+         *  round-robin fashion. Each worker runs its own jobs in that order and idle workers steal
+         *  the most expensive job left in other deques, so that a long deep-space propagation does
+         *  not end up running alone at the end.
+         */
+        vector<pair<double, TLEHistoricSet *> > jobs;
+        for(auto t = tle_data.begin(); t != tle_data.end(); t++) {
+            jobs.push_back(make_pair(t->second.estimateCost(prop_time_start, prop_time_end, prop_time_step), &t->second));
+        }
+        sort(jobs.begin(), jobs.end(),
+            [](const pair<double, TLEHistoricSet *> & a, const pair<double, TLEHistoricSet *> & b) {
+                return (a.first != b.first ? a.first > b.first : a.second->getId() < b.second->getId());
+            });
+
+        /*  Long propagations are also split in time chunks (see TLEHistoricSet::propagate), which
+         *  are queued in the same pool. This keeps all threads busy when there are fewer
+         *  satellites than threads.
+         */
+        WorkStealingPool pool(prop_threads);
+        OutputWriter writer;    /* Shared by all the propagations. */
+        atomic<int> jobs_done(0);
+        int jobs_total = jobs.size();
+        for(int k = 0; k < jobs_total; k++) {
+            TLEHistoricSet * tlehs = jobs[k].second;
+            pool.submit([=, &jobs_done, &pool, &writer] {
+                bool success = true;
+                try {
+                    if(cheb_tolerance > 0) {
+                        tlehs->fitEphemeris(output_path_root, prop_time_start, prop_time_end, prop_time_step, cheb_tolerance, true);
+                    } else {
+                        tlehs->propagate(output_path_root, prop_time_start, prop_time_end, prop_time_step, prop_n_points, false, true, &pool,
+                            prop_format, &writer, prop_resolution);
+                    }
+                } catch(exception& e) {
+                    success = false;
+                }
+                printf("  %5d [%3d/%3d] %s\n", tlehs->getId(), ++jobs_done, jobs_total,
+                    (success ? DBG_GREEND "done" DBG_NOCOLOR : DBG_REDD "failed" DBG_NOCOLOR));
+                fflush(stdout);
+            }, k % prop_threads);
         }
+        pool.wait();
     }
 
     cout << "  Done." << endl;
@@ -20,11 +20,26 @@
 #include <iostream>
 #include <ctime>
 #include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <cfloat>
 #include <string>
 #include <set>
 #include <vector>
+#include <array>
 #include <unordered_map>
+#include <list>
 #include <utility>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 /* Standard C libraries: */
 #include <dirent.h>
@@ -33,20 +48,81 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <assert.h>
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef ORBPROP_ZSTD
+#include <zstd.h>           /* Optional zstd stage of compressed propagation files (see Makefile). */
+#endif
 
 /* Open-source NORAD SGP4 C++ Implementation library (by Michael F. Henry): */
 #include "stdafx.h"         /* orbitTools main header file. */
 #include "coreLib.h"        /* orbitTools core library.     */
 #include "orbitLib.h"       /* orbitTools orbit library.    */
 
-/* Custom classes: */
-#include "TLEHistoricSet.hpp"   /* Stores data TLE data when this data is fragmented in pieces. */
-
 /*** GLOBAL CONSTANTS *****************************************************************************/
 #define CONF_FILE_PATH  "orbprop.conf"
 
+#define PROP_COST_SGP4  1.0     /* Relative cost of one propagation point with SGP4 (near-earth). */
+#define PROP_COST_SDP4  2.0     /* Relative cost of one propagation point with SDP4 (deep-space). */
+#define PROP_CHUNK_POINTS 4096  /* Maximum number of points propagated as a single job.           */
+#define PROP_CHUNK_WINDOW 4     /* Chunks (per thread) being propagated ahead of the output file. */
+
+#define PROPB_MAGIC       "ORBPPROP"    /* First 8 bytes of binary propagation files.             */
+#define PROPB_VERSION     1             /* Version of the binary propagation file format.         */
+#define PROPC_MAGIC       "ORBPCATL"    /* First 8 bytes of catalog container files.              */
+#define PROPC_VERSION     1             /* Version of the catalog container file format.          */
+#define PROPC_FILE_NAME   "catalog.propc"   /* Catalog container (in the results folder).         */
+#define PROPC_ALIGNMENT   4096          /* Alignment of the points of a container (page size).    */
+#define PROPZ_MAGIC       "ORBPPRPZ"    /* First 8 bytes of compressed propagation files.         */
+#define PROPZ_VERSION     1             /* Version of the compressed propagation file format.     */
+#define PROPZ_CHUNK_SYNC  0x4b435a50    /* First 4 bytes of each chunk ("PZCK").                  */
+#define PROPZ_COMPONENTS  8             /* Values of each point (latitude to vz).                 */
+#define PROPZ_GROUP       32            /* Points whose residuals are packed with the same width. */
+#define PROPZ_RESOLUTION  1.0           /* Default resolution of compressed positions (meters).   */
+#define PROPZ_ZSTD_LEVEL  3             /* zstd level of the chunks (if built with ORBPROP_ZSTD). */
+#define PROPZ_MAX_CHUNK   (64 << 20)    /* Largest chunk accepted by the decoder (bytes).         */
+#define PROP_FAST_FORMAT_MAX 1e15 /* Values formatted without `printf` are below this one.        */
+#define PROP_FAST_LINE_LENGTH 224 /* Longest line formatted without `printf` (but its time string). */
+
+#define OUTPUT_QUEUE_SLOTS 1024 /* Buffers queued to the output writer (a power of two).        */
+#define OUTPUT_MAX_BYTES  (64 << 20) /* Bytes pending in the output writer before producers wait. */
+#define OUTPUT_RESERVED_FILES 256 /* File descriptors that the output writer leaves to others.    */
+
+#define CATALOG_SLICE     256   /* Satellites propagated by a single job in time-major mode.      */
+#define CATALOG_BLOCK_STEPS 256 /* Maximum time steps propagated at once in time-major mode.      */
+#define CATALOG_BLOCK_POINTS (1 << 20)  /* Maximum points (steps times satellites) of a block.    */
+
+#define CROSS_MAGIC       "ORBPCDST"    /* First 8 bytes of cross-distance files.                 */
+#define CROSS_VERSION     1             /* Version of the cross-distance file format.             */
+#define CROSS_EVENT_MAGIC "ORBPCEVT"    /* First 8 bytes of encounter event files.                */
+#define CROSS_FLUSH_SAMPLES 4096 /* Samples of a pair buffered before they are written.           */
+#define CROSS_FLUSH_EVENTS 256  /* Events of a pair buffered before they are written.            */
+#define CROSS_SHARDS_PER_THREAD 8 /* Shards of pairs (per thread), processed as independent jobs. */
+#define PROX_CELL_OFFSET  (1 << 20) /* Grid cell coordinates are in (-PROX_CELL_OFFSET, PROX_CELL_OFFSET). */
+#define FILTER_MARGIN     20.0  /* Near-earth position uncertainty of the orbit filters (km).     */
+#define FILTER_DEEP_MARGIN 100.0 /* Deep-space position uncertainty of the orbit filters (km).    */
+#define FILTER_STATE_ROTATION 0.0175 /* Maximum orbit rotation within a filter state (rad, 1 deg). */
+#define FILTER_MAX_STATES 32    /* Maximum filter states per propagation segment.                 */
+#define TCA_TOLERANCE     1e-3  /* Time of closest approach tolerance (seconds).                  */
+#define TCA_MAX_ITERATIONS 64   /* Maximum iterations of the closest approach search.             */
+#define TCA_HERMITE_ERROR 1e-9  /* Interpolation error between steps (km), per step^4 (in s^4).   */
+#define TCA_HERMITE_TOLERANCE 1e-3 /* Interpolated closest approach tolerance (fraction of a step). */
+
+#define TLE_LINE_LENGTH   69    /* Length of TLE data lines (including the checksum).             */
+#define TLE_NAME_LENGTH   24    /* Maximum length of TLE name lines.                              */
+#define TLE_ARCHIVE_MAGIC "ORBPTLEA"    /* First 8 bytes of TLE archives.                         */
+#define TLE_ARCHIVE_VERSION 1           /* Version of the TLE archive format.                     */
+#define TLE_DEDUP_SHARDS  64    /* Shards of the table used to drop duplicated TLE's when loading. */
+
+#define CHEB_DEGREE       12    /* Degree of the polynomials of Chebyshev ephemeris granules.     */
+#define CHEB_CHECK_POINTS 33    /* Instants at which each granule is checked against the model.   */
+#define CHEB_MIN_GRANULE  60    /* Shortest granule (in seconds), regardless of the tolerance.    */
+
 #define DBG_REDB        "\x1b[31;1m"
 #define DBG_REDD        "\x1b[31m"
 #define DBG_GREENB      "\x1b[32;1m"
@@ -58,6 +134,22 @@
 #define DBG_GREY        "\x1b[30;1m"
 #define DBG_NOCOLOR     "\x1b[0m"
 
+/* Custom classes (after the constants, which they use): */
+#include "PropagationFile.hpp"  /* CSV and binary propagation files.                         */
+#include "PropCodec.hpp"        /* Compressed propagation files and their streaming decoder.    */
+#include "OutputWriter.hpp"     /* Asynchronous output writer thread.                          */
+#include "TLEHistoricSet.hpp"   /* Stores data TLE data when this data is fragmented in pieces. */
+#include "ThreadPool.hpp"       /* Work-stealing thread pool for concurrent propagations.       */
+#include "ChebyshevEphemeris.hpp" /* Piecewise Chebyshev approximation of propagated orbits.    */
+#include "TLEParser.hpp"        /* Memory-mapped TLE collection file parser.                    */
+#include "TLELoader.hpp"        /* Concurrent TLE directory scanner and loader.                 */
+#include "TLEArchive.hpp"       /* Indexed binary TLE archive.                                  */
+#include "CatalogPropagator.hpp" /* Time-major propagation of the whole catalog.                */
+#include "ProximityScreen.hpp"  /* Grid-based close-approach screening.                         */
+#include "OrbitFilter.hpp"      /* Orbit-geometry pre-filters for close-approach screening.     */
+#include "CrossDistance.hpp"    /* All-pairs cross-distances of a catalog.                      */
+#include "ClosestApproach.hpp"  /* Times of closest approach of a catalog.                      */
+
 
 /*** TYPEDEFS *************************************************************************************/
 typedef struct {